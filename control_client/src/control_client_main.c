@@ -1,6 +1,7 @@
 #include "errno.h"
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -26,7 +27,9 @@
 #include "../../packets/packet.h"
 #include "../../pad_server/src/actuator.h"
 #include "helptext.h"
+#include "observe.h"
 #include "pad.h"
+#include "sequence.h"
 #include "switch.h"
 
 #define INTERRUPT_SIGNAL SIGUSR1
@@ -103,6 +106,16 @@ static command_t commands[] = {
     {.key = 'z', .sw = &switches[15]}, {.key = 'x', .sw = &switches[16]}, {.key = 'c', .sw = &switches[17]},
     {.key = 'v', .sw = &switches[18]}, {.key = 'b', .sw = &switches[19]},
 };
+
+/* Key which, followed by actuator keys on the same line, flips all of those actuators with a single command */
+#define GROUP_KEY 'm'
+
+/* Key which, followed by the path of a sequence file, uploads the actuation sequence in that file */
+#define SEQUENCE_LOAD_KEY 'l'
+
+/* Keys which start and abort the uploaded actuation sequence */
+#define SEQUENCE_START_KEY 'n'
+#define SEQUENCE_ABORT_KEY 'k'
 #endif
 
 uint16_t port = 50001; /* Default port */
@@ -117,6 +130,253 @@ static void handle_term(int sig) {
     exit(EXIT_SUCCESS);
 }
 
+/*
+ * Print the outcome of a command acknowledged by the pad, or of an actuation the pad carried out.
+ * @param ack The acknowledgement or actuation outcome
+ */
+static void print_ack(const switch_ack_t *ack) {
+    if (ack->kind == CNTRL_ACT_DONE) {
+        if (ack->err == 0) {
+            printf("Actuator #%u: Set %s\n", ack->id, ack->state ? "on" : "off");
+        } else if (ack->err == ECANCELED) {
+            fprintf(stderr, "Actuator #%u: Not set %s, pre-empted by the dump valve\n", ack->id,
+                    ack->state ? "on" : "off");
+        } else {
+            fprintf(stderr, "Actuator #%u: Could not be set %s\n", ack->id, ack->state ? "on" : "off");
+        }
+        return;
+    }
+
+    switch (ack->err) {
+    case 0:
+        if (ack->kind == CNTRL_SEQ_ACK) {
+            printf("Command #%u: Sequence request accepted\n", ack->seq);
+        } else {
+            printf("Command #%u: Switch actuation accepted\n", ack->seq);
+        }
+        break;
+    case EPERM:
+        fprintf(stderr, "Command #%u: Permission denied\n", ack->seq);
+        break;
+    case EINVAL:
+        fprintf(stderr, "Command #%u: Invalid actuator/arming level.\n", ack->seq);
+        break;
+    case ENODEV:
+        fprintf(stderr, "Command #%u: No such actuator/arming level exists\n", ack->seq);
+        break;
+    case EBUSY:
+        fprintf(stderr, "Command #%u: The actuation sequence is running\n", ack->seq);
+        break;
+    case ENOENT:
+        fprintf(stderr, "Command #%u: No actuation sequence was uploaded\n", ack->seq);
+        break;
+    case EAGAIN:
+        fprintf(stderr, "Command #%u: Too many actuations are queued on the pad, try again\n", ack->seq);
+        break;
+    default:
+        fprintf(stderr, "Command #%u: Something went wrong: %d\n", ack->seq, ack->err);
+        break;
+    }
+
+    if (ack->err && ack->kind == CNTRL_MULTI_ACT_ACK) {
+        fprintf(stderr, "Command #%u: Refused because of actuation %u of the group\n", ack->seq, ack->index);
+    }
+}
+
+/*
+ * Print that a command was not sent, because the pad is not expected to permit it at its arming level.
+ */
+static void print_refused(void) {
+    fprintf(stderr, "Command not sent: not permitted while '%s'\n", arm_state_str(pad.arm_level));
+}
+
+/*
+ * Wait for and print acknowledgements from the pad until at most `max_in_flight` commands remain unacknowledged.
+ * Commands are sent without waiting for their acknowledgement, so several of them can be in flight at once.
+ * @param max_in_flight The number of commands which may remain unacknowledged.
+ * @return 0 on success, the error which occurred on the connection otherwise.
+ */
+static int await_acks(unsigned int max_in_flight) {
+    switch_ack_t ack;
+    int err;
+
+    while (pad.in_flight > max_in_flight) {
+        err = switch_recv_ack(&pad, &ack);
+        if (err) return err;
+        print_ack(&ack);
+    }
+    return 0;
+}
+
+#ifdef DESKTOP_BUILD
+/*
+ * Flip all of the actuator switches named by `keys` with a single command. The pad either performs every actuation or
+ * none of them.
+ * @param keys The actuator keys following the group key.
+ * @return 0 if okay, the error which occurred on the connection otherwise.
+ */
+static int group_command(const char *keys) {
+    switch_t *group[MULTI_ACT_MAX];
+    uint8_t n = 0;
+    bool too_many = false;
+
+    for (; *keys != '\0'; keys++) {
+        for (unsigned int i = 0; i < array_len(commands); i++) {
+            if (commands[i].key != *keys || commands[i].sw->kind != CNTRL_ACT_REQ) continue;
+            if (n == MULTI_ACT_MAX) {
+                too_many = true;
+            } else {
+                group[n++] = commands[i].sw;
+            }
+        }
+    }
+
+    if (too_many || n == 0) {
+        fprintf(stderr, "Expected between 1 and %d actuator keys after '%c'\n", MULTI_ACT_MAX, GROUP_KEY);
+        return 0;
+    }
+
+    /* The pad refuses the whole group if it does not permit one of them */
+
+    for (uint8_t i = 0; i < n; i++) {
+        if (switch_check(group[i], &pad, !group[i]->state)) {
+            print_refused();
+            return 0;
+        }
+    }
+
+    return switch_group_send(group, n, &pad);
+}
+
+/*
+ * Upload the actuation sequence in a file to the pad.
+ * @param path The path of the sequence file, possibly preceded by spaces.
+ * @return 0 if okay, the error which occurred on the connection otherwise.
+ */
+static int load_command(const char *path) {
+    seq_step_p steps[SEQUENCE_FILE_MAX_STEPS];
+    size_t n;
+    int err;
+
+    while (*path == ' ') path++;
+
+    err = sequence_load(path, steps, SEQUENCE_FILE_MAX_STEPS, &n);
+    if (err) {
+        fprintf(stderr, "Could not load sequence from '%s': %s\n", path, strerror(err));
+        return 0;
+    }
+
+    /* Uploads take several requests, so make room for all of them */
+
+    err = await_acks(PAD_MAX_IN_FLIGHT - sequence_uploads(n));
+    if (err) return err;
+
+    printf("Uploading sequence of %zu steps\n", n);
+    return sequence_upload(&pad, steps, n);
+}
+
+/*
+ * Handle one line of input: either a single switch key, or the group key followed by actuator keys.
+ * @param text The line, without its newline.
+ * @return 0 if okay, the error which occurred on the connection otherwise.
+ */
+static int handle_line(const char *text) {
+    int err;
+
+    if (text[0] == '\0') return 0;
+
+    /* Make room for one more command in flight */
+
+    err = await_acks(PAD_MAX_IN_FLIGHT - 1);
+    if (err) return err;
+
+    switch (text[0]) {
+    case GROUP_KEY:
+        return group_command(text + 1);
+    case SEQUENCE_LOAD_KEY:
+        return load_command(text + 1);
+    case SEQUENCE_START_KEY:
+        return sequence_run(&pad, true);
+    case SEQUENCE_ABORT_KEY:
+        return sequence_run(&pad, false);
+    }
+
+    for (unsigned int i = 0; i < array_len(commands); i++) {
+        if (commands[i].key != text[0]) continue;
+
+        if (switch_check(commands[i].sw, &pad, !commands[i].sw->state)) {
+            print_refused();
+            return 0;
+        }
+        return switch_send(commands[i].sw, &pad, !commands[i].sw->state);
+    }
+
+    fprintf(stderr, "Invalid key: %c\n", text[0]);
+    return 0;
+}
+
+/*
+ * Read what is available on standard input and handle every complete line, without waiting for acknowledgements.
+ * @param eof Set to true once standard input is closed.
+ * @return 0 if okay, the error which occurred on the connection otherwise.
+ */
+static int read_input(bool *eof) {
+    static char line[64];   /* Input not yet handled */
+    static size_t line_len; /* Number of bytes in `line` */
+    ssize_t bread;
+    char *nl;
+    int err;
+
+    bread = read(STDIN_FILENO, line + line_len, sizeof(line) - 1 - line_len);
+    if (bread <= 0) {
+        *eof = true;
+        return 0;
+    }
+    line_len += bread;
+    line[line_len] = '\0';
+
+    while ((nl = memchr(line, '\n', line_len)) != NULL) {
+        *nl = '\0';
+        err = handle_line(line);
+        line_len -= nl + 1 - line;
+        memmove(line, nl + 1, line_len);
+        line[line_len] = '\0';
+        if (err) return err;
+    }
+
+    /* Drop a line too long to be a command */
+
+    if (line_len == sizeof(line) - 1) line_len = 0;
+    return 0;
+}
+#else
+/*
+ * Whether an error means the connection to the pad has to be re-established.
+ * @param err The error
+ * @return True if the connection is lost, false if acknowledgements are just late. A message cut short by the receive
+ * timeout is reported as ETIMEDOUT, which loses the connection since the rest of it would be read as the next message.
+ */
+static bool connection_lost(int err) { return err != 0 && err != EAGAIN && err != EWOULDBLOCK; }
+
+/*
+ * Print every acknowledgement and actuation outcome the pad has sent so far, without waiting for more. Outcomes move
+ * the arming level along, so they are read before switches are checked against it.
+ * @return 0 on success, the error which occurred on the connection otherwise.
+ */
+static int drain_acks(void) {
+    struct pollfd pfd = {.fd = pad.sock, .events = POLLIN};
+    switch_ack_t ack;
+    int err;
+
+    while (poll(&pfd, 1, 0) > 0) {
+        err = switch_recv_ack(&pad, &ack);
+        if (err) return err;
+        print_ack(&ack);
+    }
+    return 0;
+}
+#endif
+
 #if !defined(CONFIG_SYSTEM_NSH) && defined(CONFIG_CDCACM_CONSOLE)
 /* Starts the NuttX USB serial interface.
  */
@@ -176,10 +436,14 @@ static int usb_init(void) {
 int main(int argc, char **argv) {
 
     char *ip = "127.0.0.1";
+    bool observer = false;
+    bool port_given = false;
     pad.sock = -1;
     int err;
 #ifdef DESKTOP_BUILD
-    char key;
+    struct pollfd fds[2];
+    switch_ack_t ack;
+    bool eof = false;
 #else
     struct sigevent notify;
     siginfo_t signal_info;
@@ -208,7 +472,7 @@ int main(int argc, char **argv) {
     /* Parse command line options. */
 
     int c;
-    while ((c = getopt(argc, argv, ":a:p:h")) != -1) {
+    while ((c = getopt(argc, argv, ":a:p:oh")) != -1) {
         switch (c) {
         case 'h':
             puts(HELP_TEXT);
@@ -226,6 +490,10 @@ int main(int argc, char **argv) {
 
         case 'p':
             port = atoi(optarg);
+            port_given = true;
+            break;
+        case 'o':
+            observer = true;
             break;
         case '?':
             fprintf(stderr, "Unknown option -%c\n", optopt);
@@ -238,6 +506,31 @@ int main(int argc, char **argv) {
 
     signal(SIGINT, handle_term);
 
+    /* Observers only watch the pad, so they need none of the switches */
+
+    if (observer) {
+        if (!port_given) port = OBSERVER_PORT;
+
+        for (;;) {
+            err = pad_init(&pad, ip, port);
+            if (err) {
+                fprintf(stderr, "Could not initialize pad server with error: %s\n", strerror(err));
+                exit(EXIT_FAILURE);
+            }
+
+            err = pad_connect_forever(&pad);
+            if (err) {
+                fprintf(stderr, "Could not connect to pad server with error: %s\n", strerror(err));
+                exit(EXIT_FAILURE);
+            }
+
+            printf("Observing pad...\n");
+            err = observe(&pad);
+            fprintf(stderr, "Lost observer connection: %s\n", strerror(err));
+            pad_disconnect(&pad);
+        }
+    }
+
 #ifndef DESKTOP_BUILD
     /* Register all control switches as interrupts */
 
@@ -297,24 +590,46 @@ int main(int argc, char **argv) {
 
         printf("Connection established!\n");
 
+#ifdef DESKTOP_BUILD
+        printf("Press a key and hit enter, or '%c' followed by actuator keys to flip them together.\n", GROUP_KEY);
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = pad.sock;
+        fds[1].events = POLLIN;
+#endif
+
         /* Send messages in a loop */
 
         for (;;) {
 
 #ifdef DESKTOP_BUILD
-            printf("Press key and hit enter: ");
-            key = getc(stdin);
-            if (key != '\n') {
-                while (getc(stdin) != '\n')
-                    ;
+            /* Commands are sent as soon as they are typed, and their acknowledgements are printed as they arrive */
+
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "Could not wait for input: %s\n", strerror(errno));
+                exit(EXIT_FAILURE);
             }
 
-            for (unsigned int i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
-                if (commands[i].key == key) {
-                    err = switch_callback(commands[i].sw, &pad, !commands[i].sw->state);
-                } else if (i == (sizeof(commands) / sizeof(commands[0]) - 1)) {
-                    fprintf(stderr, "Invalid key: %c\n", key);
-                }
+            err = 0;
+            if (fds[1].revents) {
+                err = switch_recv_ack(&pad, &ack);
+                if (!err) print_ack(&ack);
+            }
+            if (!err && fds[0].revents) err = read_input(&eof);
+
+            /* Once input runs out, wait for the commands still in flight before leaving */
+
+            if (!err && eof) {
+                err = await_acks(0);
+                pad_disconnect(&pad);
+                exit(err ? EXIT_FAILURE : EXIT_SUCCESS);
+            }
+
+            if (err) {
+                fprintf(stderr, "Lost connection to pad: %s\n", strerror(err));
+                pad_disconnect(&pad); /* Close socket with the pad since it was destroyed anyways */
+                goto reconnect;
             }
 #else
             /* Create a signal set containing the GPIO interrupt signal */
@@ -341,6 +656,13 @@ int main(int argc, char **argv) {
 
             usleep(DEBOUNCE_US); /* Wait de-bouncing time */
 
+            err = drain_acks();
+            if (connection_lost(err)) {
+                fprintf(stderr, "Lost connection to pad: %d\n", err);
+                pad_disconnect(&pad);
+                goto reconnect;
+            }
+
             /* Go through all of the silly switches twice in case debounce failed the first time */
 
             for (int k = 0; k < array_len(switches); k++) {
@@ -398,39 +720,42 @@ int main(int argc, char **argv) {
                         continue;
                     }
 
-                    /* Call the correct switch callback. `invalue` is negated because the switches use a pull-up
-                     * resistor. When open circuit (off), the switch is high. When closed circuit (on) the switch is
-                     * pulled low. */
-
-                    err = switch_callback(&switches[i], &pad, value);
-
-                    /* Print a helpful error message */
-
-                    switch (err) {
-                    case 0:
-                        printf("Switch actuated successfully\n");
-                        break;
-                    case EPERM:
-                        fprintf(stderr, "Permission denied\n");
-                        break;
-                    case EINVAL:
-                        fprintf(stderr, "Invalid actuator/arming level.\n");
-                        break;
-                    case ENODEV:
-                        fprintf(stderr, "No such actuator/arming level exists\n");
-                        break;
-                    default:
-                        fprintf(stderr, "Something went wrong: %d\n", err);
-                        break;
+                    /* Send the switch's command without waiting for its acknowledgement. `invalue` is negated because
+                     * the switches use a pull-up resistor. When open circuit (off), the switch is high. When closed
+                     * circuit (on) the switch is pulled low. */
+
+                    /* A command the pad would refuse is not sent, but the switch has still been flipped */
+
+                    if (switch_check(&switches[i], &pad, value)) {
+                        print_refused();
+                        switches[i].state = value;
+                        continue;
                     }
 
-                    if (err == ENOTCONN || err == ENOTCONN || err == ECONNABORTED || err == ECONNREFUSED) {
+                    err = await_acks(PAD_MAX_IN_FLIGHT - 1);
+                    if (!err) err = switch_send(&switches[i], &pad, value);
+
+                    if (connection_lost(err)) {
                         /* Try to re-connect */
+                        fprintf(stderr, "Lost connection to pad: %d\n", err);
                         pad_disconnect(&pad); /* Close socket with the pad since it was destroyed anyways */
                         goto reconnect;
+                    } else if (err) {
+                        fprintf(stderr, "Timed out waiting for the pad, command not sent\n");
                     }
                 }
             }
+
+            /* Commands for every flipped switch are in flight, now collect their acknowledgements */
+
+            err = await_acks(0);
+            if (connection_lost(err)) {
+                fprintf(stderr, "Lost connection to pad: %d\n", err);
+                pad_disconnect(&pad);
+                goto reconnect;
+            } else if (err) {
+                fprintf(stderr, "Timed out waiting for the pad to acknowledge\n");
+            }
 #endif
         }
     }
@@ -1,5 +1,8 @@
 #define HELP_TEXT                                                                                                      \
     "control 0.0.0\n2024 CU InSpace\n\nDESCRIPTION:\n    Emulates the control inp"                                     \
     "ut box.\n\nUSAGE:\n    control [options]\n\nOPTIONS:\n    -p port     Specif"                                     \
-    "y the port number to connect to.\n    -a addr     The pad_server address to "                                     \
+    "y the port number to connect to.\n"                                                                               \
+    "    -o          Connect as a read-only observer, printing the pad state and\n"                                    \
+    "                every acknowledgement sent to the controller. Port 50003 is\n"                                    \
+    "                used unless -p is given.\n    -a addr     The pad_server address to "                             \
     "connect to. If not\n                specified address 127.0.0.1 is used.\n\nEXAMPLES :\n control -p 1984\n "
@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "../../packets/packet.h"
+#include "observe.h"
+
+/*
+ * Receive exactly `n` bytes from the pad server.
+ * @param pad The pad connection
+ * @param buf The destination buffer, at least `n` bytes long.
+ * @param n The number of bytes to receive.
+ * @return 0 on success, ENOTCONN if the pad server disconnected, errno code on failure.
+ */
+static int observe_recv(pad_t *pad, void *buf, size_t n) {
+    ssize_t bread = recv(pad->sock, buf, n, MSG_WAITALL);
+    if (bread < 0) {
+        return errno;
+    } else if ((size_t)bread < n) {
+        return ENOTCONN;
+    }
+    return 0;
+}
+
+/*
+ * Get the length of the body of a message from the pad server.
+ * @param hdr The message header.
+ * @return The length of the body in bytes, 0 if the message is unknown or has no body.
+ */
+static size_t observe_body_len(const header_p *hdr) {
+    int len;
+
+    if (hdr->type == TYPE_TELEM) return packet_telem_body_len(hdr->subtype);
+    if (hdr->type != TYPE_CNTRL) return 0;
+
+    len = packet_cntrl_body_len(hdr->subtype);
+    return len > 0 ? (size_t)len : 0;
+}
+
+/*
+ * Print a message the pad server sent to observers.
+ * @param hdr The message header.
+ * @param body The message body.
+ */
+static void observe_print(const header_p *hdr, const void *body) {
+    if (hdr->type == TYPE_CNTRL) {
+        if (hdr->subtype == CNTRL_ACT_ACK) {
+            const act_ack_p *ack = body;
+            printf("Actuator #%u request #%u acknowledged with status %u\n", ack->id, ack->seq, ack->status);
+        } else if (hdr->subtype == CNTRL_MULTI_ACT_ACK) {
+            const multi_act_ack_p *ack = body;
+            printf("Multi-actuator request #%u acknowledged with status %u at #%u\n", ack->seq, ack->status,
+                   ack->index);
+        } else if (hdr->subtype == CNTRL_ACT_DONE) {
+            const act_done_p *done = body;
+            printf("Actuator #%u: %s with status %u, arming state %s @ %u ms\n", done->id, done->state ? "on" : "off",
+                   done->status, arm_state_str(done->level), done->time);
+        } else if (hdr->subtype == CNTRL_SEQ_ACK) {
+            const seq_ack_p *ack = body;
+            printf("Sequence request #%u acknowledged with status %u\n", ack->seq, ack->status);
+        } else if (hdr->subtype == CNTRL_ARM_ACK) {
+            const arm_ack_p *ack = body;
+            printf("Arming request #%u acknowledged with status %u\n", ack->seq, ack->status);
+        } else {
+            printf("Control message sub-type %u\n", hdr->subtype); /* Requests are never sent to observers */
+        }
+        return;
+    }
+
+    switch ((telem_subtype_e)hdr->subtype) {
+    case TELEM_ARM: {
+        const arm_state_p *arm = body;
+        printf("Arming state: %s @ %u ms\n", arm_state_str(arm->state), arm->time);
+    } break;
+    case TELEM_CONN: {
+        const conn_status_p *conn = body;
+        printf("Connection status: %s @ %u ms\n", conn_status_str(conn->status), conn->time);
+    } break;
+    case TELEM_ACT: {
+        const act_state_p *act = body;
+        printf("Actuator #%u: %s @ %u ms\n", act->id, act->state ? "on" : "off", act->time);
+    } break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Watch the pad server as a read-only observer, printing every acknowledgement and actuation outcome sent to the
+ * controller and every pad state snapshot until the connection is lost.
+ * @param pad The pad connection, connected to the observer port.
+ * @return The error that ended the connection.
+ */
+int observe(pad_t *pad) {
+    header_p hdr;
+    uint8_t body[32]; /* Larger than any message body sent to observers */
+    size_t len;
+    int err;
+
+    for (;;) {
+        err = observe_recv(pad, &hdr, sizeof(hdr));
+        if (err) return err;
+
+        len = observe_body_len(&hdr);
+        if (len == 0 || len > sizeof(body)) {
+            fprintf(stderr, "Unexpected message type %u, sub-type %u from pad\n", hdr.type, hdr.subtype);
+            return EPROTO;
+        }
+
+        err = observe_recv(pad, body, len);
+        if (err) return err;
+        observe_print(&hdr, body);
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef _CONTROL_OBSERVE_H_
+#define _CONTROL_OBSERVE_H_
+
+#include "pad.h"
+
+/* The default port on which the pad server accepts observers */
+#define OBSERVER_PORT 50003
+
+int observe(pad_t *pad);
+
+#endif // _CONTROL_OBSERVE_H_
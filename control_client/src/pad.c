@@ -4,6 +4,7 @@
 #include <netinet/tcp.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -105,6 +106,12 @@ int pad_init(pad_t *pad, const char *ip, uint16_t port) {
     }
 #endif /* defined(CONFIG_CLOCK_TIMEKEEPING) */
 
+    /* A new connection has no requests in flight, and the pad may have changed its arming level since the last one */
+    pad->next_seq = 0;
+    pad->in_flight = 0;
+    memset(pad->requests, 0, sizeof(pad->requests));
+    pad->arm_level = PAD_LEVEL_UNKNOWN;
+
     /* Create address */
     pad->addr.sin_family = AF_INET;
     pad->addr.sin_port = htons(port);
@@ -188,3 +195,111 @@ int pad_disconnect(pad_t *pad) {
  * @return The number of bytes that were received, or -1 on failure (errno indicates the error).
  */
 ssize_t pad_recv(pad_t *pad, void *buf, ssize_t n) { return recv(pad->sock, buf, n, 0); }
+
+/*
+ * Start tracking a control request which is about to be sent.
+ * @param pad The pad server the request is sent to.
+ * @param kind The sub-type of the acknowledgement expected for the request.
+ * @param seq Set to the sequence number to send the request with.
+ * @return 0 on success, EBUSY if PAD_MAX_IN_FLIGHT requests are already awaiting acknowledgement.
+ */
+int pad_request_begin(pad_t *pad, cntrl_subtype_e kind, uint16_t *seq) {
+    for (unsigned int i = 0; i < PAD_MAX_IN_FLIGHT; i++) {
+        if (pad->requests[i].used) continue;
+        pad->requests[i].used = true;
+        pad->requests[i].seq = pad->next_seq++;
+        pad->requests[i].kind = kind;
+        pad->in_flight++;
+        *seq = pad->requests[i].seq;
+        return 0;
+    }
+    return EBUSY;
+}
+
+/*
+ * Send a control request to the pad and track it until its acknowledgement arrives.
+ * @param pad The pad server to send the request to.
+ * @param kind The sub-type of the request.
+ * @param ack_kind The sub-type of the acknowledgement expected for the request.
+ * @param body The request body, whose first field is its sequence number, filled in here.
+ * @param len The length of the request body.
+ * @return 0 on success, EBUSY if too many requests are in flight, the error that occurred otherwise.
+ */
+int pad_send_request(pad_t *pad, cntrl_subtype_e kind, cntrl_subtype_e ack_kind, void *body, size_t len) {
+    header_p hdr = {.type = TYPE_CNTRL, .subtype = kind};
+    struct iovec iov[2];
+    uint16_t seq;
+    int err;
+
+    err = pad_request_begin(pad, ack_kind, &seq);
+    if (err) return err;
+    memcpy(body, &seq, sizeof(seq));
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = body;
+    iov[1].iov_len = len;
+    if (pad_send(pad, iov, 2) < 0) {
+        err = errno;
+        pad_request_cancel(pad, seq);
+        return err;
+    }
+    return 0;
+}
+
+/*
+ * Stop tracking a control request which could not be sent.
+ * @param pad The pad server the request was meant for.
+ * @param seq The sequence number of the request.
+ */
+void pad_request_cancel(pad_t *pad, uint16_t seq) {
+    for (unsigned int i = 0; i < PAD_MAX_IN_FLIGHT; i++) {
+        if (pad->requests[i].used && pad->requests[i].seq == seq) {
+            pad->requests[i].used = false;
+            pad->in_flight--;
+            return;
+        }
+    }
+}
+
+/*
+ * Check whether a control request is awaiting an acknowledgement.
+ * @param pad The pad server the requests were sent to.
+ * @param kind The sub-type of the acknowledgement expected for the request.
+ * @return True if a request expecting that kind of acknowledgement is in flight.
+ */
+bool pad_request_pending(const pad_t *pad, cntrl_subtype_e kind) {
+    for (unsigned int i = 0; i < PAD_MAX_IN_FLIGHT; i++) {
+        if (pad->requests[i].used && pad->requests[i].kind == kind) return true;
+    }
+    return false;
+}
+
+/*
+ * Match an acknowledgement to the control request it answers. The pad handles requests in the order they were sent,
+ * so requests sent before the acknowledged one which are still in flight will never be acknowledged and are dropped.
+ * @param pad The pad server the acknowledgement came from.
+ * @param seq The sequence number in the acknowledgement.
+ * @param kind The sub-type of the acknowledgement.
+ * @return 0 on success, EPROTO if no request of that kind awaited this acknowledgement.
+ */
+int pad_request_end(pad_t *pad, uint16_t seq, cntrl_subtype_e kind) {
+    int err = EPROTO;
+
+    for (unsigned int i = 0; i < PAD_MAX_IN_FLIGHT; i++) {
+        if (!pad->requests[i].used) continue;
+
+        if (pad->requests[i].seq == seq) {
+            if (pad->requests[i].kind != kind) continue;
+            err = 0;
+        } else if ((int16_t)(pad->requests[i].seq - seq) < 0) {
+            fprintf(stderr, "Request #%u was never acknowledged.\n", pad->requests[i].seq);
+        } else {
+            continue;
+        }
+
+        pad->requests[i].used = false;
+        pad->in_flight--;
+    }
+    return err;
+}
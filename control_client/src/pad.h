@@ -2,13 +2,33 @@
 #define _PAD_H_
 
 #include <netinet/in.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/socket.h>
 
+#include "../../packets/packet.h"
+
+/* Maximum number of control requests which may await an acknowledgement from the pad at once */
+#define PAD_MAX_IN_FLIGHT 8
+
+/* Arming level of a pad which is not known */
+#define PAD_LEVEL_UNKNOWN (-1)
+
+/* A control request awaiting its acknowledgement */
+typedef struct {
+    bool used;            /* Whether this slot holds a request */
+    uint16_t seq;         /* Sequence number of the request */
+    cntrl_subtype_e kind; /* Sub-type of the acknowledgement expected for the request */
+} pad_request_t;
+
 /* Represents the pad control system server */
 typedef struct {
-    int sock;                /* Connection to server */
-    struct sockaddr_in addr; /* Address of server */
+    int sock;                                  /* Connection to server */
+    struct sockaddr_in addr;                   /* Address of server */
+    uint16_t next_seq;                         /* Sequence number of the next request */
+    unsigned int in_flight;                    /* Number of requests awaiting acknowledgement */
+    pad_request_t requests[PAD_MAX_IN_FLIGHT]; /* Requests awaiting acknowledgement */
+    int arm_level;                             /* Expected arming level, or PAD_LEVEL_UNKNOWN */
 } pad_t;
 
 int pad_init(pad_t *pad, const char *ip, uint16_t port);
@@ -17,5 +37,10 @@ int pad_connect_forever(pad_t *pad);
 int pad_disconnect(pad_t *pad);
 ssize_t pad_send(pad_t *pad, struct iovec *iov, ssize_t iovlen);
 ssize_t pad_recv(pad_t *pad, void *buf, ssize_t n);
+int pad_send_request(pad_t *pad, cntrl_subtype_e kind, cntrl_subtype_e ack_kind, void *body, size_t len);
+int pad_request_begin(pad_t *pad, cntrl_subtype_e kind, uint16_t *seq);
+void pad_request_cancel(pad_t *pad, uint16_t seq);
+bool pad_request_pending(const pad_t *pad, cntrl_subtype_e kind);
+int pad_request_end(pad_t *pad, uint16_t seq, cntrl_subtype_e kind);
 
 #endif // _PAD_H_
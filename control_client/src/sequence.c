@@ -0,0 +1,105 @@
+#include <errno.h>
+#include <stdio.h>
+
+#include "sequence.h"
+
+/*
+ * Load an actuation sequence from a text file. Each line holds one step as its offset in milliseconds from the start
+ * of the sequence (at most SEQ_OFFSET_MAX), the actuator ID and the state (0 or 1), separated by spaces. Blank lines
+ * and lines starting with '#' are ignored.
+ * @param path The path of the sequence file.
+ * @param steps The buffer to load the steps into.
+ * @param max The number of steps `steps` can hold.
+ * @param n Set to the number of steps loaded.
+ * @return 0 on success, E2BIG if the file holds too many steps, EINVAL if a line is malformed, errno code otherwise.
+ */
+int sequence_load(const char *path, seq_step_p *steps, size_t max, size_t *n) {
+    char line[128];
+    unsigned long offset;
+    unsigned int id;
+    unsigned int state;
+    unsigned int lineno = 0;
+    int err = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL) return errno;
+
+    *n = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        if (sscanf(line, "%lu %u %u", &offset, &id, &state) != 3 || offset > SEQ_OFFSET_MAX || id > UINT8_MAX ||
+            state > 1) {
+            fprintf(stderr, "%s:%u: Expected '<offset ms> <actuator ID> <0|1>'\n", path, lineno);
+            err = EINVAL;
+            break;
+        }
+        if (*n == max) {
+            err = E2BIG;
+            break;
+        }
+        steps[*n].offset = offset;
+        steps[*n].id = id;
+        steps[*n].state = state;
+        (*n)++;
+    }
+
+    fclose(f);
+    return err;
+}
+
+/*
+ * Get the number of upload requests needed for a sequence.
+ * @param n The number of steps in the sequence.
+ * @return The number of upload requests.
+ */
+size_t sequence_uploads(size_t n) { return n == 0 ? 1 : (n + SEQ_UPLOAD_MAX - 1) / SEQ_UPLOAD_MAX; }
+
+/*
+ * Upload an actuation sequence to the pad, replacing the one it holds, without waiting for acknowledgements. There must
+ * be room for `sequence_uploads(n)` requests in flight.
+ * @param pad The pad connection
+ * @param steps The steps of the sequence.
+ * @param n The number of steps, at most SEQUENCE_FILE_MAX_STEPS.
+ * @return 0 if okay, an errno otherwise
+ */
+int sequence_upload(pad_t *pad, const seq_step_p *steps, size_t n) {
+    seq_upload_p req;
+    size_t first = 0;
+    int err;
+
+    if (n > SEQUENCE_FILE_MAX_STEPS) return E2BIG;
+
+    do {
+        packet_seq_upload_init(&req, 0, first);
+        for (; first < n && req.count < SEQ_UPLOAD_MAX; first++) {
+            packet_seq_upload_add(&req, steps[first].offset, steps[first].id, steps[first].state);
+        }
+
+        err = pad_send_request(pad, CNTRL_SEQ_UPLOAD_REQ, CNTRL_SEQ_ACK, &req, sizeof(req));
+        if (err) return err;
+    } while (first < n);
+
+    return 0;
+}
+
+/*
+ * Start or abort the actuation sequence uploaded to the pad, without waiting for the acknowledgement.
+ * @param pad The pad connection
+ * @param run True to start the sequence, false to abort it.
+ * @return 0 if okay, an errno otherwise
+ */
+int sequence_run(pad_t *pad, bool run) {
+    seq_run_req_p req;
+    int err;
+
+    packet_seq_run_req_init(&req, 0, run);
+    err = pad_send_request(pad, CNTRL_SEQ_RUN_REQ, CNTRL_SEQ_ACK, &req, sizeof(req));
+
+    /* The steps of a sequence can move the arming level along */
+
+    if (!err && run) pad->arm_level = PAD_LEVEL_UNKNOWN;
+    return err;
+}
@@ -0,0 +1,18 @@
+#ifndef _CONTROL_SEQUENCE_H_
+#define _CONTROL_SEQUENCE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../packets/packet.h"
+#include "pad.h"
+
+/* The most steps of a sequence file, which must be uploaded with at most one request in flight per upload */
+#define SEQUENCE_FILE_MAX_STEPS (SEQ_UPLOAD_MAX * PAD_MAX_IN_FLIGHT)
+
+int sequence_load(const char *path, seq_step_p *steps, size_t max, size_t *n);
+size_t sequence_uploads(size_t n);
+int sequence_upload(pad_t *pad, const seq_step_p *steps, size_t n);
+int sequence_run(pad_t *pad, bool run);
+
+#endif // _CONTROL_SEQUENCE_H_
@@ -1,24 +1,47 @@
 #include <errno.h>
 #include <stdbool.h>
+#include <string.h>
 
+#include "../../pad_server/src/arming.h"
 #include "pad.h"
 #include "switch.h"
 
 /*
- * Verifies the response of an arming command.
+ * Receive exactly `n` bytes from the pad.
  * @param pad The pad connection
- * @return 0 on success, errno code on failure.
+ * @param buf The destination buffer, at least `n` bytes long.
+ * @param n The number of bytes to receive.
+ * @return 0 on success, ENOTCONN if the pad disconnected, EAGAIN or EWOULDBLOCK if the receive timeout expired before
+ * any byte arrived, ETIMEDOUT if it expired after some did, errno code on failure.
  */
-static int check_arm_response(pad_t *pad) {
-    int err;
-    arm_ack_p arm_ack;
+static int switch_recv_exact(pad_t *pad, void *buf, size_t n) {
+    size_t got = 0;
+    ssize_t bread;
+
+    while (got < n) {
+        bread = pad_recv(pad, (uint8_t *)buf + got, n - got);
+        if (bread < 0) {
+            if (errno == EINTR) continue;
+
+            /* The bytes received so far are lost, so the next read would start in the middle of a message */
 
-    err = pad_recv(pad, &arm_ack, sizeof(arm_ack));
-    if (err == -1) {
-        return errno;
+            if (got > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return ETIMEDOUT;
+            return errno;
+        } else if (bread == 0) {
+            return ENOTCONN;
+        }
+        got += bread;
     }
+    return 0;
+}
 
-    switch (arm_ack.status) {
+/*
+ * Converts the status of an arming acknowledgement to an errno code.
+ * @param status The acknowledgement status
+ * @return 0 on success, errno code on failure.
+ */
+static int arm_status_err(uint8_t status) {
+    switch (status) {
     case ARM_OK:
         return 0;
     case ARM_DENIED:
@@ -31,20 +54,12 @@ static int check_arm_response(pad_t *pad) {
 }
 
 /*
- * Verifies the response of an actuation command.
- * @param pad The pad connection
+ * Converts the status of an actuation acknowledgement to an errno code.
+ * @param status The acknowledgement status
  * @return 0 on success, errno code on failure.
  */
-static int check_act_response(pad_t *pad) {
-    int err;
-    act_ack_p act_ack;
-
-    err = pad_recv(pad, &act_ack, sizeof(act_ack));
-    if (err == -1) {
-        return errno;
-    }
-
-    switch (act_ack.status) {
+static int act_status_err(uint8_t status) {
+    switch (status) {
     case ACT_OK:
         return 0;
     case ACT_DENIED:
@@ -53,68 +68,254 @@ static int check_act_response(pad_t *pad) {
         return ENODEV;
     case ACT_INV:
         return EINVAL;
+    case ACT_BUSY:
+        return EAGAIN;
     }
 
     return 0;
 }
 
 /*
- * Sends a network command to alter the actuator/arming state associated with this switch.
- * @param sw The switch that was flipped
+ * Converts the status of an actuation outcome to an errno code.
+ * @param status The outcome status
+ * @return 0 on success, errno code on failure.
+ */
+static int act_done_err(uint8_t status) {
+    switch (status) {
+    case ACT_DONE_OK:
+        return 0;
+    case ACT_DONE_FAILED:
+        return EIO;
+    case ACT_DONE_CANCELLED:
+        return ECANCELED;
+    }
+
+    return 0;
+}
+
+/*
+ * Converts the status of an actuation sequence acknowledgement to an errno code.
+ * @param status The acknowledgement status
+ * @return 0 on success, errno code on failure.
+ */
+static int seq_status_err(uint8_t status) {
+    switch (status) {
+    case SEQ_OK:
+        return 0;
+    case SEQ_BUSY:
+        return EBUSY;
+    case SEQ_INV:
+        return EINVAL;
+    case SEQ_EMPTY:
+        return ENOENT;
+    }
+
+    return 0;
+}
+
+/*
+ * Sends a single network command flipping several actuator switches at once, without waiting for its acknowledgement.
+ * The pad performs either all of the actuations or none of them.
+ * @param sws The actuator switches that were flipped
+ * @param n The number of switches, at most MULTI_ACT_MAX
  * @param pad The socket with connection to the pad
+ * @return 0 if okay, EBUSY if too many commands are in flight, an errno otherwise
+ */
+int switch_group_send(switch_t *const *sws, uint8_t n, pad_t *pad) {
+    multi_act_req_p req;
+    int err;
+
+    packet_multi_act_req_init(&req, 0);
+    for (uint8_t i = 0; i < n; i++) {
+        if (sws[i]->kind != CNTRL_ACT_REQ || packet_multi_act_req_add(&req, sws[i]->act_id, !sws[i]->state) < 0) {
+            return EINVAL;
+        }
+    }
+
+    err = pad_send_request(pad, CNTRL_MULTI_ACT_REQ, CNTRL_MULTI_ACT_ACK, &req, sizeof(req));
+    if (err) return err;
+
+    /* The arming level only moves along once the pad reports the actuations were carried out */
+
+    for (uint8_t i = 0; i < n; i++) {
+        sws[i]->state = !sws[i]->state;
+    }
+    return 0;
+}
+
+/*
+ * Get the arming level a switch's arming command requests.
+ * @param sw The arming switch
  * @param newstate The new state of the switch
- * @return 0 if okay, an errno otherwise
+ * @return The requested arming level, which may not be valid
  */
-int switch_callback(switch_t *sw, pad_t *pad, bool newstate) {
+static int switch_arm_target(const switch_t *sw, bool newstate) { return newstate ? sw->act_id : sw->act_id - 1; }
 
-    /* Header for the command */
+/*
+ * Check a switch's command against the arming level the pad is expected to be at, using the same tables as the pad. The
+ * level is the one last requested, or reported by the pad along with the outcome of an actuation.
+ * Nothing is refused while the arming level is unknown, nor commands which the pad will refuse as invalid anyway.
+ * @param sw The switch being flipped
+ * @param pad The pad the command would be sent to
+ * @param newstate The new state of the switch
+ * @return 0 if the pad is expected to permit the command, EPERM if it is not
+ */
+int switch_check(const switch_t *sw, const pad_t *pad, bool newstate) {
+    int target;
 
-    header_p hdr = {.type = TYPE_CNTRL, .subtype = sw->kind};
+    if (pad->arm_level == PAD_LEVEL_UNKNOWN) return 0;
 
-    /* IOV containing header and space for command body */
+    switch (sw->kind) {
+    case CNTRL_ACT_REQ:
+        if (sw->act_id > ID_DUMP) return 0;
+        return arming_permits(pad->arm_level, sw->act_id) ? 0 : EPERM;
 
-    ssize_t iovlen = 2;
-    struct iovec iov[iovlen];
-    iov[0].iov_base = &hdr;
-    iov[0].iov_len = sizeof(hdr);
+    case CNTRL_ARM_REQ:
+        target = switch_arm_target(sw, newstate);
+        if (target < ARMED_PAD || target >= NUM_ARM_LEVELS) return 0;
+        return arming_can_change(pad->arm_level, target) ? 0 : EPERM;
 
-    /* Mark new switch state */
+    default:
+        return 0;
+    }
+}
 
-    sw->state = newstate;
+/*
+ * Sends a network command to alter the actuator/arming state associated with this switch, without waiting for its
+ * acknowledgement.
+ * @param sw The switch that was flipped
+ * @param pad The socket with connection to the pad
+ * @param newstate The new state of the switch
+ * @return 0 if okay, EBUSY if too many commands are in flight, an errno otherwise
+ */
+int switch_send(switch_t *sw, pad_t *pad, bool newstate) {
+    int err;
 
     /* Handle body depending on switch */
 
     switch (sw->kind) {
 
     case CNTRL_ACT_REQ: {
-        act_req_p act_req = {.id = sw->act_id, .state = sw->state};
-        iov[1].iov_base = &act_req;
-        iov[1].iov_len = sizeof(act_req);
-        if (pad_send(pad, iov, iovlen) < 0) {
-            return errno;
-        }
-        return check_act_response(pad);
+        act_req_p act_req;
+        packet_act_req_init(&act_req, 0, sw->act_id, newstate);
+        err = pad_send_request(pad, CNTRL_ACT_REQ, CNTRL_ACT_ACK, &act_req, sizeof(act_req));
     } break;
 
     case CNTRL_ARM_REQ: {
 
         /* If the switch was turned ON, send a request for its arming level. If it was turned OFF, go back a level.
          */
-        arm_req_p arm_req = {.level = newstate ? sw->act_id : sw->act_id - 1};
-
-        iov[1].iov_base = &arm_req;
-        iov[1].iov_len = sizeof(arm_req);
-        if (pad_send(pad, iov, iovlen) < 0) {
-            return errno;
-        }
-        return check_arm_response(pad);
+        arm_req_p arm_req;
+        packet_arm_req_init(&arm_req, 0, switch_arm_target(sw, newstate));
+        err = pad_send_request(pad, CNTRL_ARM_REQ, CNTRL_ARM_ACK, &arm_req, sizeof(arm_req));
     } break;
 
     default:
         /* Invalid type of switch */
-        return -EINVAL;
+        return EINVAL;
         break;
     }
 
+    if (err) return err;
+
+    /* Mark new switch state. The pad changes the arming level as soon as it permits an arming command, but an actuation
+     * only moves it along once the pad reports the actuation was carried out. */
+
+    sw->state = newstate;
+    if (sw->kind == CNTRL_ARM_REQ) {
+        int target = switch_arm_target(sw, newstate);
+        pad->arm_level = target >= ARMED_PAD && target < NUM_ARM_LEVELS ? target : PAD_LEVEL_UNKNOWN;
+    }
     return 0;
 }
+
+/*
+ * Receive the next acknowledgement from the pad and match it to the command in flight it answers. The pad also reports
+ * the outcome of every actuation it carried out, which answers no command; the arming level it reports is taken as the
+ * pad's, unless an arming command sent since is still in flight.
+ * @param pad The pad connection
+ * @param ack Set to the acknowledgement or the actuation outcome received, told apart by `ack->kind`
+ * @return 0 if an acknowledgement was received, an errno otherwise. The outcome of the command is in `ack->err`.
+ * EAGAIN or EWOULDBLOCK mean nothing arrived before the receive timeout, and the connection is still usable;
+ * ETIMEDOUT means a message was cut short by it, and the connection is not.
+ */
+int switch_recv_ack(pad_t *pad, switch_ack_t *ack) {
+    header_p hdr;
+    uint8_t body[sizeof(act_done_p)]; /* Fits the largest message the pad sends the controller client */
+    int len;
+    int err;
+
+    err = switch_recv_exact(pad, &hdr, sizeof(hdr));
+    if (err) return err;
+
+    len = packet_cntrl_body_len(hdr.subtype);
+    if (hdr.type != TYPE_CNTRL || len < 0 || (size_t)len > sizeof(body)) {
+        return EPROTO;
+    }
+
+    err = switch_recv_exact(pad, body, len);
+    if (err == EAGAIN || err == EWOULDBLOCK) return ETIMEDOUT; /* The header was consumed without its body */
+    if (err) return err;
+
+    ack->kind = hdr.subtype;
+    ack->index = 0;
+    ack->state = false;
+    switch (hdr.subtype) {
+    case CNTRL_ACT_DONE: {
+        act_done_p done;
+        memcpy(&done, body, sizeof(done));
+        ack->seq = 0;
+        ack->id = done.id;
+        ack->state = done.state;
+        ack->err = act_done_err(done.status);
+        if (done.level < NUM_ARM_LEVELS && !pad_request_pending(pad, CNTRL_ARM_ACK)) {
+            pad->arm_level = done.level;
+        }
+        return 0;
+    }
+
+    case CNTRL_ACT_ACK: {
+        act_ack_p act_ack;
+        memcpy(&act_ack, body, sizeof(act_ack));
+        ack->seq = act_ack.seq;
+        ack->id = act_ack.id;
+        ack->err = act_status_err(act_ack.status);
+    } break;
+
+    case CNTRL_ARM_ACK: {
+        arm_ack_p arm_ack;
+        memcpy(&arm_ack, body, sizeof(arm_ack));
+        ack->seq = arm_ack.seq;
+        ack->id = 0;
+        ack->err = arm_status_err(arm_ack.status);
+    } break;
+
+    case CNTRL_SEQ_ACK: {
+        seq_ack_p seq_ack;
+        memcpy(&seq_ack, body, sizeof(seq_ack));
+        ack->seq = seq_ack.seq;
+        ack->id = 0;
+        ack->err = seq_status_err(seq_ack.status);
+    } break;
+
+    case CNTRL_MULTI_ACT_ACK: {
+        multi_act_ack_p multi_ack;
+        memcpy(&multi_ack, body, sizeof(multi_ack));
+        ack->seq = multi_ack.seq;
+        ack->id = 0;
+        ack->index = multi_ack.index;
+        ack->err = act_status_err(multi_ack.status);
+    } break;
+
+    default:
+        return EPROTO;
+    }
+
+    /* A refused command means the arming level was not what it was expected to be */
+
+    if (ack->err && ack->kind != CNTRL_SEQ_ACK) {
+        pad->arm_level = PAD_LEVEL_UNKNOWN;
+    }
+
+    return pad_request_end(pad, ack->seq, ack->kind);
+}
@@ -14,6 +14,20 @@ typedef struct {
     bool state;           /* State of this switch (on/off) */
 } switch_t;
 
-int switch_callback(switch_t *sw, pad_t *pad, bool newstate);
+/* An acknowledgement of a switch command, or the outcome of an actuation (`kind` being CNTRL_ACT_DONE) */
+
+typedef struct {
+    uint16_t seq;         /* Sequence number of the command acknowledged, 0 for an actuation outcome */
+    cntrl_subtype_e kind; /* The kind of acknowledgement */
+    uint8_t id;           /* Actuator ID of an actuation acknowledgement or outcome */
+    uint8_t index;        /* Index of the actuation which failed a multi-actuator command */
+    bool state;           /* State requested of the actuator, for an actuation outcome */
+    int err;              /* 0 if the command succeeded, an errno otherwise */
+} switch_ack_t;
+
+int switch_check(const switch_t *sw, const pad_t *pad, bool newstate);
+int switch_send(switch_t *sw, pad_t *pad, bool newstate);
+int switch_group_send(switch_t *const *sws, uint8_t n, pad_t *pad);
+int switch_recv_ack(pad_t *pad, switch_ack_t *ack);
 
 #endif // _CONTROL_SWITCH_H_
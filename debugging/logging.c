@@ -0,0 +1,539 @@
+#include "logging.h"
+
+#ifdef HLOG_ASYNC
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "../ringbuf/ringbuf.h"
+
+/*
+ * Asynchronous logging. Instead of formatting a message on the spot, the thread which logs it copies the raw arguments
+ * into a fixed-size record in its own lock-free ring, along with a pointer to the call site's format string. A low
+ * priority logging thread takes the records from every ring, formats them in the order they were logged and writes
+ * them out. A thread which logs faster than the logging thread writes loses records, which are counted and reported,
+ * rather than ever waiting on it.
+ */
+
+/* The maximum number of threads which can log through their own ring. Threads beyond these log synchronously. */
+#define HLOG_MAX_THREADS 16
+
+/* The number of records each thread can buffer */
+#ifdef CONFIG_HYSIM_PAD_SERVER_LOG_RING
+#define HLOG_RING_LEN CONFIG_HYSIM_PAD_SERVER_LOG_RING
+#else
+#define HLOG_RING_LEN 64
+#endif
+
+_Static_assert((HLOG_RING_LEN & (HLOG_RING_LEN - 1)) == 0, "HLOG_RING_LEN must be a power of 2");
+
+/* Bytes of string arguments a record can hold. Longer strings are truncated. */
+#define HLOG_STR_BYTES 64
+
+/* The longest conversion specification supported, including the '%' */
+#define HLOG_SPEC_LEN 32
+
+/* The most records the logging thread takes from each ring at once */
+#define HLOG_FLUSH_BATCH 16
+
+/* How long the logging thread sleeps when there is nothing to write */
+#define HLOG_IDLE_NS 10000000
+
+/* How long to wait for the logging thread to finish writing before flushing at exit */
+#define HLOG_FLUSH_TRIES 100
+
+/* Parsing state of a call site, see `hlog_site_t` */
+enum {
+    HLOG_SITE_NEW,     /* Not parsed yet */
+    HLOG_SITE_PARSING, /* Being parsed by a thread */
+    HLOG_SITE_READY,   /* Argument types are parsed */
+    HLOG_SITE_SYNC,    /* The format is not supported, the site logs synchronously */
+};
+
+/* Types of arguments, as passed through `...` */
+typedef enum {
+    HLOG_INT,
+    HLOG_LONG,
+    HLOG_LLONG,
+    HLOG_SIZE,
+    HLOG_INTMAX,
+    HLOG_PTRDIFF,
+    HLOG_DOUBLE,
+    HLOG_STR,
+    HLOG_PTR,
+    HLOG_NONE,        /* A literal '%' */
+    HLOG_UNSUPPORTED, /* A conversion which cannot be recorded */
+} hlog_type_e;
+
+/* A logged message, waiting to be formatted */
+typedef struct {
+    const hlog_site_t *site;      /* Where the message was logged */
+    unsigned long seq;            /* Order the message was logged in, across every thread */
+    uint8_t nargs;                /* Number of arguments */
+    uint64_t args[HLOG_MAX_ARGS]; /* Raw arguments, or offsets into `strs` for strings */
+    char strs[HLOG_STR_BYTES];    /* Copies of the string arguments */
+} hlog_record_t;
+
+/* The ring of one logging thread */
+typedef struct {
+    ringbuf_t ring;                        /* Records waiting to be written */
+    hlog_record_t slots[HLOG_RING_LEN];    /* Storage for `ring` */
+    atomic_bool claimed;                   /* Whether the ring is ready for the logging thread to read */
+    unsigned long dropped;                 /* Drops already reported, only used by the logging thread */
+    hlog_record_t batch[HLOG_FLUSH_BATCH]; /* Records taken by the logging thread, only used by it */
+    size_t nbatch;                         /* Number of records in `batch` */
+    size_t next;                           /* Next record of `batch` to write */
+} hlog_ring_t;
+
+static hlog_ring_t hlog_rings[HLOG_MAX_THREADS];
+static atomic_uint hlog_nrings;
+static atomic_ulong hlog_seq;
+
+static pthread_key_t hlog_key;
+static pthread_once_t hlog_key_once = PTHREAD_ONCE_INIT;
+
+/* Serializes the logging thread and flushes at exit, since each ring can only have one reader */
+static pthread_mutex_t hlog_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Marks a thread which found every ring taken */
+static char hlog_no_ring;
+
+static void hlog_key_create(void) { pthread_key_create(&hlog_key, NULL); }
+
+/*
+ * Get the calling thread's ring, claiming one the first time the thread logs.
+ * @return The thread's ring, NULL if every ring is taken.
+ */
+static hlog_ring_t *hlog_thread_ring(void) {
+    hlog_ring_t *ring;
+    void *cur;
+    unsigned int i;
+
+    pthread_once(&hlog_key_once, hlog_key_create);
+    cur = pthread_getspecific(hlog_key);
+    if (cur == &hlog_no_ring) return NULL;
+    if (cur != NULL) return cur;
+
+    i = atomic_fetch_add(&hlog_nrings, 1);
+    if (i >= HLOG_MAX_THREADS) {
+        pthread_setspecific(hlog_key, &hlog_no_ring);
+        return NULL;
+    }
+
+    ring = &hlog_rings[i];
+    if (ringbuf_init(&ring->ring, ring->slots, sizeof(ring->slots[0]), HLOG_RING_LEN) != 0) {
+        pthread_setspecific(hlog_key, &hlog_no_ring); /* Log synchronously rather than drop every message */
+        return NULL;
+    }
+    atomic_store_explicit(&ring->claimed, true, memory_order_release);
+    pthread_setspecific(hlog_key, ring);
+    return ring;
+}
+
+/*
+ * Parse the conversion specification at `*fmt`, which points just past a '%'.
+ * @param fmt The format string, advanced past the conversion.
+ * @param spec Where to copy the whole conversion specification, including the '%'.
+ * @param len The size of `spec`.
+ * @return The type of argument the conversion takes, HLOG_UNSUPPORTED if it does not fit in `spec`.
+ */
+static hlog_type_e hlog_parse_spec(const char **fmt, char *spec, size_t len) {
+    const char *start = *fmt - 1;
+    const char *p = *fmt;
+    hlog_type_e type = HLOG_INT;
+    bool is_long = false;
+
+    if (*p == '%') {
+        *fmt = p + 1;
+        return HLOG_NONE;
+    }
+
+    /* Flags, width and precision. Widths and precisions taken as arguments are not supported. */
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    /* Length modifiers */
+
+    if (p[0] == 'h') {
+        p += p[1] == 'h' ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        type = HLOG_LLONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        type = HLOG_LONG;
+        is_long = true;
+        p++;
+    } else if (p[0] == 'z') {
+        type = HLOG_SIZE;
+        p++;
+    } else if (p[0] == 'j') {
+        type = HLOG_INTMAX;
+        p++;
+    } else if (p[0] == 't') {
+        type = HLOG_PTRDIFF;
+        p++;
+    }
+
+    switch (*p) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        break;
+    case 'c':
+        if (type != HLOG_INT) type = HLOG_UNSUPPORTED;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        type = (type == HLOG_INT || is_long) ? HLOG_DOUBLE : HLOG_UNSUPPORTED;
+        break;
+    case 's':
+        type = type == HLOG_INT ? HLOG_STR : HLOG_UNSUPPORTED;
+        break;
+    case 'p':
+        type = type == HLOG_INT ? HLOG_PTR : HLOG_UNSUPPORTED;
+        break;
+    default:
+        return HLOG_UNSUPPORTED;
+    }
+
+    p++;
+    *fmt = p;
+
+    if ((size_t)(p - start) >= len) return HLOG_UNSUPPORTED;
+    memcpy(spec, start, p - start);
+    spec[p - start] = '\0';
+    return type;
+}
+
+/*
+ * Parse the argument types of a call site's format string, caching them in the site. The first thread to log from a
+ * site parses it; any other thread which logs from it in the meantime parses its own copy.
+ * @param site The call site.
+ * @param types Where to store the argument types.
+ * @param nargs Where to store the number of arguments.
+ * @return True if the message can be recorded, false if it must be logged synchronously.
+ */
+static bool hlog_parse_site(hlog_site_t *site, uint8_t *types, uint8_t *nargs) {
+    uint8_t expected = HLOG_SITE_NEW;
+    uint8_t parsed = atomic_load_explicit(&site->parsed, memory_order_acquire);
+    const char *p = site->fmt;
+    char spec[HLOG_SPEC_LEN];
+    bool owner;
+    hlog_type_e type;
+    bool ok = true;
+
+    if (parsed == HLOG_SITE_READY) {
+        memcpy(types, site->types, site->nargs);
+        *nargs = site->nargs;
+        return true;
+    }
+    if (parsed == HLOG_SITE_SYNC) return false;
+
+    owner = parsed == HLOG_SITE_NEW &&
+            atomic_compare_exchange_strong(&site->parsed, &expected, (uint8_t)HLOG_SITE_PARSING);
+
+    *nargs = 0;
+    while (ok && (p = strchr(p, '%')) != NULL) {
+        p++;
+        type = hlog_parse_spec(&p, spec, sizeof(spec));
+        if (type == HLOG_NONE) continue;
+        if (type == HLOG_UNSUPPORTED || *nargs == HLOG_MAX_ARGS) {
+            ok = false;
+            break;
+        }
+        types[(*nargs)++] = type;
+    }
+
+    if (owner) {
+        memcpy(site->types, types, *nargs);
+        site->nargs = *nargs;
+        atomic_store_explicit(&site->parsed, ok ? HLOG_SITE_READY : HLOG_SITE_SYNC, memory_order_release);
+    }
+    return ok;
+}
+
+/*
+ * Log a message. Use the `herr`, `hwarn` and `hinfo` macros rather than calling this directly.
+ * @param site The call site, which holds the level and format string.
+ * @param fmt The format string of the call site, so that the compiler checks the arguments against it.
+ */
+void hlog_write(hlog_site_t *site, const char *fmt, ...) {
+    hlog_ring_t *ring = hlog_thread_ring();
+    hlog_record_t rec;
+    uint8_t types[HLOG_MAX_ARGS];
+    size_t str_used = 0;
+    size_t str_avail;
+    size_t str_len;
+    const char *str;
+    double d;
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    if (ring == NULL || !hlog_parse_site(site, types, &rec.nargs)) {
+        vfprintf(site->level == HLOG_INFO ? stdout : stderr, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    rec.site = site;
+    rec.seq = atomic_fetch_add_explicit(&hlog_seq, 1, memory_order_relaxed);
+
+    for (uint8_t i = 0; i < rec.nargs; i++) {
+        switch ((hlog_type_e)types[i]) {
+        case HLOG_INT:
+            rec.args[i] = (uint64_t)va_arg(ap, int);
+            break;
+        case HLOG_LONG:
+            rec.args[i] = (uint64_t)va_arg(ap, long);
+            break;
+        case HLOG_LLONG:
+            rec.args[i] = (uint64_t)va_arg(ap, long long);
+            break;
+        case HLOG_SIZE:
+            rec.args[i] = (uint64_t)va_arg(ap, size_t);
+            break;
+        case HLOG_INTMAX:
+            rec.args[i] = (uint64_t)va_arg(ap, intmax_t);
+            break;
+        case HLOG_PTRDIFF:
+            rec.args[i] = (uint64_t)va_arg(ap, ptrdiff_t);
+            break;
+        case HLOG_DOUBLE:
+            d = va_arg(ap, double);
+            memcpy(&rec.args[i], &d, sizeof(d));
+            break;
+        case HLOG_PTR:
+            rec.args[i] = (uint64_t)(uintptr_t)va_arg(ap, void *);
+            break;
+        case HLOG_STR:
+
+            /* Strings may not outlive the call, so copy as much as fits */
+
+            str = va_arg(ap, const char *);
+            if (str == NULL) str = "(null)";
+            str_avail = HLOG_STR_BYTES - 1 - str_used;
+            str_len = strnlen(str, str_avail);
+            memcpy(&rec.strs[str_used], str, str_len);
+            rec.strs[str_used + str_len] = '\0';
+            rec.args[i] = str_used;
+            str_used += str_len < str_avail ? str_len + 1 : str_len;
+            break;
+        default:
+            break;
+        }
+    }
+    va_end(ap);
+
+    /* A full ring drops the record, which the logging thread reports */
+
+    ringbuf_push(&ring->ring, &rec);
+}
+
+/*
+ * Format a record.
+ * @param rec The record to format.
+ * @param out Where to write the message.
+ * @param len The size of `out`.
+ */
+static void hlog_format(const hlog_record_t *rec, char *out, size_t len) {
+    const char *p = rec->site->fmt;
+    const char *pct;
+    char spec[HLOG_SPEC_LEN];
+    size_t used = 0;
+    uint8_t arg = 0;
+    hlog_type_e type;
+    uint64_t v;
+    double d;
+    int n;
+    bool sign;
+
+    while (used < len - 1 && (pct = strchr(p, '%')) != NULL) {
+        n = snprintf(&out[used], len - used, "%.*s", (int)(pct - p), p);
+        used += n > 0 ? (size_t)n : 0;
+        if (used >= len - 1) break;
+
+        p = pct + 1;
+        type = hlog_parse_spec(&p, spec, sizeof(spec));
+        if (type == HLOG_NONE) {
+            out[used++] = '%';
+            out[used] = '\0';
+            continue;
+        }
+        if (type == HLOG_UNSUPPORTED || arg >= rec->nargs) break;
+
+        v = rec->args[arg++];
+        sign = p[-1] == 'd' || p[-1] == 'i';
+
+        switch (type) {
+        case HLOG_INT:
+            n = sign ? snprintf(&out[used], len - used, spec, (int)v)
+                     : snprintf(&out[used], len - used, spec, (unsigned int)v);
+            break;
+        case HLOG_LONG:
+            n = sign ? snprintf(&out[used], len - used, spec, (long)v)
+                     : snprintf(&out[used], len - used, spec, (unsigned long)v);
+            break;
+        case HLOG_LLONG:
+            n = sign ? snprintf(&out[used], len - used, spec, (long long)v)
+                     : snprintf(&out[used], len - used, spec, (unsigned long long)v);
+            break;
+        case HLOG_SIZE:
+            n = sign ? snprintf(&out[used], len - used, spec, (ssize_t)v)
+                     : snprintf(&out[used], len - used, spec, (size_t)v);
+            break;
+        case HLOG_INTMAX:
+            n = sign ? snprintf(&out[used], len - used, spec, (intmax_t)v)
+                     : snprintf(&out[used], len - used, spec, (uintmax_t)v);
+            break;
+        case HLOG_PTRDIFF:
+            n = sign ? snprintf(&out[used], len - used, spec, (ptrdiff_t)v)
+                     : snprintf(&out[used], len - used, spec, (size_t)v);
+            break;
+        case HLOG_DOUBLE:
+            memcpy(&d, &v, sizeof(d));
+            n = snprintf(&out[used], len - used, spec, d);
+            break;
+        case HLOG_STR:
+            n = snprintf(&out[used], len - used, spec, &rec->strs[v]);
+            break;
+        case HLOG_PTR:
+            n = snprintf(&out[used], len - used, spec, (void *)(uintptr_t)v);
+            break;
+        default:
+            n = 0;
+            break;
+        }
+        used += n > 0 ? (size_t)n : 0;
+    }
+
+    if (used < len - 1) {
+        snprintf(&out[used], len - used, "%s", p);
+    } else {
+        out[len - 1] = '\0';
+    }
+}
+
+/*
+ * Refill a ring's batch once every record taken from it was written, and report the records it dropped.
+ * @param ring The ring, which must be claimed.
+ */
+static void hlog_refill(hlog_ring_t *ring) {
+    unsigned long dropped;
+
+    if (ring->next < ring->nbatch) return;
+
+    ring->nbatch = ringbuf_pull(&ring->ring, ring->batch, HLOG_FLUSH_BATCH);
+    ring->next = 0;
+
+    dropped = ringbuf_dropped(&ring->ring);
+    if (dropped != ring->dropped) {
+        fprintf(stderr, "WARN:hlog::Dropped %lu log messages\n", dropped - ring->dropped);
+        ring->dropped = dropped;
+    }
+}
+
+/*
+ * Write every record which was logged before the call, in the order they were logged across every thread. The rings
+ * are merged by sequence number, refilling a ring's batch as soon as it runs out so that its later records are
+ * compared against the other rings before anything newer is written. Records logged during the call are left for the
+ * next one. The flush lock must be held.
+ * @return The number of records written.
+ */
+static size_t hlog_drain(void) {
+    char line[256];
+    hlog_ring_t *ring;
+    hlog_ring_t *oldest;
+    unsigned int nrings = atomic_load(&hlog_nrings);
+    unsigned long end = atomic_load_explicit(&hlog_seq, memory_order_relaxed);
+    size_t written = 0;
+
+    if (nrings > HLOG_MAX_THREADS) nrings = HLOG_MAX_THREADS;
+
+    for (;;) {
+        oldest = NULL;
+        for (unsigned int i = 0; i < nrings; i++) {
+            ring = &hlog_rings[i];
+            if (!atomic_load_explicit(&ring->claimed, memory_order_acquire)) continue;
+
+            hlog_refill(ring);
+            if (ring->next == ring->nbatch) continue;
+            if (oldest == NULL || ring->batch[ring->next].seq < oldest->batch[oldest->next].seq) oldest = ring;
+        }
+
+        /* Stop at the records logged during the call, so that it ends even while other threads keep logging */
+
+        if (oldest == NULL || (long)(oldest->batch[oldest->next].seq - end) >= 0) break;
+
+        hlog_format(&oldest->batch[oldest->next], line, sizeof(line));
+        fputs(line, oldest->batch[oldest->next].site->level == HLOG_INFO ? stdout : stderr);
+        oldest->next++;
+        written++;
+    }
+
+    if (written > 0) fflush(stdout);
+    return written;
+}
+
+/*
+ * Write out every message logged so far. Called at exit, while the logging thread may still be running.
+ */
+void hlog_flush(void) {
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 1000000};
+
+    /* Do not wait forever, in case this is called on the logging thread while it holds the lock */
+
+    for (int i = 0; i < HLOG_FLUSH_TRIES; i++) {
+        if (pthread_mutex_trylock(&hlog_flush_lock) == 0) {
+            hlog_drain();
+            pthread_mutex_unlock(&hlog_flush_lock);
+            return;
+        }
+        nanosleep(&wait, NULL);
+    }
+}
+
+/*
+ * Thread which formats and writes the messages logged by every other thread.
+ * @param arg Unused
+ * @return Never returns
+ */
+void *hlog_run(void *arg) {
+    struct timespec idle = {.tv_sec = 0, .tv_nsec = HLOG_IDLE_NS};
+    size_t written;
+
+    (void)(arg);
+
+    for (;;) {
+        pthread_mutex_lock(&hlog_flush_lock);
+        written = hlog_drain();
+        pthread_mutex_unlock(&hlog_flush_lock);
+
+        if (written == 0) nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+#endif
@@ -11,35 +11,90 @@
 #define str(a) #a
 #define __HLOGSTR(fstring) "%s::" fstring
 
+/* Desktop builds always log asynchronously, NuttX builds only if configured to. See logging.c. */
+
+#if defined(DESKTOP_BUILD) || defined(CONFIG_HYSIM_PAD_SERVER_LOG_ASYNC)
+#define HLOG_ASYNC
+#endif
+
+#ifdef HLOG_ASYNC
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* The maximum number of arguments of a log message, including the function name. Messages with more are written
+ * synchronously. */
+#define HLOG_MAX_ARGS 8
+
+/* Log levels */
+typedef enum {
+    HLOG_ERR,  /* Written to stderr */
+    HLOG_WARN, /* Written to stderr */
+    HLOG_INFO, /* Written to stdout */
+} hlog_level_e;
+
+/* A place in the code which logs a message. Log records refer to it instead of carrying the format string. */
+typedef struct {
+    hlog_level_e level;           /* The level of the message */
+    const char *fmt;              /* The format string of the message */
+    _Atomic uint8_t parsed;       /* Whether the argument types below were parsed from `fmt`, see logging.c */
+    uint8_t nargs;                /* Number of arguments `fmt` takes */
+    uint8_t types[HLOG_MAX_ARGS]; /* Type of each argument */
+} hlog_site_t;
+
+void hlog_write(hlog_site_t *site, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void hlog_flush(void);
+void *hlog_run(void *arg);
+
+/* Records the arguments of a message to be formatted later by the logging thread */
+#define __HLOG(lvl, stream, fstring, ...)                                                                              \
+    do {                                                                                                               \
+        static hlog_site_t __hlog_site = {.level = (lvl), .fmt = (fstring)};                                           \
+        hlog_write(&__hlog_site, fstring __VA_OPT__(, ) __VA_ARGS__);                                                  \
+    } while (0)
+
+#else
+
+/* Formats the message right away */
+#define __HLOG(lvl, stream, fstring, ...) fprintf(stream, fstring __VA_OPT__(, ) __VA_ARGS__)
+
+#endif
+
 /* Syslog wrappers for hysim */
 
 #ifndef DESKTOP_BUILD
 
 #ifdef CONFIG_HYSIM_PAD_SERVER_LOG_ERR
-#define herr(fstring, ...) fprintf(stderr, "ERR:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define herr(fstring, ...)                                                                                             \
+    __HLOG(HLOG_ERR, stderr, "ERR:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
 #else
 #define herr(fstring, ...)
 #endif
 
 #ifdef CONFIG_HYSIM_PAD_SERVER_LOG_WARN
-#define hwarn(fstring, ...) fprintf(stderr, "WARN:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define hwarn(fstring, ...)                                                                                            \
+    __HLOG(HLOG_WARN, stderr, "WARN:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
 #else
 #define hwarn(fstring, ...)
 #endif
 
 #ifdef CONFIG_HYSIM_PAD_SERVER_LOG_INFO
-#define hinfo(fstring, ...) fprintf(stdout, "INFO:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define hinfo(fstring, ...)                                                                                            \
+    __HLOG(HLOG_INFO, stdout, "INFO:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
 #else
 #define hinfo(fstring, ...)
 #endif
 
 #else
 
-/* Desktop build uses stdio implementation */
+/* Desktop build uses stdio implementation, through the logging thread */
 
-#define herr(fstring, ...) fprintf(stderr, "ERR:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
-#define hwarn(fstring, ...) fprintf(stderr, "WARN:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
-#define hinfo(fstring, ...) fprintf(stdout, "INFO:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define herr(fstring, ...)                                                                                             \
+    __HLOG(HLOG_ERR, stderr, "ERR:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define hwarn(fstring, ...)                                                                                            \
+    __HLOG(HLOG_WARN, stderr, "WARN:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
+#define hinfo(fstring, ...)                                                                                            \
+    __HLOG(HLOG_INFO, stdout, "INFO:"__HLOGSTR(fstring), __FUNCTION__ __VA_OPT__(, ) __VA_ARGS__)
 
 #endif
 
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "packet.h"
 
 const char *WARNING_STR[] = {
@@ -13,6 +15,19 @@ const char *ARMING_STR[] = {
     [ARMED_LAUNCH] = "Armed for launch",
 };
 
+const char *CONN_STATUS_STR[] = {
+    [CONN_CONNECTED] = "Connected",
+    [CONN_RECONNECTING] = "Reconnecting",
+    [CONN_DISCONNECTED] = "Disconnected",
+};
+
+const char *STEP_STATUS_STR[] = {
+    [STEP_OK] = "Done",
+    [STEP_DENIED] = "Denied",
+    [STEP_FAILED] = "Failed",
+    [STEP_ABORTED] = "Aborted",
+};
+
 /* PACKET HEADERS */
 
 void packet_header_init(header_p *hdr, packet_type_e type, uint8_t subtype) {
@@ -20,21 +35,169 @@ void packet_header_init(header_p *hdr, packet_type_e type, uint8_t subtype) {
     hdr->subtype = subtype;
 }
 
+void packet_telem_frame_init(telem_frame_p *frame, uint32_t seq, uint8_t count, uint16_t len) {
+    frame->seq = seq;
+    frame->count = count;
+    frame->len = len;
+}
+
+/*
+ * Get the length of the body of a telemetry record.
+ * @param subtype The telemetry sub-type of the record.
+ * @return The length of the record body in bytes, or 0 if the sub-type is unknown.
+ */
+size_t packet_telem_body_len(uint8_t subtype) {
+    switch ((telem_subtype_e)subtype) {
+    case TELEM_TEMP:
+        return sizeof(temp_p);
+    case TELEM_PRESSURE:
+        return sizeof(pressure_p);
+    case TELEM_MASS:
+        return sizeof(mass_p);
+    case TELEM_THRUST:
+        return sizeof(thrust_p);
+    case TELEM_ARM:
+        return sizeof(arm_state_p);
+    case TELEM_ACT:
+        return sizeof(act_state_p);
+    case TELEM_WARN:
+        return sizeof(warn_p);
+    case TELEM_CONT:
+        return sizeof(continuity_state_p);
+    case TELEM_CONN:
+        return sizeof(conn_status_p);
+    case TELEM_SEQ_STEP:
+        return sizeof(seq_step_state_p);
+    case TELEM_TRACE:
+        return sizeof(trace_p);
+    }
+    return 0;
+}
+
+/*
+ * Get the length of the body of a control message.
+ * @param subtype The control sub-type of the message.
+ * @return The length of the message body in bytes, or -1 if the sub-type is unknown.
+ */
+int packet_cntrl_body_len(uint8_t subtype) {
+    switch ((cntrl_subtype_e)subtype) {
+    case CNTRL_ACT_REQ:
+        return sizeof(act_req_p);
+    case CNTRL_ACT_ACK:
+        return sizeof(act_ack_p);
+    case CNTRL_ARM_REQ:
+        return sizeof(arm_req_p);
+    case CNTRL_ARM_ACK:
+        return sizeof(arm_ack_p);
+    case CNTRL_KEYFRAME_REQ:
+        return 0;
+    case CNTRL_MULTI_ACT_REQ:
+        return sizeof(multi_act_req_p);
+    case CNTRL_MULTI_ACT_ACK:
+        return sizeof(multi_act_ack_p);
+    case CNTRL_SEQ_UPLOAD_REQ:
+        return sizeof(seq_upload_p);
+    case CNTRL_SEQ_RUN_REQ:
+        return sizeof(seq_run_req_p);
+    case CNTRL_SEQ_ACK:
+        return sizeof(seq_ack_p);
+    case CNTRL_ACT_DONE:
+        return sizeof(act_done_p);
+    }
+    return -1;
+}
+
 /* CONTROL MESSAGES */
 
-void packet_act_req_init(act_req_p *req, uint8_t id, bool state) {
+void packet_act_req_init(act_req_p *req, uint16_t seq, uint8_t id, bool state) {
+    req->seq = seq;
     req->id = id;
     req->state = state ? 1 : 0;
 }
 
-void packet_act_ack_init(act_ack_p *ack, uint8_t id, act_ack_status_e status) {
+void packet_act_ack_init(act_ack_p *ack, uint16_t seq, uint8_t id, act_ack_status_e status) {
+    ack->seq = seq;
     ack->id = id;
     ack->status = (uint8_t)status;
 }
 
-void packet_arm_req_init(arm_req_p *req, arm_lvl_e level) { req->level = (uint8_t)level; }
+void packet_arm_req_init(arm_req_p *req, uint16_t seq, arm_lvl_e level) {
+    req->seq = seq;
+    req->level = (uint8_t)level;
+}
+
+void packet_arm_ack_init(arm_ack_p *ack, uint16_t seq, arm_ack_status_e status) {
+    ack->seq = seq;
+    ack->status = (uint8_t)status;
+}
+
+void packet_multi_act_req_init(multi_act_req_p *req, uint16_t seq) {
+    memset(req, 0, sizeof(*req));
+    req->seq = seq;
+}
+
+/*
+ * Add an actuation to a multi-actuator request.
+ * @param req The request to add to.
+ * @param id The ID of the actuator.
+ * @param state The state for the actuator to transition to.
+ * @return 0 on success, -1 if the request is already full.
+ */
+int packet_multi_act_req_add(multi_act_req_p *req, uint8_t id, bool state) {
+    if (req->count >= MULTI_ACT_MAX) return -1;
+    req->acts[req->count].id = id;
+    req->acts[req->count].state = state ? 1 : 0;
+    req->count++;
+    return 0;
+}
+
+void packet_multi_act_ack_init(multi_act_ack_p *ack, uint16_t seq, act_ack_status_e status, uint8_t index) {
+    ack->seq = seq;
+    ack->status = (uint8_t)status;
+    ack->index = index;
+}
+
+void packet_act_done_init(act_done_p *done, uint8_t id, uint32_t time, bool state, act_done_status_e status,
+                         arm_lvl_e level) {
+    done->time = time;
+    done->id = id;
+    done->state = state;
+    done->status = (uint8_t)status;
+    done->level = (uint8_t)level;
+}
+
+void packet_seq_upload_init(seq_upload_p *req, uint16_t seq, uint8_t first) {
+    memset(req, 0, sizeof(*req));
+    req->seq = seq;
+    req->first = first;
+}
+
+/*
+ * Add a step to an actuation sequence upload.
+ * @param req The upload to add to.
+ * @param offset The time of the step in milliseconds after the sequence starts.
+ * @param id The ID of the actuator.
+ * @param state The state for the actuator to transition to.
+ * @return 0 on success, -1 if the upload is already full.
+ */
+int packet_seq_upload_add(seq_upload_p *req, uint32_t offset, uint8_t id, bool state) {
+    if (req->count >= SEQ_UPLOAD_MAX) return -1;
+    req->steps[req->count].offset = offset;
+    req->steps[req->count].id = id;
+    req->steps[req->count].state = state ? 1 : 0;
+    req->count++;
+    return 0;
+}
+
+void packet_seq_run_req_init(seq_run_req_p *req, uint16_t seq, bool run) {
+    req->seq = seq;
+    req->run = run ? 1 : 0;
+}
 
-void packet_arm_ack_init(arm_ack_p *ack, arm_ack_status_e status) { ack->status = (uint8_t)status; }
+void packet_seq_ack_init(seq_ack_p *ack, uint16_t seq, seq_ack_status_e status) {
+    ack->seq = seq;
+    ack->status = (uint8_t)status;
+}
 
 /* TELEMETRY MESSAGES */
 
@@ -88,6 +251,15 @@ void packet_conn_init(conn_status_p *p, uint32_t time, conn_status_e status) {
     p->status = (uint8_t)status;
 }
 
+void packet_trace_init(trace_p *p, uint64_t acquired, uint64_t sent) {
+    p->acquired = acquired;
+    p->sent = sent;
+}
+
 const char *arm_state_str(arm_lvl_e state) { return ARMING_STR[state]; }
 
 const char *warning_str(warn_type_e warning) { return WARNING_STR[warning]; }
+
+const char *conn_status_str(conn_status_e status) { return CONN_STATUS_STR[status]; }
+
+const char *seq_step_status_str(seq_step_status_e status) { return STEP_STATUS_STR[status]; }
@@ -2,6 +2,7 @@
 #define _PACKET_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define PACKED __attribute__((packed))
@@ -14,6 +15,17 @@ typedef struct {
     uint8_t subtype; /* Message sub-type */
 } PACKED header_p;
 
+/* Telemetry frame header, which prefixes every telemetry datagram. It is followed by `count` records, each being a
+ * packet header immediately followed by its body, for a total of `len` bytes. */
+typedef struct {
+    uint32_t seq;  /* Sequence number of the frame, incremented for every frame sent. */
+    uint16_t len;  /* Length in bytes of all the records following the frame header. */
+    uint8_t count; /* Number of records in the frame. */
+} PACKED telem_frame_p;
+
+/* Maximum size of a telemetry datagram, so that a frame fits in one Ethernet MTU without IP fragmentation. */
+#define TELEM_FRAME_MAX 1472
+
 /* Valid packet types */
 typedef enum {
     TYPE_CNTRL = 0, /* Control */
@@ -22,10 +34,17 @@ typedef enum {
 
 /* Valid control message sub-types */
 typedef enum {
-    CNTRL_ACT_REQ = 0, /* Actuation request */
-    CNTRL_ACT_ACK = 1, /* Actuation acknowledgement */
-    CNTRL_ARM_REQ = 2, /* Arming request */
-    CNTRL_ARM_ACK = 3, /* Arming acknowledgement */
+    CNTRL_ACT_REQ = 0,        /* Actuation request */
+    CNTRL_ACT_ACK = 1,        /* Actuation acknowledgement */
+    CNTRL_ARM_REQ = 2,        /* Arming request */
+    CNTRL_ARM_ACK = 3,        /* Arming acknowledgement */
+    CNTRL_KEYFRAME_REQ = 4,   /* Request for a full pad state keyframe, sent to the telemetry socket. Has no body. */
+    CNTRL_MULTI_ACT_REQ = 5,  /* Request to actuate several actuators as one unit */
+    CNTRL_MULTI_ACT_ACK = 6,  /* Acknowledgement of a multi-actuator request */
+    CNTRL_SEQ_UPLOAD_REQ = 7, /* Upload of steps of an actuation sequence */
+    CNTRL_SEQ_RUN_REQ = 8,    /* Request to start or abort the uploaded actuation sequence */
+    CNTRL_SEQ_ACK = 9,        /* Acknowledgement of an actuation sequence request */
+    CNTRL_ACT_DONE = 10,      /* Outcome of an actuation the pad carried out, sent unprompted once it is known */
 } cntrl_subtype_e;
 
 /* Valid telemetry message sub-types */
@@ -39,18 +58,31 @@ typedef enum {
     TELEM_WARN = 6,     /* Warning message */
     TELEM_CONT = 7,     /* Continuity measurement */
     TELEM_CONN = 8,     /* Connection status */
+    TELEM_SEQ_STEP = 9, /* Step of an actuation sequence carried out */
+    TELEM_TRACE = 10,   /* Latency trace of the record which follows it */
 } telem_subtype_e;
 
 /* CONTROL MESSAGES */
 
+/* Every control request carries a sequence number chosen by the sender, which the pad echoes in the acknowledgement so
+ * that several requests can be in flight at once. */
+
+/* A single actuator command */
+typedef struct {
+    uint8_t id;    /* Numerical ID of the actuator */
+    uint8_t state; /* State for the actuator to transition to */
+} PACKED act_cmd_p;
+
 /* Actuation request packet */
 typedef struct {
+    uint16_t seq;  /* Sequence number of the request */
     uint8_t id;    /* Numerical ID of the actuator */
     uint8_t state; /* State for the actuator to transition to */
 } PACKED act_req_p;
 
 /* Actuation acknowledgement packet */
 typedef struct {
+    uint16_t seq;   /* Sequence number of the request being acknowledged */
     uint8_t id;     /* Numerical ID of the actuator */
     uint8_t status; /* Status of actuation request */
 } PACKED act_ack_p;
@@ -61,10 +93,87 @@ typedef enum {
     ACT_DENIED = 1, /* The request was denied due to arming level being too low */
     ACT_DNE = 2,    /* The actuator ID is in the request was not associated with any actuator on the system */
     ACT_INV = 3,    /* The state requested was invalid */
+    ACT_BUSY = 4,   /* Too many actuations are already queued on the actuator's bus */
 } PACKED act_ack_status_e;
 
+/* Outcome of an actuation, sent by the pad once the worker of the actuator's bus carried it out or dropped it. It
+ * answers no request, so it has no sequence number. */
+typedef struct {
+    uint32_t time;  /* Time the actuation completed in milliseconds since power on. */
+    uint8_t id;     /* Numerical ID of the actuator */
+    uint8_t state;  /* State the actuator was to transition to */
+    uint8_t status; /* Outcome of the actuation */
+    uint8_t level;  /* The pad's arming level when the outcome was sent */
+} PACKED act_done_p;
+
+/* Actuation outcomes */
+typedef enum {
+    ACT_DONE_OK = 0,        /* The actuator was put in the requested state */
+    ACT_DONE_FAILED = 1,    /* The actuator could not be set */
+    ACT_DONE_CANCELLED = 2, /* The actuation was dropped from its bus's queue, pre-empted by the dump valve */
+} act_done_status_e;
+
+/* Maximum number of actuators in a multi-actuator request */
+#define MULTI_ACT_MAX 8
+
+/* Multi-actuator request packet. Either every actuation is performed, or none is. */
+typedef struct {
+    uint16_t seq;                  /* Sequence number of the request */
+    uint8_t count;                 /* Number of actuations in use, from 1 to MULTI_ACT_MAX */
+    act_cmd_p acts[MULTI_ACT_MAX]; /* The actuations, performed in order. Entries past `count` are ignored. */
+} PACKED multi_act_req_p;
+
+/* Multi-actuator acknowledgement packet */
+typedef struct {
+    uint16_t seq;   /* Sequence number of the request being acknowledged */
+    uint8_t status; /* Status of the request as a whole, one of the actuation acknowledgement statuses */
+    uint8_t index;  /* Index of the actuation which caused the request to fail, 0 on success */
+} PACKED multi_act_ack_p;
+
+/* Maximum number of steps in one actuation sequence upload */
+#define SEQ_UPLOAD_MAX 8
+
+/* Latest offset of a sequence step, so that step times in microseconds fit the step reports */
+#define SEQ_OFFSET_MAX (UINT32_MAX / 1000)
+
+/* One step of an actuation sequence */
+typedef struct {
+    uint32_t offset; /* Time of the step in milliseconds after the sequence starts */
+    uint8_t id;      /* Numerical ID of the actuator */
+    uint8_t state;   /* State for the actuator to transition to */
+} PACKED seq_step_p;
+
+/* Actuation sequence upload packet. A sequence is uploaded in order, a few steps per packet. */
+typedef struct {
+    uint16_t seq;                     /* Sequence number of the request */
+    uint8_t first;                    /* Index of the first step in this upload, 0 to replace the whole sequence */
+    uint8_t count;                    /* Number of steps in use, from 0 to SEQ_UPLOAD_MAX */
+    seq_step_p steps[SEQ_UPLOAD_MAX]; /* The steps, in order of offset. Entries past `count` are ignored. */
+} PACKED seq_upload_p;
+
+/* Actuation sequence run request packet */
+typedef struct {
+    uint16_t seq; /* Sequence number of the request */
+    uint8_t run;  /* 1 to start the uploaded sequence, 0 to abort the running sequence */
+} PACKED seq_run_req_p;
+
+/* Actuation sequence acknowledgement packet */
+typedef struct {
+    uint16_t seq;   /* Sequence number of the request being acknowledged */
+    uint8_t status; /* Status of the request */
+} PACKED seq_ack_p;
+
+/* Actuation sequence acknowledgement statuses */
+typedef enum {
+    SEQ_OK = 0,    /* The request was processed without any errors */
+    SEQ_BUSY = 1,  /* A sequence is running, so the sequence cannot be changed or started */
+    SEQ_INV = 2,   /* The upload is out of place, too long, out of order, too late, or has an invalid actuator/state */
+    SEQ_EMPTY = 3, /* There is no uploaded sequence to start */
+} seq_ack_status_e;
+
 /* Arming request packet */
 typedef struct {
+    uint16_t seq;  /* Sequence number of the request */
     uint8_t level; /* The new arming level requested */
 } PACKED arm_req_p;
 
@@ -79,6 +188,7 @@ typedef enum {
 
 /* Arming acknowledgement packet */
 typedef struct {
+    uint16_t seq;   /* Sequence number of the request being acknowledged */
     uint8_t status; /* The status of the arming request just issued. */
 } PACKED arm_ack_p;
 
@@ -154,6 +264,33 @@ typedef enum {
     CONTINUITY_HIGH = 1, /* Continuity sensor is reading high, circuit is cloesed. */
 } continuity_state_e;
 
+/* Actuation sequence step message, sent once a step of a running sequence was carried out */
+typedef struct {
+    uint32_t time;      /* Time stamp in milliseconds since power on. */
+    uint32_t scheduled; /* Time the step was due, in microseconds since the sequence started. */
+    uint32_t actual;    /* Time the step was carried out, in microseconds since the sequence started. */
+    uint8_t index;      /* Index of the step in the sequence. */
+    uint8_t id;         /* The numerical ID of the actuator. */
+    uint8_t state;      /* The state requested for the actuator. */
+    uint8_t status;     /* The outcome of the step. */
+} PACKED seq_step_state_p;
+
+/* Actuation sequence step outcomes. A sequence stops at the first step which does not succeed. */
+typedef enum {
+    STEP_OK = 0,      /* The actuator was put in the requested state */
+    STEP_DENIED = 1,  /* The arming level did not permit the actuation */
+    STEP_FAILED = 2,  /* The actuator could not be set */
+    STEP_ABORTED = 3, /* The sequence was aborted before the step was due */
+} seq_step_status_e;
+
+/* Latency trace message. When tracing is enabled, the pad server puts one immediately before each traced record, in the
+ * same frame. Both time stamps are taken on the pad's real-time clock, so that a receiver whose clock is synchronized
+ * with the pad's can measure the latency of the whole path. */
+typedef struct {
+    uint64_t acquired; /* Time the data of the next record was acquired, in microseconds since the epoch. */
+    uint64_t sent;     /* Time the frame was sent, in microseconds since the epoch. */
+} PACKED trace_p;
+
 /* Connection status message */
 typedef struct {
     uint32_t time;  /* Time stamp in milliseconds since power on. */
@@ -169,13 +306,25 @@ typedef enum {
 /* PACKET HEADERS */
 
 void packet_header_init(header_p *hdr, packet_type_e type, uint8_t subtype);
+void packet_telem_frame_init(telem_frame_p *frame, uint32_t seq, uint8_t count, uint16_t len);
+size_t packet_telem_body_len(uint8_t subtype);
+int packet_cntrl_body_len(uint8_t subtype);
 
 /* CONTROL MESSAGES */
 
-void packet_act_req_init(act_req_p *req, uint8_t id, bool state);
-void packet_act_ack_init(act_ack_p *ack, uint8_t id, act_ack_status_e status);
-void packet_arm_req_init(arm_req_p *req, arm_lvl_e level);
-void packet_arm_ack_init(arm_ack_p *ack, arm_ack_status_e status);
+void packet_act_req_init(act_req_p *req, uint16_t seq, uint8_t id, bool state);
+void packet_act_ack_init(act_ack_p *ack, uint16_t seq, uint8_t id, act_ack_status_e status);
+void packet_arm_req_init(arm_req_p *req, uint16_t seq, arm_lvl_e level);
+void packet_arm_ack_init(arm_ack_p *ack, uint16_t seq, arm_ack_status_e status);
+void packet_multi_act_req_init(multi_act_req_p *req, uint16_t seq);
+int packet_multi_act_req_add(multi_act_req_p *req, uint8_t id, bool state);
+void packet_multi_act_ack_init(multi_act_ack_p *ack, uint16_t seq, act_ack_status_e status, uint8_t index);
+void packet_act_done_init(act_done_p *done, uint8_t id, uint32_t time, bool state, act_done_status_e status,
+                         arm_lvl_e level);
+void packet_seq_upload_init(seq_upload_p *req, uint16_t seq, uint8_t first);
+int packet_seq_upload_add(seq_upload_p *req, uint32_t offset, uint8_t id, bool state);
+void packet_seq_run_req_init(seq_run_req_p *req, uint16_t seq, bool run);
+void packet_seq_ack_init(seq_ack_p *ack, uint16_t seq, seq_ack_status_e status);
 
 /* TELEMETRY MESSAGES */
 
@@ -188,8 +337,11 @@ void packet_act_state_init(act_state_p *p, uint8_t id, uint32_t time, bool state
 void packet_warn_init(warn_p *p, uint32_t time, warn_type_e type);
 void packet_continuity_state_init(continuity_state_p *p, uint32_t time, continuity_state_e state);
 void packet_conn_init(conn_status_p *p, uint32_t time, conn_status_e status);
+void packet_trace_init(trace_p *p, uint64_t acquired, uint64_t sent);
 
 const char *warning_str(warn_type_e warning);
 const char *arm_state_str(arm_lvl_e state);
+const char *conn_status_str(conn_status_e status);
+const char *seq_step_status_str(seq_step_status_e status);
 
 #endif // _PACKET_H_
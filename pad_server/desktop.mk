@@ -5,6 +5,8 @@ OUT = pad
 SRCDIR = $(abspath ./src)
 SRCS = $(wildcard $(SRCDIR)/*.c)
 SRCS += $(wildcard ../packets/*.c)
+SRCS += $(wildcard ../ringbuf/*.c)
+SRCS += $(wildcard ../debugging/*.c)
 
 EXCLUDE_SRCS = $(SRCDIR)/gpio_actuator.c
 EXCLUDE_SRCS += $(SRCDIR)/pwm_actuator.c
@@ -13,16 +15,25 @@ SRCS := $(filter-out $(EXCLUDE_SRCS), $(SRCS))
 
 OBJS = $(patsubst %.c,%.o,$(SRCS))
 
-all: $(OUT)
+# Replay file converter tool
+
+CONVERT_OUT = replay_convert
+CONVERT_SRCS = $(abspath ./tools/replay_convert.c) $(SRCDIR)/replay.c ../packets/packet.c
+CONVERT_OBJS = $(patsubst %.c,%.o,$(CONVERT_SRCS))
+
+all: $(OUT) $(CONVERT_OUT)
 
 $(OUT): $(OBJS)
 	$(CC) $(CFLAGS) $(OBJS) -o $(OUT)
 
+$(CONVERT_OUT): $(CONVERT_OBJS)
+	$(CC) $(CFLAGS) $(CONVERT_OBJS) -o $(CONVERT_OUT)
+
 %.o: %.c
 	$(CC) $(CFLAGS) $(WARNINGS) -o $@ -c $<
 
 clean:
-	@rm $(OUT)
-	@rm $(OBJS)
+	@rm $(OUT) $(CONVERT_OUT)
+	@rm $(sort $(OBJS) $(CONVERT_OBJS))
 
 
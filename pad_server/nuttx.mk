@@ -13,6 +13,8 @@ MAINSRC = src/pad_server_main.c
 
 CSRCS += $(wildcard src/*.c)
 CSRCS += ../packets/packet.c
+CSRCS += ../ringbuf/ringbuf.c
+CSRCS += ../debugging/logging.c
 CSRCS := $(filter-out src/gpio_dummy_actuator.c, $(CSRCS))
 CSRCS := $(filter-out src/pwm_dummy_actuator.c, $(CSRCS))
 
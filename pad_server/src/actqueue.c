@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../../debugging/logging.h"
+#include "../../debugging/nxassert.h"
+#include "actqueue.h"
+
+/* Helper function for returning an error code from a thread */
+
+#define thread_return(e) pthread_exit((void *)(unsigned long)((e)))
+
+/*
+ * Initialize an empty actuation queue.
+ * @param queue The queue to initialize.
+ * @param name The name of the bus, for logging.
+ * @param on_done Called by the worker after each actuation it carries out, and for each one pre-empted.
+ * @param ctx Passed to `on_done`.
+ * @return 0 on success, error code on failure.
+ */
+int actqueue_init(actqueue_t *queue, const char *name, actqueue_done_f on_done, void *ctx) {
+    int err;
+
+    queue->name = name;
+    queue->head = 0;
+    queue->len = 0;
+    queue->ndropped = 0;
+    queue->on_done = on_done;
+    queue->ctx = ctx;
+
+    err = pthread_mutex_init(&queue->lock, NULL);
+    if (err) return err;
+
+    err = pthread_cond_init(&queue->work, NULL);
+    if (err) return err;
+
+    return pthread_cond_init(&queue->done, NULL);
+}
+
+/*
+ * Lock the queue, so that several actuations can be queued as one unit. Queues must be locked in a fixed order.
+ * @param queue The queue to lock.
+ */
+void actqueue_lock(actqueue_t *queue) { pthread_mutex_lock(&queue->lock); }
+
+/*
+ * Unlock the queue.
+ * @param queue The queue to unlock.
+ */
+void actqueue_unlock(actqueue_t *queue) { pthread_mutex_unlock(&queue->lock); }
+
+/*
+ * Get the number of actuations which can still be queued. The queue must be locked.
+ * @param queue The queue.
+ * @return The number of free entries.
+ */
+unsigned int actqueue_space(actqueue_t *queue) { return ACTQUEUE_LEN - queue->len; }
+
+/*
+ * Report the outcome of an actuation to the caller waiting on it, if any. The queue must be locked.
+ * @param queue The queue the actuation was on.
+ * @param entry The actuation.
+ * @param err 0 on success, errno code on failure.
+ * @param completed When the actuation completed.
+ */
+static void actqueue_complete(actqueue_t *queue, actqueue_entry_t *entry, int err, const struct timespec *completed) {
+    if (entry->done == NULL) return;
+
+    entry->done->err = err;
+    entry->done->completed = *completed;
+    entry->done->complete = true;
+    pthread_cond_broadcast(&queue->done);
+}
+
+/*
+ * Drop every queued actuation which is not critical, so that a critical actuation is carried out next. The dropped
+ * actuations are passed to `on_done` by the worker, since the caller may hold locks `on_done` takes. The queue must be
+ * locked.
+ * @param queue The queue to pre-empt.
+ */
+static void actqueue_preempt(actqueue_t *queue) {
+    struct timespec now;
+    actqueue_entry_t *entry;
+    unsigned int kept = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* Critical actuations which are already queued keep their order */
+
+    for (unsigned int i = 0; i < queue->len; i++) {
+        entry = &queue->entries[(queue->head + i) % ACTQUEUE_LEN];
+        if (entry->critical) {
+            queue->entries[(queue->head + kept) % ACTQUEUE_LEN] = *entry;
+            kept++;
+        } else {
+            hwarn("Pre-empted queued actuation of %s -> %s on the %s bus\n", actuator_get_name(entry->act),
+                  entry->state ? "ON" : "OFF", queue->name);
+            actqueue_complete(queue, entry, ECANCELED, &now);
+            if (queue->ndropped < ACTQUEUE_LEN) {
+                queue->dropped[queue->ndropped++] = *entry;
+            }
+        }
+    }
+    queue->len = kept;
+}
+
+/*
+ * Queue an actuation for the bus's worker. The queue must be locked and have space (see `actqueue_space`).
+ * @param queue The queue.
+ * @param act The actuator to actuate.
+ * @param state The state to put the actuator in.
+ * @param critical Whether the actuation is critical, in which case every queued actuation which is not is dropped.
+ * @param done Where to report the outcome, which must stay valid until it is complete. NULL if no caller waits on it.
+ */
+void actqueue_push(actqueue_t *queue, actuator_t *act, bool state, bool critical, actqueue_done_t *done) {
+    actqueue_entry_t *entry;
+
+    nxassert(queue->len < ACTQUEUE_LEN);
+
+    if (critical) {
+        actqueue_preempt(queue);
+    }
+
+    if (done != NULL) {
+        done->complete = false;
+    }
+
+    entry = &queue->entries[(queue->head + queue->len) % ACTQUEUE_LEN];
+    entry->act = act;
+    entry->state = state;
+    entry->critical = critical;
+    entry->done = done;
+    queue->len++;
+
+    pthread_cond_signal(&queue->work);
+}
+
+/*
+ * Wait for a queued actuation to complete.
+ * @param queue The queue the actuation is on.
+ * @param done The outcome passed when the actuation was queued.
+ * @return 0 on success, ECANCELED if the actuation was pre-empted, errno code if it failed.
+ */
+int actqueue_wait(actqueue_t *queue, actqueue_done_t *done) {
+    pthread_mutex_lock(&queue->lock);
+    while (!done->complete) {
+        pthread_cond_wait(&queue->done, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return done->err;
+}
+
+/*
+ * Thread which carries out the actuations queued on a bus, in order.
+ * @param arg A pointer to the queue of the bus, of type `actqueue_t`
+ * @return 0 on success, error code on failure (thread dies)
+ */
+void *actqueue_run(void *arg) {
+    actqueue_t *queue = arg;
+    actqueue_entry_t entry;
+    actqueue_entry_t dropped[ACTQUEUE_LEN];
+    unsigned int ndropped;
+    struct timespec completed;
+    bool taken;
+    int err;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->len == 0 && queue->ndropped == 0) {
+            pthread_cond_wait(&queue->work, &queue->lock);
+        }
+
+        taken = queue->len > 0;
+        if (taken) {
+            entry = queue->entries[queue->head];
+            queue->head = (queue->head + 1) % ACTQUEUE_LEN;
+            queue->len--;
+        }
+
+        ndropped = queue->ndropped;
+        for (unsigned int i = 0; i < ndropped; i++) {
+            dropped[i] = queue->dropped[i];
+        }
+        queue->ndropped = 0;
+        pthread_mutex_unlock(&queue->lock);
+
+        /* The bus is only locked to take the actuation, so more can be queued while the actuator moves. The actuation
+         * which pre-empted the others goes first, and the pre-empted ones are reported after it. */
+
+        if (taken) {
+            err = actuator_set(entry.act, entry.state) == -1 ? errno : 0;
+            clock_gettime(CLOCK_MONOTONIC, &completed);
+
+            queue->on_done(queue->ctx, entry.act, entry.state, err);
+
+            pthread_mutex_lock(&queue->lock);
+            actqueue_complete(queue, &entry, err, &completed);
+            pthread_mutex_unlock(&queue->lock);
+        }
+
+        for (unsigned int i = 0; i < ndropped; i++) {
+            queue->on_done(queue->ctx, dropped[i].act, dropped[i].state, ECANCELED);
+        }
+    }
+
+    nxfail("actqueue_run exited");
+    thread_return(0);
+}
@@ -0,0 +1,62 @@
+#ifndef _ACTQUEUE_H_
+#define _ACTQUEUE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "actuator.h"
+
+/* The maximum number of actuations which can wait on one bus */
+#ifdef CONFIG_HYSIM_PAD_SERVER_ACTUATION_QUEUE
+#define ACTQUEUE_LEN CONFIG_HYSIM_PAD_SERVER_ACTUATION_QUEUE
+#else
+#define ACTQUEUE_LEN 32
+#endif
+
+/* Outcome of a queued actuation, for a caller which waits on it */
+typedef struct {
+    bool complete;             /* Whether the actuation was carried out or dropped */
+    int err;                   /* 0 on success, errno code on failure, ECANCELED if it was pre-empted */
+    struct timespec completed; /* When the actuation completed, measured on CLOCK_MONOTONIC */
+} actqueue_done_t;
+
+/* An actuation waiting on a bus */
+typedef struct {
+    actuator_t *act;       /* The actuator to actuate */
+    bool state;            /* The state to put it in */
+    bool critical;         /* Critical actuations pre-empt the others queued on the bus */
+    actqueue_done_t *done; /* Where to report the outcome, NULL if no caller waits on it */
+} actqueue_entry_t;
+
+/* Called by a bus worker after each actuation it carries out or which was pre-empted, with the actuator, its requested
+ * state and the outcome */
+typedef void (*actqueue_done_f)(void *ctx, actuator_t *act, bool state, int err);
+
+/*
+ * Queue of actuations on one actuator bus, carried out in order by the bus's own worker thread so that slow actuators
+ * never hold up the thread which commanded them, nor actuators on other buses.
+ */
+typedef struct {
+    const char *name;                       /* Name of the bus, for logging */
+    pthread_mutex_t lock;                   /* Protects the queue */
+    pthread_cond_t work;                    /* Signalled when actuations are queued */
+    pthread_cond_t done;                    /* Broadcast when an actuation which is waited on completes */
+    actqueue_entry_t entries[ACTQUEUE_LEN]; /* Queued actuations, from `head` */
+    unsigned int head;                      /* Index of the next actuation to carry out */
+    unsigned int len;                       /* Number of queued actuations */
+    actqueue_entry_t dropped[ACTQUEUE_LEN]; /* Pre-empted actuations, which the worker has yet to pass to `on_done` */
+    unsigned int ndropped;                  /* Number of pre-empted actuations in `dropped` */
+    actqueue_done_f on_done;                /* Called after each actuation */
+    void *ctx;                              /* Passed to `on_done` */
+} actqueue_t;
+
+int actqueue_init(actqueue_t *queue, const char *name, actqueue_done_f on_done, void *ctx);
+void actqueue_lock(actqueue_t *queue);
+void actqueue_unlock(actqueue_t *queue);
+unsigned int actqueue_space(actqueue_t *queue);
+void actqueue_push(actqueue_t *queue, actuator_t *act, bool state, bool critical, actqueue_done_t *done);
+int actqueue_wait(actqueue_t *queue, actqueue_done_t *done);
+void *actqueue_run(void *arg);
+
+#endif // _ACTQUEUE_H_
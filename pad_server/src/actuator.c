@@ -1,6 +1,9 @@
+#include <errno.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #include "../../debugging/logging.h"
 #include "state.h"
@@ -33,10 +36,45 @@ static const char *ACTUATOR_STR[] = {
  */
 void actuator_init(actuator_t *act, uint8_t id, actuate_f on, actuate_f off, void *priv) {
     act->id = id;
-    act->state = false;
+    act->states = NULL; /* Bound to the pad state's bitmask by its owner */
     act->on = on;
     act->off = off;
     act->priv = priv;
+    memset(&act->timing, 0, sizeof(act->timing));
+}
+
+/*
+ * Call one of the actuator's control functions and record how long it took.
+ * @param act The actuator to control.
+ * @param actuate The control function to call, `act->on` or `act->off`.
+ * @return The return value of the control function.
+ */
+static int actuator_timed(actuator_t *act, actuate_f actuate) {
+    struct timespec start;
+    struct timespec end;
+    int64_t elapsed;
+    int saved_errno;
+    int err;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    err = actuate(act);
+    saved_errno = errno;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (err == -1) {
+        errno = saved_errno; /* The failure of the control function, not of anything called since */
+        return err;
+    }
+
+    elapsed = (int64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    act->timing.last_ns = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    if (act->timing.last_ns > act->timing.max_ns) {
+        act->timing.max_ns = act->timing.last_ns;
+    }
+    act->timing.total_ns += act->timing.last_ns;
+    act->timing.count++;
+    act->timing.completed = end;
+    return err;
 }
 
 /*
@@ -45,12 +83,11 @@ void actuator_init(actuator_t *act, uint8_t id, actuate_f on, actuate_f off, voi
  * @return 0 for success, an error code on failure.
  */
 int actuator_on(actuator_t *act) {
-    int err = act->on(act);
+    int err = actuator_timed(act, act->on);
     if (err == -1) {
         return err;
     }
-    atomic_store(&act->state, true);
-    hinfo("Actuated %s -> ON\n", actuator_get_name(act));
+    hinfo("Actuated %s -> ON in %lu us\n", actuator_get_name(act), (unsigned long)act->timing.last_ns / 1000);
     return 0;
 }
 
@@ -60,12 +97,11 @@ int actuator_on(actuator_t *act) {
  * @return 0 for an error code on failure.
  */
 int actuator_off(actuator_t *act) {
-    int err = act->off(act);
+    int err = actuator_timed(act, act->off);
     if (err == -1) {
         return err;
     }
-    atomic_store(&act->state, false);
-    hinfo("Actuated %s -> OFF\n", actuator_get_name(act));
+    hinfo("Actuated %s -> OFF in %lu us\n", actuator_get_name(act), (unsigned long)act->timing.last_ns / 1000);
     return 0;
 }
 
@@ -82,9 +118,23 @@ int actuator_set(actuator_t *act, bool new_state) {
     }
 }
 
+/*
+ * Get the current state of the actuator.
+ * @param act The actuator to get the state of.
+ * @return True if the actuator is on, false if it is off.
+ */
+bool actuator_get_state(actuator_t *act) { return (atomic_load(act->states) & ACT_BIT(act->id)) != 0; }
+
 /*
  * Get the string name of the actuator.
  * @param act The actuator to get the string name of.
  * @return The string name of the actuator.
  */
 const char *actuator_get_name(actuator_t *act) { return ACTUATOR_STR[act->id]; }
+
+/*
+ * Get the actuation latency of the actuator. The copy may be torn if the actuator is actuated at the same time.
+ * @param act The actuator to get the latency of.
+ * @param timing Where to copy the latency measurements.
+ */
+void actuator_get_timing(actuator_t *act, act_timing_t *timing) { *timing = act->timing; }
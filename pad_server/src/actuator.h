@@ -4,6 +4,7 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 /* Agreed upon actuator IDs. */
 typedef enum {
@@ -31,22 +32,37 @@ typedef struct actuator actuator_t;
 /* Function for controlling the actuator. */
 typedef int (*actuate_f)(struct actuator *act);
 
+/* Latency of an actuator's on/off function, measured around the call into the driver */
+typedef struct {
+    uint32_t count;            /* Number of successful actuations measured */
+    uint32_t last_ns;          /* Latency of the last actuation in nanoseconds */
+    uint32_t max_ns;           /* Highest latency measured in nanoseconds */
+    uint64_t total_ns;         /* Sum of all latencies measured in nanoseconds, for the mean */
+    struct timespec completed; /* When the last actuation completed, measured on CLOCK_MONOTONIC */
+} act_timing_t;
+
 /*
  * Represents an actuator in the control system.
  * Could be a valve, servo, etc.
  */
 typedef struct actuator {
-    act_id_e id;       /* The unique numeric ID of the actuator */
-    atomic_bool state; /* The actuator state, true being on and false being off*/
-    actuate_f on;      /* Function to turn the actuator on. */
-    actuate_f off;     /* Function to turn the actuator off. */
-    void *priv;        /* Any private information needed by the actuator control functions */
+    act_id_e id;              /* The unique numeric ID of the actuator */
+    _Atomic uint32_t *states; /* Bitmask of all actuator states, bit `id` set when on, kept by the owner */
+    actuate_f on;             /* Function to turn the actuator on. */
+    actuate_f off;            /* Function to turn the actuator off. */
+    void *priv;               /* Any private information needed by the actuator control functions */
+    act_timing_t timing;      /* Actuation latency, written only by the worker of the actuator's bus */
 } actuator_t;
 
+/* Bit of an actuator in a bitmask of actuator states */
+#define ACT_BIT(id) ((uint32_t)1 << (id))
+
 int actuator_on(actuator_t *act);
 int actuator_off(actuator_t *act);
 void actuator_init(actuator_t *act, uint8_t id, actuate_f on, actuate_f off, void *priv);
 int actuator_set(actuator_t *act, bool new_state);
+bool actuator_get_state(actuator_t *act);
 const char *actuator_get_name(actuator_t *act);
+void actuator_get_timing(actuator_t *act, act_timing_t *timing);
 
 #endif // _ACTUATOR_H_
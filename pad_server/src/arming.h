@@ -0,0 +1,123 @@
+#ifndef _ARMING_H_
+#define _ARMING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../packets/packet.h"
+#include "actuator.h"
+
+/* Which actuators each arming level permits, and which levels each level may change to. This header is shared with
+ * the control client, which checks its commands against the same tables before sending them. */
+
+/* Number of arming levels */
+#define NUM_ARM_LEVELS (ARMED_LAUNCH + 1)
+
+/* Bit of an arming level in a bitmask of arming levels */
+#define ARM_BIT(level) ((uint8_t)1 << (level))
+
+/* Every actuator, the dump valve having the highest ID */
+#define ARM_ALL_ACTUATORS (ACT_BIT(ID_DUMP + 1) - 1)
+
+/* Solenoid valves other than the fire valve */
+#define ARM_SOLENOID_VALVES ((ACT_BIT(ID_XV12 + 1) - ACT_BIT(ID_XV1)) & ~ACT_BIT(ID_FIRE_VALVE))
+
+/* Actuators permitted at each arming level. The dump valve is always permitted, so the pad can always be made safe. */
+#define ARM_PERMITS_PAD ACT_BIT(ID_DUMP)
+#define ARM_PERMITS_VALVES (ARM_PERMITS_PAD | ARM_SOLENOID_VALVES)
+#define ARM_PERMITS_IGNITION (ARM_PERMITS_VALVES | ACT_BIT(ID_QUICK_DISCONNECT))
+#define ARM_PERMITS_DISCONNECTED (ARM_PERMITS_IGNITION | ACT_BIT(ID_IGNITER))
+#define ARM_PERMITS_LAUNCH (ARM_PERMITS_DISCONNECTED | ACT_BIT(ID_FIRE_VALVE))
+
+/* Arming levels each level may change to: up by one, back to the valves from anywhere in the firing sequence, and
+ * down to the pad from anywhere. */
+#define ARM_CHANGES_PAD (ARM_BIT(ARMED_PAD) | ARM_BIT(ARMED_VALVES))
+#define ARM_CHANGES_VALVES (ARM_BIT(ARMED_PAD) | ARM_BIT(ARMED_IGNITION))
+#define ARM_CHANGES_IGNITION (ARM_BIT(ARMED_PAD) | ARM_BIT(ARMED_VALVES) | ARM_BIT(ARMED_DISCONNECTED))
+#define ARM_CHANGES_DISCONNECTED (ARM_BIT(ARMED_PAD) | ARM_BIT(ARMED_VALVES) | ARM_BIT(ARMED_LAUNCH))
+#define ARM_CHANGES_LAUNCH (ARM_BIT(ARMED_PAD) | ARM_BIT(ARMED_VALVES))
+
+/* Checked at build time, so that an edit to the tables cannot quietly break the arming rules */
+
+_Static_assert(ARMED_PAD == 0 && NUM_ARM_LEVELS == 5, "Every arming level must have an entry in the tables below");
+_Static_assert(ARM_PERMITS_LAUNCH == ARM_ALL_ACTUATORS, "Every actuator must be permitted once armed for launch");
+_Static_assert((ARM_PERMITS_PAD & ARM_PERMITS_VALVES & ARM_PERMITS_IGNITION & ARM_PERMITS_DISCONNECTED &
+                ARM_PERMITS_LAUNCH & ACT_BIT(ID_DUMP)) != 0,
+               "The dump valve must be permitted at every arming level");
+_Static_assert((ARM_PERMITS_DISCONNECTED & ACT_BIT(ID_FIRE_VALVE)) == 0,
+               "The fire valve must only be permitted once armed for launch");
+_Static_assert((ARM_PERMITS_IGNITION & ACT_BIT(ID_IGNITER)) == 0,
+               "The igniter must only be permitted once the quick disconnect is disconnected");
+_Static_assert((ARM_CHANGES_PAD & ARM_CHANGES_VALVES & ARM_CHANGES_IGNITION & ARM_CHANGES_DISCONNECTED &
+                ARM_CHANGES_LAUNCH & ARM_BIT(ARMED_PAD)) != 0,
+               "Every arming level must be able to disarm to the pad");
+_Static_assert(((ARM_CHANGES_PAD | ARM_CHANGES_VALVES | ARM_CHANGES_IGNITION | ARM_CHANGES_DISCONNECTED |
+                 ARM_CHANGES_LAUNCH) &
+                ~(ARM_BIT(NUM_ARM_LEVELS) - 1)) == 0,
+               "Arming levels may only change to valid levels");
+_Static_assert((ARM_CHANGES_PAD >> (ARMED_PAD + 2)) == 0 && (ARM_CHANGES_VALVES >> (ARMED_VALVES + 2)) == 0 &&
+                   (ARM_CHANGES_IGNITION >> (ARMED_IGNITION + 2)) == 0 &&
+                   (ARM_CHANGES_DISCONNECTED >> (ARMED_DISCONNECTED + 2)) == 0,
+               "Arming levels may only be raised one at a time");
+
+/* Actuators permitted at each arming level, see `ACT_BIT` */
+static const uint32_t ARM_PERMITTED[NUM_ARM_LEVELS] = {
+    [ARMED_PAD] = ARM_PERMITS_PAD,
+    [ARMED_VALVES] = ARM_PERMITS_VALVES,
+    [ARMED_IGNITION] = ARM_PERMITS_IGNITION,
+    [ARMED_DISCONNECTED] = ARM_PERMITS_DISCONNECTED,
+    [ARMED_LAUNCH] = ARM_PERMITS_LAUNCH,
+};
+
+/* Arming levels each arming level may change to, see `ARM_BIT` */
+static const uint8_t ARM_CHANGES[NUM_ARM_LEVELS] = {
+    [ARMED_PAD] = ARM_CHANGES_PAD,
+    [ARMED_VALVES] = ARM_CHANGES_VALVES,
+    [ARMED_IGNITION] = ARM_CHANGES_IGNITION,
+    [ARMED_DISCONNECTED] = ARM_CHANGES_DISCONNECTED,
+    [ARMED_LAUNCH] = ARM_CHANGES_LAUNCH,
+};
+
+/*
+ * Check whether an arming level permits an actuator to be actuated.
+ * @param level A valid arming level
+ * @param id A valid actuator ID
+ * @return True if the actuation is permitted
+ */
+static inline bool arming_permits(arm_lvl_e level, uint8_t id) { return (ARM_PERMITTED[level] & ACT_BIT(id)) != 0; }
+
+/*
+ * Check whether the arming level may change.
+ * @param from The current arming level, which must be valid
+ * @param to A valid arming level to change to
+ * @return True if the change is permitted
+ */
+static inline bool arming_can_change(arm_lvl_e from, arm_lvl_e to) { return (ARM_CHANGES[from] & ARM_BIT(to)) != 0; }
+
+/*
+ * Get the arming level the pad moves to after an actuation. Disconnecting the quick disconnect moves it to
+ * ARMED_DISCONNECTED and firing the igniter to ARMED_LAUNCH; reversing either moves it back a level, where the arming
+ * level may change that way.
+ * @param level The arming level the actuation was permitted at
+ * @param id The actuator ID which was actuated
+ * @param state The state the actuator was put in
+ * @return The new arming level, which is `level` if it does not change
+ */
+static inline arm_lvl_e arming_after_actuation(arm_lvl_e level, uint8_t id, bool state) {
+    arm_lvl_e target;
+
+    if (id == ID_QUICK_DISCONNECT) {
+        target = state ? ARMED_DISCONNECTED : ARMED_IGNITION;
+    } else if (id == ID_IGNITER) {
+        target = state ? ARMED_LAUNCH : ARMED_DISCONNECTED;
+    } else {
+        return level;
+    }
+
+    /* Only advance if not already further along */
+
+    if (state && level >= target) return level;
+    return arming_can_change(level, target) ? target : level;
+}
+
+#endif // _ARMING_H_
@@ -0,0 +1,251 @@
+#ifdef __linux__
+#define _GNU_SOURCE /* sendmmsg */
+#endif
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../../debugging/nxassert.h"
+#include "batch.h"
+
+/* Helper macro to access the header of a queued frame */
+
+#define frame_hdr(batch, i) ((telem_frame_p *)((batch)->frames[(i)]))
+
+/*
+ * Get the time elapsed between two time stamps in microseconds.
+ * @param start The earlier time stamp.
+ * @param end The later time stamp.
+ * @return The elapsed time in microseconds.
+ */
+static uint64_t elapsed_us(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000ull + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/*
+ * Convert a time stamp to microseconds.
+ * @param t The time stamp.
+ * @return The time stamp in microseconds.
+ */
+static uint64_t timespec_us(const struct timespec *t) { return t->tv_sec * 1000000ull + t->tv_nsec / 1000; }
+
+/*
+ * Initialize a telemetry batch.
+ * @param batch The batch to initialize.
+ * @param sock The telemetry socket the batch is published on.
+ * @param max_delay_us The longest time in microseconds a record may be queued before the batch is flushed.
+ * @param trace Whether to put a latency trace before every record.
+ */
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_sock_t *sock, uint32_t max_delay_us, bool trace) {
+    batch->sock = sock;
+    batch->nframes = 0;
+    batch->max_delay_us = max_delay_us;
+    batch->trace = trace;
+}
+
+/*
+ * Append a record to a frame, which must have room for it.
+ * @param frame The frame to append to.
+ * @param subtype The telemetry sub-type of the record.
+ * @param body The record body.
+ * @param len The length of the record body in bytes.
+ */
+static void frame_append(telem_frame_p *frame, uint8_t subtype, const void *body, size_t len) {
+    uint8_t *pos = (uint8_t *)frame + sizeof(*frame) + frame->len;
+    packet_header_init((header_p *)pos, TYPE_TELEM, subtype);
+    memcpy(pos + sizeof(header_p), body, len);
+    frame->len += sizeof(header_p) + len;
+    frame->count++;
+}
+
+/*
+ * Fill in the send time of every latency trace in a frame. Until now, traces hold the acquisition time on
+ * CLOCK_MONOTONIC, which is the clock the rest of the pad server time stamps with; both are converted to the real-time
+ * clock here, so that receivers can compare them with their own clock.
+ * @param frame The frame about to be sent.
+ * @param mono_us The current time on CLOCK_MONOTONIC in microseconds.
+ * @param real_us The current time on CLOCK_REALTIME in microseconds.
+ */
+static void frame_stamp_traces(telem_frame_p *frame, uint64_t mono_us, uint64_t real_us) {
+    uint8_t *pos = (uint8_t *)frame + sizeof(*frame);
+    header_p *hdr;
+    trace_p *trace;
+
+    for (uint8_t i = 0; i < frame->count; i++) {
+        hdr = (header_p *)pos;
+        pos += sizeof(header_p);
+        if (hdr->subtype == TELEM_TRACE) {
+            trace = (trace_p *)pos;
+            packet_trace_init(trace, trace->acquired - mono_us + real_us, real_us);
+        }
+        pos += packet_telem_body_len(hdr->subtype);
+    }
+}
+
+/*
+ * Queue a telemetry record in the batch. The batch is flushed when it runs out of frames or when its oldest record has
+ * been queued for longer than the batch's maximum delay.
+ * @param batch The batch to queue the record in.
+ * @param subtype The telemetry sub-type of the record.
+ * @param body The record body.
+ * @param len The length of the record body in bytes.
+ * @param acquired When the data of the record was acquired, on CLOCK_MONOTONIC, for its latency trace. NULL if it is
+ * only acquired as the record is queued.
+ * @return 0 for success, error code on failure to flush.
+ */
+int telemetry_batch_add(telemetry_batch_t *batch, uint8_t subtype, const void *body, size_t len,
+                        const struct timespec *acquired) {
+    telem_frame_p *frame;
+    struct timespec now;
+    trace_p trace;
+    size_t size = sizeof(header_p) + len;
+    uint8_t count = 1;
+    int err;
+
+    /* A record and its trace must go in the same frame */
+
+    if (batch->trace) {
+        size += sizeof(header_p) + sizeof(trace_p);
+        count++;
+    }
+
+    nxassert(sizeof(telem_frame_p) + size <= TELEM_FRAME_MAX);
+
+    /* Start a new frame if there is no frame yet, or the record doesn't fit in the current frame */
+
+    frame = batch->nframes > 0 ? frame_hdr(batch, batch->nframes - 1) : NULL;
+    if (frame == NULL || sizeof(*frame) + frame->len + size > TELEM_FRAME_MAX || frame->count > UINT8_MAX - count) {
+
+        if (batch->nframes == TELEMETRY_BATCH_FRAMES) {
+            err = telemetry_batch_flush(batch);
+            if (err) return err;
+        }
+
+        if (batch->nframes == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &batch->oldest);
+        }
+
+        frame = frame_hdr(batch, batch->nframes++);
+        packet_telem_frame_init(frame, 0, 0, 0);
+    }
+
+    /* Append the record after the last record in the frame, with its trace first. The send time is filled in when the
+     * batch is flushed. */
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (batch->trace) {
+        if (acquired == NULL) acquired = &now;
+        packet_trace_init(&trace, timespec_us(acquired), 0);
+        frame_append(frame, TELEM_TRACE, &trace, sizeof(trace));
+    }
+    frame_append(frame, subtype, body, len);
+
+    /* Flush if the oldest record has waited long enough */
+
+    if (elapsed_us(&batch->oldest, &now) >= batch->max_delay_us) {
+        return telemetry_batch_flush(batch);
+    }
+
+    return 0;
+}
+
+/*
+ * Notify the batch that its producer is about to stop adding records for some time. The batch is flushed if its queued
+ * records would otherwise exceed their maximum delay while the producer is idle.
+ * @param batch The batch whose producer is going idle.
+ * @param idle_us The time in microseconds the producer will be idle for.
+ * @return 0 for success, error code on failure to flush.
+ */
+int telemetry_batch_idle(telemetry_batch_t *batch, uint32_t idle_us) {
+    struct timespec now;
+
+    if (batch->nframes == 0) return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (elapsed_us(&batch->oldest, &now) + idle_us >= batch->max_delay_us) {
+        return telemetry_batch_flush(batch);
+    }
+    return 0;
+}
+
+/*
+ * Publish all queued frames. On Linux, all frames are published with a single system call.
+ * @param batch The batch to flush.
+ * @return 0 for success, error code on failure. The batch is emptied either way.
+ */
+int telemetry_batch_flush(telemetry_batch_t *batch) {
+    struct iovec iov[TELEMETRY_BATCH_FRAMES];
+    struct timespec mono;
+    struct timespec real;
+    int cancel_state;
+    int err = 0;
+
+    telemetry_sock_lock(batch->sock, &cancel_state);
+
+    /* Traces are stamped with a single send time, since all frames go out together */
+
+    if (batch->trace) {
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        clock_gettime(CLOCK_REALTIME, &real);
+        for (unsigned int i = 0; i < batch->nframes; i++) {
+            frame_stamp_traces(frame_hdr(batch, i), timespec_us(&mono), timespec_us(&real));
+        }
+    }
+
+    /* Sequence numbers are only assigned now, since the socket is shared with other publishers */
+
+    for (unsigned int i = 0; i < batch->nframes; i++) {
+        telem_frame_p *frame = frame_hdr(batch, i);
+        frame->seq = atomic_fetch_add(&batch->sock->seq, 1);
+        iov[i] = (struct iovec){.iov_base = frame, .iov_len = sizeof(*frame) + frame->len};
+    }
+
+#ifdef __linux__
+    struct mmsghdr msgs[TELEMETRY_BATCH_FRAMES];
+    unsigned int sent = 0;
+
+    for (unsigned int i = 0; i < batch->nframes; i++) {
+        msgs[i] = (struct mmsghdr){
+            .msg_hdr =
+                {
+                    .msg_name = &batch->sock->addr,
+                    .msg_namelen = sizeof(batch->sock->addr),
+                    .msg_iov = &iov[i],
+                    .msg_iovlen = 1,
+                },
+        };
+    }
+
+    /* `sendmmsg` may send fewer messages than requested, so keep going until all are sent */
+
+    while (sent < batch->nframes) {
+        int n = sendmmsg(batch->sock->sock, &msgs[sent], batch->nframes - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            err = errno;
+            break;
+        }
+        sent += n;
+    }
+#else
+    for (unsigned int i = 0; i < batch->nframes; i++) {
+        struct msghdr msg = {
+            .msg_name = &batch->sock->addr,
+            .msg_namelen = sizeof(batch->sock->addr),
+            .msg_iov = &iov[i],
+            .msg_iovlen = 1,
+        };
+        if (sendmsg(batch->sock->sock, &msg, MSG_NOSIGNAL) < 0) {
+            err = errno;
+            break;
+        }
+    }
+#endif
+
+    telemetry_sock_unlock(batch->sock, cancel_state);
+    batch->nframes = 0;
+    return err;
+}
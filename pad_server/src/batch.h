@@ -0,0 +1,39 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../../packets/packet.h"
+#include "telemetry.h"
+
+/* Number of frames that can be queued before the batch must be flushed */
+#ifdef DESKTOP_BUILD
+#define TELEMETRY_BATCH_FRAMES 16
+#else
+#define TELEMETRY_BATCH_FRAMES 2
+#endif
+
+/* Default longest time a record may sit in the batch before the batch is flushed */
+#define TELEMETRY_BATCH_DELAY_US 10000
+
+/* Queue of telemetry records which are packed into frames and published several frames per system call. A batch must
+ * only be used by one thread. */
+typedef struct {
+    telemetry_sock_t *sock;                                  /* The socket the batch is published on */
+    uint8_t frames[TELEMETRY_BATCH_FRAMES][TELEM_FRAME_MAX]; /* Frame headers followed by their records */
+    unsigned int nframes;                                    /* Number of frames holding records */
+    struct timespec oldest;                                  /* Time the oldest queued record was added */
+    uint32_t max_delay_us; /* Longest time a record may be queued before flushing */
+    bool trace;            /* Whether every record is preceded by a latency trace */
+} telemetry_batch_t;
+
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_sock_t *sock, uint32_t max_delay_us, bool trace);
+int telemetry_batch_add(telemetry_batch_t *batch, uint8_t subtype, const void *body, size_t len,
+                        const struct timespec *acquired);
+int telemetry_batch_idle(telemetry_batch_t *batch, uint32_t idle_us);
+int telemetry_batch_flush(telemetry_batch_t *batch);
+
+#endif // _BATCH_H_
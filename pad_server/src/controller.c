@@ -4,15 +4,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "../../debugging/logging.h"
 #include "../../debugging/nxassert.h"
 #include "../../packets/packet.h"
 #include "controller.h"
+#include "deadline.h"
 #include "state.h"
 
 /* Helper function for returning an error code from a thread */
@@ -99,97 +101,94 @@ static int setsock_keepalive(int sockfd) {
 }
 
 /*
- * Initializes the controller to be ready to create a TCP connection.
- * @param controller The controller to initialize.
+ * Create a TCP socket listening for connections.
+ * @param sock Where to store the listening socket.
+ * @param addr Where to store the address the socket is bound to.
  * @param port The port to use for the connection.
+ * @param backlog The number of pending connections to queue.
  * @return 0 for success, or the error that occurred.
  */
-static int controller_init(controller_t *controller, uint16_t port) {
+static int controller_listen(int *sock, struct sockaddr_in *addr, uint16_t port, int backlog) {
     int err;
 
     /* Initialize the socket connection. */
-    controller->sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (controller->sock < 0) return errno;
+    *sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (*sock < 0) return errno;
 
     int opt = 1;
-    err = setsockopt(controller->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    err = setsockopt(*sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     if (err < 0) {
         herr("Failed to set option SO_REUSEADDR: %d\n", errno);
         return errno;
     }
 
     /* Create address */
-    controller->addr.sin_family = AF_INET;
-    controller->addr.sin_addr.s_addr = INADDR_ANY;
-    controller->addr.sin_port = htons(port);
-
-    /* Make sure client socket fd is marked as invalid until it gets a connection */
-    controller->client = -1;
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = INADDR_ANY;
+    addr->sin_port = htons(port);
 
-    if (bind(controller->sock, (struct sockaddr *)&controller->addr, sizeof(controller->addr)) < 0) {
+    if (bind(*sock, (struct sockaddr *)addr, sizeof(*addr)) < 0) {
         herr("Failed to bind: %d\n", errno);
         return errno;
     }
 
+    if (listen(*sock, backlog) < 0) {
+        herr("listen failed: %d\n", errno);
+        return errno;
+    }
+
     return 0;
 }
 
 /*
- * Accept a new connection on the controller client.
- * @param controller The controller to use for the connection.
+ * Initializes the controller to be ready to accept the controller client and observers.
+ * @param controller The controller to initialize.
+ * @param args The controller arguments.
  * @return 0 for success, or the error that occurred.
  */
-static int controller_accept(controller_t *controller) {
-    bool was_connected = false; /* Already had a connection before */
-    struct timeval timeout = {.tv_sec = ABORT_TIMEOUT, .tv_usec = 0};
-    fd_set rfds;
+static int controller_init(controller_t *controller, controller_args_t *args) {
+    struct sockaddr_in observer_addr;
     int err;
 
-    /* Listen for a controller client connection */
-
-    if (listen(controller->sock, MAX_CONTROLLERS) < 0) {
-        if (errno == EADDRINUSE) {
-            was_connected = true;
-            hwarn("Listening more than once...\n");
-        } else {
-            herr("listen failed: %d\n", errno);
-            return errno;
-        }
-    }
-
-    /* If this is our second or more connection, we want to set a time-out on the accept call so that we can abort if no
-     * connection is re-established */
+    err = controller_listen(&controller->sock, &controller->addr, args->port, MAX_CONTROLLERS);
+    if (err) return err;
 
-    if (was_connected) {
-        hwarn("Setting timeout of %lu seconds for re-connect.\n", timeout.tv_sec);
+    err = controller_listen(&controller->observer_sock, &observer_addr, args->observer_port, MAX_OBSERVERS);
+    if (err) return err;
 
-        FD_ZERO(&rfds);
-        FD_SET(controller->sock, &rfds);
+    /* Observers are sent every change in pad state */
 
-        err = select(controller->sock + 1, &rfds, NULL, NULL, &timeout);
-        if (err < 0) {
-            herr("select failed: %d\n", errno);
-            return errno;
-        } else if (err == 0) {
-            /* This indicates a time-out, since `select()` will return the number of bits set in the bit-map on success.
-             */
-            herr("Timed out waiting for new connection, ABORT!\n");
-            nxfail("Timed out waiting for new connection, ABORT!\n");
-            return ETIMEDOUT; /* Just return the error on desktop build */
-        }
+    err = notify_init(&controller->changes);
+    if (err) return err;
 
-        /* If we are here, then the `select()` call returned a 1 and it means we can accept a new connection */
-    }
+    return padstate_subscribe(controller->state, &controller->changes);
+}
 
-    /* Accept the first incoming connection. */
+/*
+ * Accept a new connection from the controller client. Only one controller client is served at a time, so while one is
+ * connected any other connection attempt is refused.
+ * @param controller The controller to use for the connection.
+ * @return 0 for success, or the error that occurred.
+ */
+static int controller_accept(controller_t *controller) {
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int client;
 
-    socklen_t addrlen = sizeof(controller->addr);
-    controller->client = accept(controller->sock, (struct sockaddr *)&controller->addr, &addrlen);
-    if (controller->client < 0) {
+    client = accept(controller->sock, (struct sockaddr *)&addr, &addrlen);
+    if (client < 0) {
         herr("accept failed: %d\n", errno);
         return errno;
     }
 
+    if (controller->client >= 0) {
+        hwarn("Refused a second controller connection.\n");
+        close(client);
+        return EBUSY;
+    }
+
+    controller->client = client;
+    controller->addr = addr;
     return setsock_keepalive(controller->client);
 }
 
@@ -209,6 +208,13 @@ static int controller_sock_disconnect(controller_t *controller) {
         }
         controller->sock = -1;
     }
+    if (controller->observer_sock >= 0) {
+        if (close(controller->observer_sock) < 0) {
+            herr("close failed: %d\n", errno);
+            return errno;
+        }
+        controller->observer_sock = -1;
+    }
     return 0;
 }
 
@@ -227,28 +233,52 @@ static int controller_client_disconnect(controller_t *controller) {
         }
         controller->client = -1;
     }
+    controller->rlen = 0; /* Partial commands from the lost connection are meaningless */
 
     return 0;
 }
 
+/*
+ * Close the connection to an observer, freeing its slot.
+ * @param controller The controller the observer is watching.
+ * @param i The observer's slot.
+ */
+static void controller_observer_disconnect(controller_t *controller, unsigned int i) {
+    if (controller->observers[i] >= 0) {
+        close(controller->observers[i]);
+        controller->observers[i] = -1;
+    }
+}
+
 /*
  * pthread cleanup handler for the controller.
  * @param arg A controller to disconnect and clean up.
  */
 static void controller_cleanup(void *arg) {
-    controller_client_disconnect((controller_t *)(arg));
-    controller_sock_disconnect((controller_t *)(arg));
+    controller_t *controller = (controller_t *)(arg);
+
+    controller_client_disconnect(controller);
+    controller_sock_disconnect(controller);
+    for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+        controller_observer_disconnect(controller, i);
+    }
+    padstate_unsubscribe(controller->state, &controller->changes);
+    notify_close(&controller->changes);
 }
 
 /*
- * Receive bytes from the controller client.
+ * Receive as many bytes as are available from the controller client, without blocking, into the end of its receive
+ * buffer.
  * @param controller The controller to receive from.
- * @param buf The buffer to receive into. Must be at least `n` bytes long.
- * @param n The number of bytes to receive. Must be less than or equal to the length of `buf`.
  * @return The number of bytes read. 0 indicates no more bytes, -1 indicates an error and `errno` will be set.
  */
-static ssize_t controller_recv(controller_t *controller, void *buf, size_t n) {
-    return recv(controller->client, buf, n, 0);
+static ssize_t controller_recv(controller_t *controller) {
+    ssize_t bread = recv(controller->client, controller->rbuf + controller->rlen,
+                         sizeof(controller->rbuf) - controller->rlen, MSG_DONTWAIT);
+    if (bread > 0) {
+        controller->rlen += bread;
+    }
+    return bread;
 }
 
 /*
@@ -262,175 +292,564 @@ static ssize_t controller_send(controller_t *controller, void *buf, size_t n) {
     return send(controller->client, buf, n, 0);
 }
 
-/* The controller logic thread
+/*
+ * Send a message to every observer. Observers must never hold up the controller, so an observer which cannot take the
+ * whole message right away is disconnected.
+ * @param controller The controller whose observers to send to.
+ * @param buf The buffer with the payload, made of packet headers each followed by their body.
+ * @param n The size of buf
+ */
+static void controller_broadcast(controller_t *controller, const void *buf, size_t n) {
+    for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+        if (controller->observers[i] < 0) continue;
+
+        if (send(controller->observers[i], buf, n, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)n) {
+            hwarn("Observer %u could not keep up, disconnecting.\n", i);
+            controller_observer_disconnect(controller, i);
+        }
+    }
+}
+
+/*
+ * Send an acknowledgement to the controller client, and a copy of it to every observer. Acknowledgements carry a header
+ * so that a client with several requests in flight can tell them apart.
+ * @param controller The controller to send to.
+ * @param subtype The control message sub-type of the acknowledgement.
+ * @param ack The acknowledgement body.
+ * @param n The size of the acknowledgement body.
+ */
+static void controller_ack(controller_t *controller, cntrl_subtype_e subtype, const void *ack, size_t n) {
+    uint8_t buf[sizeof(header_p) + sizeof(multi_act_ack_p)]; /* Fits the largest acknowledgement */
+
+    nxassert(sizeof(header_p) + n <= sizeof(buf));
+    packet_header_init((header_p *)buf, TYPE_CNTRL, subtype);
+    memcpy(buf + sizeof(header_p), ack, n);
+    controller_send(controller, buf, sizeof(header_p) + n);
+    controller_broadcast(controller, buf, sizeof(header_p) + n);
+}
+
+/*
+ * Encode a snapshot of the pad state as telemetry records: the arming level, the connection status and the state of
+ * every actuator.
+ * @param state The pad state.
+ * @param buf The buffer to encode into, which must be large enough for `NUM_ACTUATORS + 2` records.
+ * @return The number of bytes encoded.
+ */
+static size_t controller_encode_snapshot(padstate_t *state, uint8_t *buf) {
+    padstate_snapshot_t snap;
+    struct timespec time;
+    uint32_t time_ms;
+    size_t len = 0;
+
+    padstate_snapshot(state, &snap);
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    time_ms = time.tv_sec * 1000 + time.tv_nsec / 1000000;
+
+    packet_header_init((header_p *)(buf + len), TYPE_TELEM, TELEM_ARM);
+    len += sizeof(header_p);
+    packet_arm_state_init((arm_state_p *)(buf + len), time_ms, snap.arm_level);
+    len += sizeof(arm_state_p);
+
+    packet_header_init((header_p *)(buf + len), TYPE_TELEM, TELEM_CONN);
+    len += sizeof(header_p);
+    packet_conn_init((conn_status_p *)(buf + len), time_ms, snap.conn_status);
+    len += sizeof(conn_status_p);
+
+    for (unsigned int i = 0; i < NUM_ACTUATORS; i++) {
+        packet_header_init((header_p *)(buf + len), TYPE_TELEM, TELEM_ACT);
+        len += sizeof(header_p);
+        packet_act_state_init((act_state_p *)(buf + len), i, time_ms, (snap.act_states & ACT_BIT(i)) != 0);
+        len += sizeof(act_state_p);
+    }
+
+    return len;
+}
+
+/* Space for an encoded pad state snapshot */
+#define SNAPSHOT_MAX ((sizeof(header_p) + sizeof(act_state_p)) * (NUM_ACTUATORS + 2))
+
+/*
+ * Accept a new observer connection and send it the current pad state.
+ * @param controller The controller to observe.
+ */
+static void controller_accept_observer(controller_t *controller) {
+    uint8_t buf[SNAPSHOT_MAX];
+    size_t len;
+    int observer;
+
+    observer = accept(controller->observer_sock, NULL, NULL);
+    if (observer < 0) {
+        herr("accept failed: %d\n", errno);
+        return;
+    }
+
+    for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+        if (controller->observers[i] < 0) {
+            controller->observers[i] = observer;
+            hinfo("Observer %u connected.\n", i);
+
+            len = controller_encode_snapshot(controller->state, buf);
+            if (send(observer, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)len) {
+                controller_observer_disconnect(controller, i);
+            }
+            return;
+        }
+    }
+
+    hwarn("Refused observer connection, already serving %d.\n", MAX_OBSERVERS);
+    close(observer);
+}
+
+/*
+ * Handle an observer connection being readable. Observers are read-only, so anything they send is discarded; this only
+ * detects them disconnecting.
+ * @param controller The controller being observed.
+ * @param i The observer's slot.
+ */
+static void controller_observer_readable(controller_t *controller, unsigned int i) {
+    uint8_t discard[64];
+    ssize_t bread;
+
+    bread = recv(controller->observers[i], discard, sizeof(discard), MSG_DONTWAIT);
+    if (bread > 0) {
+        hwarn("Discarded %zd bytes sent by read-only observer %u.\n", bread, i);
+    } else if (bread == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        hinfo("Observer %u disconnected.\n", i);
+        controller_observer_disconnect(controller, i);
+    }
+}
+
+/*
+ * Report the outcome of every actuation carried out or dropped since the last report to the controller client and to
+ * every observer. Each outcome carries the arming level as it is now, so that the client, which learns the level from
+ * these reports, never goes back to a level the pad already left.
+ * @param controller The controller to report to.
+ */
+static void controller_report_done(controller_t *controller) {
+    uint8_t buf[sizeof(header_p) + sizeof(act_done_p)];
+    act_done_p report;
+    padstate_done_t done;
+    act_done_status_e status;
+    arm_lvl_e level = padstate_get_level(controller->state);
+
+    while (padstate_read_done(controller->state, &controller->done_next, &done) == 0) {
+        if (done.err == 0) {
+            status = ACT_DONE_OK;
+        } else if (done.err == ECANCELED) {
+            status = ACT_DONE_CANCELLED;
+        } else {
+            status = ACT_DONE_FAILED;
+        }
+
+        packet_act_done_init(&report, done.id, done.completed.tv_sec * 1000 + done.completed.tv_nsec / 1000000,
+                             done.state, status, level);
+        packet_header_init((header_p *)buf, TYPE_CNTRL, CNTRL_ACT_DONE);
+        memcpy(buf + sizeof(header_p), &report, sizeof(report));
+        if (controller->client >= 0) {
+            controller_send(controller, buf, sizeof(buf));
+        }
+        controller_broadcast(controller, buf, sizeof(buf));
+    }
+}
+
+/*
+ * Report actuation outcomes, and send the pad state to every observer when it changes.
+ * @param controller The controller being observed.
+ */
+static void controller_state_changed(controller_t *controller) {
+    uint8_t buf[SNAPSHOT_MAX];
+    uint32_t changes;
+
+    /* Consume the notification even when nobody is observing, so that it stops being readable */
+
+    changes = notify_wait(&controller->changes, 0);
+    if (changes & PADSTATE_CHANGED_DONE) {
+        controller_report_done(controller);
+    }
+
+    if ((changes & ~(PADSTATE_CHANGED_SEQ | PADSTATE_CHANGED_DONE)) == 0) return;
+    controller_broadcast(controller, buf, controller_encode_snapshot(controller->state, buf));
+}
+
+/*
+ * Get the length of the body of a message the controller client may send.
+ * @param hdr The message header.
+ * @return The length of the body in bytes, or -1 if the message is unknown.
+ */
+static ssize_t controller_body_len(const header_p *hdr) {
+    if (hdr->type != TYPE_CNTRL) return -1;
+    return packet_cntrl_body_len(hdr->subtype);
+}
+
+/*
+ * Handle a single command from the controller client.
+ * @param controller The controller the command was received on.
+ * @param hdr The command's header.
+ * @param body The command's body, whose length matches the header.
+ */
+static void controller_handle_command(controller_t *controller, const header_p *hdr, const void *body) {
+    padstate_t *state = controller->state;
+    int err;
+
+    switch ((packet_type_e)hdr->type) {
+
+    case TYPE_CNTRL:
+
+        switch ((cntrl_subtype_e)hdr->subtype) {
+
+        case CNTRL_ACT_ACK:
+            /* Deliberate fall-through */
+        case CNTRL_ARM_ACK:
+            /* Deliberate fall-through */
+        case CNTRL_MULTI_ACT_ACK:
+            /* Deliberate fall-through */
+        case CNTRL_SEQ_ACK:
+            herr("Unexpectedly received acknowledgement from sender.\n");
+            break;
+
+        case CNTRL_ACT_REQ: {
+            act_req_p req;
+            memcpy(&req, body, sizeof(req));
+
+            hinfo("Received actuator request #%u for ID #%u and state %s.\n", req.seq, req.id,
+                  req.state ? "on" : "off");
+
+            err = pad_actuate(state, req.id, req.state, NULL);
+            if (err == -1) {
+                herr("Could not modify the actuator with error: %s\n", strerror(errno));
+                break;
+            } else {
+                switch (err) {
+                case ACT_OK:
+                    hinfo("Actuator with id %d was queued for state %d\n", req.id, req.state);
+                    break;
+
+                case ACT_DNE:
+                    hwarn("%d is not a valid actuator id\n", req.id);
+                    break;
+
+                case ACT_INV:
+                    hwarn("%d is not a valid state for actuator with id %d\n", req.state, req.id);
+                    break;
+
+                case ACT_DENIED:
+                    hwarn("The current arming level is too low to operate actuator with id %d\n", req.id);
+                    break;
+
+                case ACT_BUSY:
+                    hwarn("Too many actuations are queued to operate actuator with id %d\n", req.id);
+                    break;
+                }
+
+                act_ack_p ack;
+                packet_act_ack_init(&ack, req.seq, req.id, err);
+                controller_ack(controller, CNTRL_ACT_ACK, &ack, sizeof(ack));
+            }
+
+        } break;
+
+        case CNTRL_MULTI_ACT_REQ: {
+            multi_act_req_p req;
+            multi_act_ack_p ack;
+            uint8_t bad = 0;
+            memcpy(&req, body, sizeof(req));
+
+            hinfo("Received request #%u to actuate %u actuators.\n", req.seq, req.count);
+
+            if (req.count == 0 || req.count > MULTI_ACT_MAX) {
+                hwarn("%u is not a valid number of actuations\n", req.count);
+                packet_multi_act_ack_init(&ack, req.seq, ACT_INV, 0);
+                controller_ack(controller, CNTRL_MULTI_ACT_ACK, &ack, sizeof(ack));
+                break;
+            }
+
+            err = pad_actuate_multi(state, req.acts, req.count, &bad, false);
+            if (err == -1) {
+                herr("Could not modify actuator with id %u with error: %s\n", req.acts[bad].id, strerror(errno));
+                break;
+            }
+
+            switch (err) {
+            case ACT_OK:
+                hinfo("%u actuators were queued for their requested states\n", req.count);
+                break;
+
+            case ACT_DNE:
+                hwarn("%d is not a valid actuator id\n", req.acts[bad].id);
+                break;
+
+            case ACT_INV:
+                hwarn("%d is not a valid state for actuator with id %d\n", req.acts[bad].state, req.acts[bad].id);
+                break;
+
+            case ACT_DENIED:
+                hwarn("The current arming level is too low to operate actuator with id %d\n", req.acts[bad].id);
+                break;
+
+            case ACT_BUSY:
+                hwarn("Too many actuations are queued to operate actuator with id %d\n", req.acts[bad].id);
+                break;
+            }
+
+            packet_multi_act_ack_init(&ack, req.seq, err, bad);
+            controller_ack(controller, CNTRL_MULTI_ACT_ACK, &ack, sizeof(ack));
+        } break;
+
+        case CNTRL_SEQ_UPLOAD_REQ: {
+            seq_upload_p req;
+            seq_ack_p ack;
+            memcpy(&req, body, sizeof(req));
+
+            hinfo("Received request #%u to upload %u sequence steps from step %u.\n", req.seq, req.count, req.first);
+
+            packet_seq_ack_init(&ack, req.seq, sequence_upload(controller->sequence, req.first, req.steps, req.count));
+            controller_ack(controller, CNTRL_SEQ_ACK, &ack, sizeof(ack));
+        } break;
+
+        case CNTRL_SEQ_RUN_REQ: {
+            seq_run_req_p req;
+            seq_ack_p ack;
+            memcpy(&req, body, sizeof(req));
+
+            hinfo("Received request #%u to %s the sequence.\n", req.seq, req.run ? "start" : "abort");
+
+            if (req.run) {
+                packet_seq_ack_init(&ack, req.seq, sequence_start(controller->sequence));
+            } else {
+                packet_seq_ack_init(&ack, req.seq, sequence_abort(controller->sequence));
+            }
+            controller_ack(controller, CNTRL_SEQ_ACK, &ack, sizeof(ack));
+        } break;
+
+        case CNTRL_ARM_REQ: {
+            arm_req_p req;
+            memcpy(&req, body, sizeof(req));
+
+            hinfo("Received arming request #%u for state %u.\n", req.seq, req.level);
+
+            err = padstate_change_level(state, req.level);
+            arm_ack_p ack = {.seq = req.seq};
+
+            switch (err) {
+            case ARM_OK:
+                hinfo("Arming level changed succesfully to %d\n", req.level);
+                ack.status = ARM_OK;
+                controller_ack(controller, CNTRL_ARM_ACK, &ack, sizeof(ack));
+                break;
+            case ARM_DENIED:
+                hwarn("Could not change arming level with error: %d, arming denied\n", err);
+                ack.status = ARM_DENIED;
+                controller_ack(controller, CNTRL_ARM_ACK, &ack, sizeof(ack));
+                break;
+            case ARM_INV:
+                hwarn("Could not change arming level with error: %d, arming invalid\n", err);
+                ack.status = ARM_INV;
+                controller_ack(controller, CNTRL_ARM_ACK, &ack, sizeof(ack));
+                break;
+            }
+
+        } break;
+
+        default:
+            herr("Invalid control message type: %u\n", hdr->subtype);
+            break;
+        }
+        break;
+
+    case TYPE_TELEM:
+        herr("Unexpectedly received telemetry packet.\n");
+        break;
+
+    default:
+        herr("Invalid message type: %u\n", hdr->type);
+        break;
+    }
+}
+
+/*
+ * Receive everything the controller client has sent and handle every complete command in it, in order. A command cut
+ * short by the end of the received bytes is kept for the next read.
+ * @param controller The controller whose client is readable.
+ * @return 0 on success, or the error that caused the connection to be lost.
+ */
+static int controller_client_readable(controller_t *controller) {
+    const header_p *hdr;
+    ssize_t bread;
+    ssize_t body_len;
+    size_t off = 0;
+
+    bread = controller_recv(controller);
+    if (bread == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+
+        hinfo("Error reading from controller: %s\n", strerror(errno));
+        fprintf(stderr, "Error code: %s\n", strerror(errno));
+
+        if (errno == ECONNRESET || errno == ENOTCONN || errno == ECONNABORTED) {
+            // TODO: this should trigger an abort because it happens when TCP keep-alive is done
+            herr("Lost connection with controller!\n");
+        }
+        return errno;
+    } else if (bread == 0) {
+        herr("Control box disconnected.\n");
+        return ENOTCONN;
+    }
+
+    /* Handle every complete command */
+
+    while (controller->rlen - off >= sizeof(header_p)) {
+        hdr = (const header_p *)(controller->rbuf + off);
+
+        /* Without knowing the length of a message there is no way to find where the next one starts */
+
+        body_len = controller_body_len(hdr);
+        if (body_len < 0) {
+            herr("Invalid message type %u, sub-type %u, stream lost.\n", hdr->type, hdr->subtype);
+            return EPROTO;
+        }
+
+        if (controller->rlen - off < sizeof(header_p) + body_len) break; /* Rest arrives later */
+
+        controller_handle_command(controller, hdr, controller->rbuf + off + sizeof(header_p));
+        off += sizeof(header_p) + body_len;
+    }
+
+    /* Keep the partial command at the start of the buffer */
+
+    controller->rlen -= off;
+    memmove(controller->rbuf, controller->rbuf + off, controller->rlen);
+    return 0;
+}
+
+/* Indices of the descriptors the controller event loop polls */
+enum {
+    POLL_LISTEN = 0,          /* Controller client connections */
+    POLL_OBSERVER_LISTEN = 1, /* Observer connections */
+    POLL_CHANGES = 2,         /* Pad state changes */
+    POLL_CLIENT = 3,          /* The controller client */
+    POLL_OBSERVERS = 4,       /* The first observer */
+    POLL_COUNT = 4 + MAX_OBSERVERS,
+};
+
+/* The controller logic thread. A single event loop serves the controller client, which may command the pad, and the
+ * observers, which are sent every acknowledgement and pad state change. Commands are handled one at a time in the
+ * order they are received.
  * @param arg Argument containing `controller_args_t`
  */
 void *controller_run(void *arg) {
     controller_args_t *args = (controller_args_t *)(arg);
     controller_t controller;
+    struct pollfd fds[POLL_COUNT];
+    struct timespec abort_deadline;
+    bool was_connected = false; /* Already had a connection before */
+    int timeout_ms;
     int err;
-    controller.sock = -1;
-    controller.client = -1;
 
     assert(arg != NULL);
 
+    controller.sock = -1;
+    controller.observer_sock = -1;
+    controller.client = -1;
+    controller.rlen = 0;
+    controller.done_next = 0;
+    controller.state = args->state;
+    controller.sequence = args->sequence;
+    for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+        controller.observers[i] = -1;
+    }
+
     pthread_cleanup_push(controller_cleanup, &controller);
 
-    /* Initialize the controller (creates a new socket) */
+    /* Initialize the controller (creates the listening sockets) */
 
-    err = controller_init(&controller, args->port);
+    err = controller_init(&controller, args);
     if (err) {
         herr("Could not initialize controller with error: %s\n", strerror(err));
         nxfail("Could not initialize controller");
         exit(EXIT_FAILURE);
     }
 
-    for (;;) {
+    printf("Waiting for controller...\n");
 
-        /* Initialize the controller (creates a new socket) */
+    for (;;) {
 
-        printf("Waiting for controller...\n");
+        /* Poll every open connection. Negative descriptors are ignored by `poll()`. */
 
-        err = controller_accept(&controller);
-        if (err) {
-            herr("Could not accept controller connection with error: %s\n", strerror(err));
-            controller_client_disconnect(&controller);
-            continue;
+        fds[POLL_LISTEN] = (struct pollfd){.fd = controller.sock, .events = POLLIN};
+        fds[POLL_OBSERVER_LISTEN] = (struct pollfd){.fd = controller.observer_sock, .events = POLLIN};
+        fds[POLL_CHANGES] = (struct pollfd){.fd = controller.changes.rfd, .events = POLLIN};
+        fds[POLL_CLIENT] = (struct pollfd){.fd = controller.client, .events = POLLIN};
+        for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+            fds[POLL_OBSERVERS + i] = (struct pollfd){.fd = controller.observers[i], .events = POLLIN};
         }
 
-        padstate_set_connstatus(args->state, CONN_CONNECTED);
-        printf("Controller connected!\n");
+        /* If the controller client has connected before and is gone, abort if it does not re-connect in time */
 
-        /* Receive messages */
+        timeout_ms = -1;
+        if (was_connected && controller.client < 0) {
+            timeout_ms = deadline_remaining_us(&abort_deadline) / 1000;
+            if (timeout_ms <= 0) {
+                herr("Timed out waiting for new connection, ABORT!\n");
+                nxfail("Timed out waiting for new connection, ABORT!\n");
 
-        for (;;) {
+                /* Just keep waiting on desktop build */
 
-            /* Get the message header to determine what to handle */
-
-            header_p hdr;
-            ssize_t bread = 0;
-            size_t total_read = 0;
+                clock_gettime(CLOCK_MONOTONIC, &abort_deadline);
+                deadline_add_us(&abort_deadline, (uint64_t)ABORT_TIMEOUT * 1000000);
+                continue;
+            }
+        }
 
-            while (total_read < sizeof(hdr)) {
-                bread = controller_recv(&controller, (char *)&hdr + total_read, sizeof(hdr) - total_read);
-                if (bread == -1) {
-                    hinfo("Error reading message header: %s\n", strerror(errno));
-                    fprintf(stderr, "Error code: %s\n", strerror(errno));
+        err = poll(fds, POLL_COUNT, timeout_ms);
+        if (err < 0) {
+            if (errno != EINTR) herr("poll failed: %d\n", errno);
+            continue;
+        }
 
-                    if (errno == ECONNRESET || errno == ENOTCONN || errno == ECONNABORTED) {
-                        // TODO: this should trigger an abort because it happens when TCP keep-alive is done
-                        herr("Lost connection with controller!\n");
-                    }
+        /* Commands first, so that the state observers are sent reflects them */
 
-                    break; /* Exit read loop */
-                } else if (bread == 0) {
-                    herr("Control box disconnected.\n");
-                    break;
-                }
-                total_read += bread;
-            }
+        if (fds[POLL_CLIENT].revents) {
+            err = controller_client_readable(&controller);
 
-            /* Error happened, do a cleanup and re-initialize connection */
+            /* Error happened, do a cleanup and wait for the connection to be re-established */
 
-            if (bread <= 0) {
+            if (err) {
                 hinfo("Re-initializing connection.\n");
                 controller_client_disconnect(&controller);
                 padstate_set_connstatus(args->state, CONN_RECONNECTING);
-                break; /* Exit main receive loop */
-            }
-
-            switch ((packet_type_e)hdr.type) {
 
-            case TYPE_CNTRL:
-
-                switch ((cntrl_subtype_e)hdr.subtype) {
-
-                case CNTRL_ACT_ACK:
-                    /* Deliberate fall-through */
-                case CNTRL_ARM_ACK:
-                    herr("Unexpectedly received acknowledgement from sender.\n");
-                    break;
+                hwarn("Setting timeout of %d seconds for re-connect.\n", ABORT_TIMEOUT);
+                clock_gettime(CLOCK_MONOTONIC, &abort_deadline);
+                deadline_add_us(&abort_deadline, (uint64_t)ABORT_TIMEOUT * 1000000);
+                printf("Waiting for controller...\n");
+            }
+        }
 
-                case CNTRL_ACT_REQ: {
-                    act_req_p req;
-
-                    controller_recv(&controller, &req, sizeof(req)); // TODO: handle recv errors
-
-                    hinfo("Received actuator request for ID #%u and state %s.\n", req.id, req.state ? "on" : "off");
-
-                    err = pad_actuate(args->state, req.id, req.state);
-                    if (err == -1) {
-                        herr("Could not modify the actuator with error: %s\n", strerror(errno));
-                        break;
-                    } else {
-                        switch (err) {
-                        case ACT_OK:
-                            hinfo("Actuator with id %d was put in state %d\n", req.id, req.state);
-                            break;
-
-                        case ACT_DNE:
-                            hwarn("%d is not a valid actuator id\n", req.id);
-                            break;
-
-                        case ACT_INV:
-                            hwarn("%d is not a valid state for actuator with id %d\n", req.state, req.id);
-                            break;
-
-                        case ACT_DENIED:
-                            hwarn("The current arming level is too low to operate actuator with id %d\n", req.id);
-                            break;
-                        }
-
-                        act_ack_p ack = {.id = req.id, .status = err};
-                        controller_send(&controller, &ack, sizeof(ack));
-                    }
-
-                } break;
-
-                case CNTRL_ARM_REQ: {
-                    arm_req_p req;
-                    controller_recv(&controller, &req, sizeof(req)); // TODO: handle recv errors
-
-                    hinfo("Received arming state %u.\n", req.level);
-
-                    err = padstate_change_level(args->state, req.level);
-                    arm_ack_p ack;
-
-                    switch (err) {
-                    case ARM_OK:
-                        hinfo("Arming level changed succesfully to %d\n", req.level);
-                        ack.status = ARM_OK;
-                        controller_send(&controller, &ack, sizeof(ack));
-                        break;
-                    case ARM_DENIED:
-                        hwarn("Could not change arming level with error: %d, arming denied\n", err);
-                        ack.status = ARM_DENIED;
-                        controller_send(&controller, &ack, sizeof(ack));
-                        break;
-                    case ARM_INV:
-                        hwarn("Could not change arming level with error: %d, arming invalid\n", err);
-                        ack.status = ARM_INV;
-                        controller_send(&controller, &ack, sizeof(ack));
-                        break;
-                    }
-
-                } break;
-
-                default:
-                    herr("Invalid control message type: %u\n", hdr.subtype);
-                    break;
-                }
-                break;
+        if (fds[POLL_CHANGES].revents) {
+            controller_state_changed(&controller);
+        }
 
-            case TYPE_TELEM:
-                herr("Unexpectedly received telemetry packet.\n");
-                break;
+        for (unsigned int i = 0; i < MAX_OBSERVERS; i++) {
+            if (fds[POLL_OBSERVERS + i].revents) {
+                controller_observer_readable(&controller, i);
+            }
+        }
 
-            default:
-                herr("Invalid message type: %u\n", hdr.type);
-                break;
+        if (fds[POLL_LISTEN].revents) {
+            err = controller_accept(&controller);
+            if (err == 0) {
+                was_connected = true;
+                padstate_set_connstatus(args->state, CONN_CONNECTED);
+                printf("Controller connected!\n");
+            } else if (err != EBUSY) {
+                herr("Could not accept controller connection with error: %s\n", strerror(err));
+                controller_client_disconnect(&controller);
             }
         }
+
+        if (fds[POLL_OBSERVER_LISTEN].revents) {
+            controller_accept_observer(&controller);
+        }
     }
 
     nxfail("Reached the end of control thread");
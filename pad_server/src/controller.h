@@ -4,21 +4,44 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include "notify.h"
+#include "sequence.h"
 #include "state.h"
 
 /* The maximum number of controllers allowed to connect to the pad control system. */
 #define MAX_CONTROLLERS 1
 
-/* Represents the controller client */
+/* The maximum number of read-only observers allowed to connect to the pad control system. */
+#ifdef CONFIG_HYSIM_PAD_SERVER_MAX_OBSERVERS
+#define MAX_OBSERVERS CONFIG_HYSIM_PAD_SERVER_MAX_OBSERVERS
+#else
+#define MAX_OBSERVERS 4
+#endif
+
+/* Size of the buffer commands from the controller client are received into. Commands are only a few bytes long, so
+ * this holds a burst of many. */
+#define CONTROLLER_RECV_BUF 256
+
+/* Represents the controller client and the observers watching it */
 typedef struct {
-    int sock;                /* The pad socket accepting connections. */
-    int client;              /* The control client connection. */
-    struct sockaddr_in addr; /* The address of the controller client */
+    int sock;                          /* The pad socket accepting connections. */
+    int client;                        /* The control client connection. */
+    struct sockaddr_in addr;           /* The address of the controller client */
+    uint8_t rbuf[CONTROLLER_RECV_BUF]; /* Bytes received from the controller client but not yet handled */
+    size_t rlen;                       /* Number of bytes in `rbuf` */
+    int observer_sock;                 /* The pad socket accepting observer connections. */
+    int observers[MAX_OBSERVERS];      /* Observer connections, -1 for unused slots. */
+    notify_t changes;                  /* Pad state changes to forward to observers */
+    uint32_t done_next;                /* Number of the next actuation outcome to report, see `padstate_read_done` */
+    padstate_t *state;                 /* The pad state being controlled */
+    sequence_t *sequence;              /* The actuation sequence being controlled */
 } controller_t;
 
 typedef struct {
     padstate_t *state;
+    sequence_t *sequence; /* Actuation sequence uploaded and started by the controller */
     uint16_t port;
+    uint16_t observer_port; /* Port on which read-only observers connect */
 } controller_args_t;
 
 /* Represents the arguments passed to the controller. */
@@ -0,0 +1,56 @@
+#include <errno.h>
+
+#include "deadline.h"
+
+/*
+ * Move a deadline later in time.
+ * @param deadline The deadline to move.
+ * @param us The number of microseconds to move the deadline by.
+ */
+void deadline_add_us(struct timespec *deadline, uint64_t us) {
+    deadline->tv_sec += us / 1000000;
+    deadline->tv_nsec += (us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/*
+ * Get the time left until a deadline.
+ * @param deadline The deadline, measured on CLOCK_MONOTONIC.
+ * @return The number of microseconds until the deadline, negative if it has passed.
+ */
+int64_t deadline_remaining_us(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(deadline->tv_sec - now.tv_sec) * 1000000 + (deadline->tv_nsec - now.tv_nsec) / 1000;
+}
+
+/*
+ * Sleep until an absolute deadline. Sleeping until a deadline rather than for a duration means that time spent between
+ * sleeps does not accumulate as drift.
+ * @param deadline The deadline to wake up at, measured on CLOCK_MONOTONIC.
+ * @return 0 on success, error code on failure.
+ */
+int deadline_sleep(const struct timespec *deadline) {
+    int err;
+
+#ifndef __APPLE__
+    do {
+        err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+    } while (err == EINTR);
+#else
+    /* macOS has no absolute sleep, so sleep for the remaining time instead */
+
+    int64_t remaining = deadline_remaining_us(deadline);
+    if (remaining <= 0) return 0;
+
+    struct timespec duration = {.tv_sec = remaining / 1000000, .tv_nsec = (remaining % 1000000) * 1000};
+    do {
+        err = nanosleep(&duration, &duration) < 0 ? errno : 0;
+    } while (err == EINTR);
+#endif
+
+    return err;
+}
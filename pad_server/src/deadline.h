@@ -0,0 +1,11 @@
+#ifndef _DEADLINE_H_
+#define _DEADLINE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+void deadline_add_us(struct timespec *deadline, uint64_t us);
+int64_t deadline_remaining_us(const struct timespec *deadline);
+int deadline_sleep(const struct timespec *deadline);
+
+#endif // _DEADLINE_H_
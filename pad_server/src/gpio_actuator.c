@@ -10,68 +10,87 @@
 #include "../../debugging/logging.h"
 #include "actuator.h"
 #include "gpio_actuator.h"
+#include "state.h"
+
+/* The GPIO device of an actuator, kept open for the life of the pad server */
+typedef struct {
+    const char *dev; /* The path to the GPIO character device */
+    int fd;          /* The open device, -1 if it could not be opened */
+} gpio_actpriv_t;
+
+/* Private data of the GPIO actuators, by actuator ID */
+static gpio_actpriv_t gpio_privs[NUM_ACTUATORS];
 
 /*
- * Turn on a GPIO actuator.
- * @param act The actuator to turn on.
+ * Open the device of a GPIO actuator if it is not already open.
+ * @param priv The GPIO actuator's private data.
  * @return 0 on success, an error code on failure.
  */
-static int gpio_actuator_on(actuator_t *act) {
-    int fd = open((char *)act->priv, O_RDWR);
-    if (fd < 0) {
-        herr("Failed to open gpio '%s' with err %d\n", (char *)act->priv, errno);
-        return -1;
-    }
-
-    int err = ioctl(fd, GPIOC_WRITE, true);
-    if (err < 0) {
-        herr("Failed to communicate via ioctl with err %d\n", errno);
-        return -1;
-    }
+static int gpio_actuator_open(gpio_actpriv_t *priv) {
+    if (priv->fd >= 0) return 0;
 
-    if (close(fd) == -1) {
-        herr("Failed to close gpio with err %d\n", errno);
-        return -1;
+    priv->fd = open(priv->dev, O_RDWR | O_CLOEXEC);
+    if (priv->fd < 0) {
+        herr("Failed to open gpio '%s' with err %d\n", priv->dev, errno);
+        return errno;
     }
-
-    hinfo("Actuator #%d turned on\n", act->id);
     return 0;
 }
 
 /*
- * Turn off a GPIO actuator.
- * @param act The actuator to turn off.
- * @return 0 on success, an error code on failure.
+ * Write the output of a GPIO actuator.
+ * @param act The actuator to write.
+ * @param value The output value of the pin.
+ * @return 0 on success, -1 on failure with errno set.
  */
-static int gpio_actuator_off(actuator_t *act) {
+static int gpio_actuator_write(actuator_t *act, bool value) {
+    gpio_actpriv_t *priv = act->priv;
+    int err;
 
-    int fd = open((char *)act->priv, O_RDWR);
-    if (fd < 0) {
-        herr("Failed to open gpio '%s' with err %d\n", (char *)act->priv, errno);
-        return -1;
-    }
+    /* Only the first actuation after a failed open pays for opening the device */
 
-    int err = ioctl(fd, GPIOC_WRITE, false);
-    if (err < 0) {
-        herr("Failed to communicate via ioctl with err %d\n", errno);
+    err = gpio_actuator_open(priv);
+    if (err) {
+        errno = err;
         return -1;
     }
 
-    if (close(fd) == -1) {
-        herr("Failed to close gpio with err %d\n", errno);
+    if (ioctl(priv->fd, GPIOC_WRITE, value) < 0) {
+        err = errno;
+        herr("Failed to communicate via ioctl with err %d\n", err);
+        errno = err;
         return -1;
     }
 
-    hinfo("Actuator #%d turned off\n", act->id);
     return 0;
 }
 
 /*
- * Initialize a GPIO actuator.
+ * Turn on a GPIO actuator.
+ * @param act The actuator to turn on.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+static int gpio_actuator_on(actuator_t *act) { return gpio_actuator_write(act, true); }
+
+/*
+ * Turn off a GPIO actuator.
+ * @param act The actuator to turn off.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+static int gpio_actuator_off(actuator_t *act) { return gpio_actuator_write(act, false); }
+
+/*
+ * Initialize a GPIO actuator, opening its device so that actuations only write the pin.
  * @param act The actuator structure to initialize.
  * @param id The actuator ID
  * @param dev The path to the GPIO character device
+ * @return 0 on success, an error code if the device could not be opened (it is opened again on the next actuation)
  */
-void gpio_actuator_init(actuator_t *act, uint8_t id, const char *dev) {
-    actuator_init(act, id, gpio_actuator_on, gpio_actuator_off, (char *)dev);
+int gpio_actuator_init(actuator_t *act, uint8_t id, const char *dev) {
+    gpio_actpriv_t *priv = &gpio_privs[id];
+
+    priv->dev = dev;
+    priv->fd = -1;
+    actuator_init(act, id, gpio_actuator_on, gpio_actuator_off, priv);
+    return gpio_actuator_open(priv);
 }
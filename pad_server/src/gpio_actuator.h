@@ -1,9 +1,10 @@
 #include "actuator.h"
 
 /*
- * Initialize a GPIO actuator.
+ * Initialize a GPIO actuator, opening its device so that actuations only write the pin.
  * @param act The actuator structure to initialize.
  * @param id The actuator ID
  * @param dev The path to the GPIO character device
+ * @return 0 on success, an error code if the device could not be opened (it is opened again on the next actuation)
  */
-void gpio_actuator_init(actuator_t *act, uint8_t id, const char *dev);
+int gpio_actuator_init(actuator_t *act, uint8_t id, const char *dev);
@@ -2,12 +2,30 @@
     "pad 0.0.0\n2024 CU InSpace\n\nDESCRIPTION:\n    Emulates the pad control box"                                     \
     " server.\n\nUSAGE:\n    pad [options]\n\nOPTIONS:\n    -f file     A CSV fil"                                     \
     "e containing sensor data telemetry to transmit. If not\n                spec"                                     \
-    "ified, no sensor data telemetry will be sent.\n    -t port     The port numb"                                     \
+    "ified, no sensor data telemetry will be sent.\n"                                                                 \
+    "    -s speed    The speed multiplier at which the file is replayed, from 0.1 to\n"                             \
+    "                100, or \"max\" to replay as fast as possible. Rows are paced by\n"                             \
+    "                their recorded time stamps. If not specified, 1 is used.\n"                                       \
+    "    -S offset   The offset in milliseconds into the file to start replaying\n"                                   \
+    "                from. If not specified, replay starts from the beginning.\n"                                      \
+    "    -l start:end\n"                                                                                               \
+    "                The region of the file to replay in a loop, as offsets in\n"                                      \
+    "                milliseconds. If not specified, the whole file is looped.\n"                                      \
+    "    -r rate     The rate in Hz at which random sensor data is generated when no\n"                             \
+    "                file is given. If not specified, 10 Hz is used.\n    -t port     The port numb"                   \
     "er to use for the telemetry connection. If not\n                specified, p"                                     \
     "ort 50002 is used.\n    -a addr     The multicast address for the telemetry connection. If not\n                " \
     "specified, "                                                                                                      \
     "address "                                                                                                         \
     "224.0.0.10 is used.\n"                                                                                            \
     "    -c port     The port number to use for the controlle"                                                         \
-    "r connection. If not\n                specified, port 50001 is used.\n\nEXAM"                                     \
-    "PLES:\n    pad -t ../thecoldhasflown.csv\n"
+    "r connection. If not\n                specified, port 50001 is used.\n"                                           \
+    "    -o port     The port number on which read-only observers connect to watch\n"                                  \
+    "                the controller. If not specified, port 50003 is used.\n"                                          \
+    "    -k seconds  The interval between full pad state keyframes. Only changed\n"                                    \
+    "                actuator states are sent in between. 0 sends the full pad state\n"                                \
+    "                every time. If not specified, 30 seconds is used.\n"                                              \
+    "    -T          Send a latency trace with every sensor measurement, holding the\n"                                \
+    "                times it was acquired and sent in microseconds.\n\nEXAM"                                          \
+    "PLES:\n    pad -t ../thecoldhasflown.csv\n"                                                                   \
+    "    pad -f coldflow-fill.bin -s 100 -l 1000:5000\n"
@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__linux__) || defined(CONFIG_EVENT_FD)
+#include <sys/eventfd.h>
+#define NOTIFY_EVENTFD
+#endif
+
+#include "../../debugging/logging.h"
+#include "deadline.h"
+#include "notify.h"
+
+/*
+ * Initialize a notification, using an eventfd where available and a pipe otherwise.
+ * @param notify The notification to initialize.
+ * @return 0 on success, error code on failure.
+ */
+int notify_init(notify_t *notify) {
+    atomic_init(&notify->pending, 0);
+
+#if defined(NOTIFY_EVENTFD)
+    notify->rfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify->rfd < 0) {
+        return errno;
+    }
+    notify->wfd = notify->rfd;
+#else
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return errno;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK); /* A full pipe already has a wake-up pending */
+    notify->rfd = fds[0];
+    notify->wfd = fds[1];
+#endif
+    return 0;
+}
+
+/*
+ * Release the descriptors of a notification.
+ * @param notify The notification to close.
+ */
+void notify_close(notify_t *notify) {
+    close(notify->rfd);
+    if (notify->wfd != notify->rfd) {
+        close(notify->wfd);
+    }
+}
+
+/*
+ * Post changes to the consumer. Only the post which finds no changes pending wakes the consumer, so a burst of posts
+ * costs one wake-up. Never blocks.
+ * @param notify The notification to post to.
+ * @param mask The changes to post. Posting no changes does nothing.
+ */
+void notify_post(notify_t *notify, uint32_t mask) {
+    if (mask == 0 || atomic_fetch_or(&notify->pending, mask) != 0) {
+        return;
+    }
+
+#if defined(NOTIFY_EVENTFD)
+    uint64_t one = 1;
+#else
+    uint8_t one = 1;
+#endif
+    if (write(notify->wfd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        herr("Could not post notification: %d\n", errno);
+    }
+}
+
+/*
+ * Wait for changes to be posted.
+ * @param notify The notification to wait on.
+ * @param timeout_ms The longest time to wait in milliseconds. 0 only collects what is already posted, which is how an
+ * event loop polling `rfd` consumes the notification.
+ * @return The changes posted since the last wait, or 0 if none were posted before the time-out.
+ */
+uint32_t notify_wait(notify_t *notify, uint32_t timeout_ms) {
+    struct pollfd pfd = {.fd = notify->rfd, .events = POLLIN};
+    struct timespec deadline;
+    uint8_t drain[64];
+    uint32_t mask;
+    int64_t remaining_us;
+    int ready;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline_add_us(&deadline, (uint64_t)timeout_ms * 1000);
+
+    for (;;) {
+        mask = atomic_exchange(&notify->pending, 0);
+        if (mask != 0) {
+            return mask;
+        }
+
+        remaining_us = deadline_remaining_us(&deadline);
+        if (remaining_us < 0) {
+            remaining_us = 0;
+        }
+
+        ready = poll(&pfd, 1, (remaining_us + 999) / 1000);
+        if (ready < 0 && errno != EINTR) {
+            herr("Could not wait for notification: %d\n", errno);
+            return 0;
+        } else if (ready == 0) {
+            return atomic_exchange(&notify->pending, 0); /* Timed out */
+        }
+
+        /* Consume the wake-up before the pending changes, so that changes posted after the exchange above always
+         * leave a wake-up behind. A wake-up whose changes were already taken just loops around. */
+
+        while (read(notify->rfd, drain, sizeof(drain)) > 0)
+            ;
+    }
+}
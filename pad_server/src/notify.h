@@ -0,0 +1,20 @@
+#ifndef _NOTIFY_H_
+#define _NOTIFY_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Notification of changes to a single consumer. Changes are posted as a bitmask; any number of posts made before the
+ * consumer wakes are merged into one mask and one wake-up. */
+typedef struct {
+    _Atomic uint32_t pending; /* Change mask posted but not yet consumed */
+    int rfd;                  /* Descriptor the consumer waits on */
+    int wfd;                  /* Descriptor posted to, the same as `rfd` for an eventfd */
+} notify_t;
+
+int notify_init(notify_t *notify);
+void notify_close(notify_t *notify);
+void notify_post(notify_t *notify, uint32_t mask);
+uint32_t notify_wait(notify_t *notify, uint32_t timeout_ms);
+
+#endif // _NOTIFY_H_
@@ -13,9 +13,11 @@
 
 #include "../../debugging/logging.h"
 #include "../../debugging/nxassert.h"
+#include "actqueue.h"
 #include "actuator.h"
 #include "controller.h"
 #include "helptext/helptext.h"
+#include "sequence.h"
 #include "state.h"
 #include "telemetry.h"
 
@@ -28,22 +30,59 @@
 #include "netutils/netinit.h"
 #endif
 
+#define ACTUATOR_THREAD_PRIORITY 220
+#define SEQUENCE_THREAD_PRIORITY 210
 #define CONTROL_THREAD_PRIORITY 200
 #define TELEM_THREAD_PRIORITY 100
+#define LOG_THREAD_PRIORITY 50
 
 #define TELEMETRY_PORT 50002
 #define CONTROL_PORT 50001
+#define OBSERVER_PORT 50003
 #define MULTICAST_ADDR "239.100.110.210"
 
 padstate_t state;
 
+#ifdef HLOG_ASYNC
+pthread_t log_thread;
+#endif
+
+sequence_t sequence;
+pthread_t sequence_thread;
+
+pthread_t bus_threads[NUM_ACT_BUSES];
+
 pthread_t controller_thread;
-controller_args_t controller_args = {.port = CONTROL_PORT, .state = &state};
+controller_args_t controller_args = {
+    .port = CONTROL_PORT, .observer_port = OBSERVER_PORT, .state = &state, .sequence = &sequence};
 
 pthread_t telem_thread;
-telemetry_args_t telemetry_args = {.port = TELEMETRY_PORT, .state = &state, .data_file = NULL, .addr = MULTICAST_ADDR};
+telemetry_args_t telemetry_args = {.port = TELEMETRY_PORT,
+                                   .state = &state,
+                                   .sequence = &sequence,
+                                   .data_file = NULL,
+                                   .addr = MULTICAST_ADDR,
+                                   .mock_rate = TELEMETRY_MOCK_RATE_HZ,
+                                   .replay_opts = {.speed = 1.0},
+                                   .keyframe_sec = PADSTATE_KEYFRAME_SEC,
+                                   .trace = false};
 
 #ifdef DESKTOP_BUILD
+/*
+ * Print the actuation latency of every actuator which was actuated, for benchmarking.
+ */
+static void print_actuator_timings(void) {
+    act_timing_t timing;
+
+    for (unsigned int i = 0; i < NUM_ACTUATORS; i++) {
+        actuator_get_timing(&state.actuators[i], &timing);
+        if (timing.count == 0) continue;
+        printf("%s: %lu actuations, last %lu ns, mean %lu ns, max %lu ns\n", actuator_get_name(&state.actuators[i]),
+               (unsigned long)timing.count, (unsigned long)timing.last_ns,
+               (unsigned long)(timing.total_ns / timing.count), (unsigned long)timing.max_ns);
+    }
+}
+
 void int_handler(int sig) {
 
     (void)(sig);
@@ -68,6 +107,7 @@ void int_handler(int sig) {
 
     printf("Controller thread terminated.\n");
 
+    print_actuator_timings();
     exit(EXIT_SUCCESS);
 }
 #endif
@@ -157,6 +197,27 @@ int main(int argc, char **argv) {
     boardctl(BOARDIOC_INIT, 0);
 #endif
 
+#ifdef HLOG_ASYNC
+    /* Start the logging thread first, and write out whatever was logged when the server exits */
+
+    err = pthread_create(&log_thread, NULL, hlog_run, NULL);
+    if (err) {
+        fprintf(stderr, "Could not start logging thread: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    atexit(hlog_flush);
+
+#ifndef DESKTOP_BUILD
+    /* Logging is the least urgent work on the pad */
+
+    err = pthread_setschedprio(log_thread, LOG_THREAD_PRIORITY);
+    if (err) {
+        fprintf(stderr, "Could not set logging thread priority: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+#endif
+#endif
+
 #if !defined(DESKTOP_BUILD) && !defined(CONFIG_SYSTEM_NSH) && defined(CONFIG_CDCACM_CONSOLE)
     if (usb_init()) {
         return EXIT_FAILURE;
@@ -172,7 +233,7 @@ int main(int argc, char **argv) {
 
     /* Parse command line options. */
 
-    while ((c = getopt(argc, argv, ":ht:c:f:a:")) != -1) {
+    while ((c = getopt(argc, argv, ":ht:c:o:f:a:r:s:S:l:k:T")) != -1) {
         switch (c) {
         case 'h':
             puts(HELP_TEXT);
@@ -184,6 +245,9 @@ int main(int argc, char **argv) {
         case 'c':
             controller_args.port = strtoul(optarg, NULL, 10);
             break;
+        case 'o':
+            controller_args.observer_port = strtoul(optarg, NULL, 10);
+            break;
         case 'f':
             telemetry_args.data_file = optarg;
             break;
@@ -195,6 +259,42 @@ int main(int argc, char **argv) {
                 exit(EXIT_FAILURE);
             }
             break;
+        case 'r':
+            telemetry_args.mock_rate = strtoul(optarg, NULL, 10);
+            if (telemetry_args.mock_rate == 0 || telemetry_args.mock_rate > 1000000) {
+                fprintf(stderr, "Invalid mock data rate %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            if (strcmp(optarg, "max") == 0) {
+                telemetry_args.replay_opts.speed = 0; /* As fast as possible */
+                break;
+            }
+            telemetry_args.replay_opts.speed = strtod(optarg, NULL);
+            if (telemetry_args.replay_opts.speed < REPLAY_SPEED_MIN ||
+                telemetry_args.replay_opts.speed > REPLAY_SPEED_MAX) {
+                fprintf(stderr, "Invalid replay speed %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S':
+            telemetry_args.replay_opts.seek_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            if (sscanf(optarg, "%u:%u", &telemetry_args.replay_opts.loop_start_ms,
+                       &telemetry_args.replay_opts.loop_end_ms) != 2 ||
+                telemetry_args.replay_opts.loop_start_ms >= telemetry_args.replay_opts.loop_end_ms) {
+                fprintf(stderr, "Invalid replay loop region %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'k':
+            telemetry_args.keyframe_sec = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            telemetry_args.trace = true;
+            break;
         case '?':
             fprintf(stderr, "Unknown option -%c\n", optopt);
             exit(EXIT_FAILURE);
@@ -208,11 +308,71 @@ int main(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
+    if (controller_args.observer_port == controller_args.port) {
+        fprintf(stderr, "Cannot use the same port number (%u) for both control and observer connections.\n",
+                controller_args.port);
+        exit(EXIT_FAILURE);
+    }
+
     /* Set up the state to be shared */
 
-    padstate_init(&state);
+    err = padstate_init(&state);
+    if (err) {
+        herr("Could not initialize the pad state: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
     hinfo("Initialized the padstate\n");
 
+    /* Start the actuator bus workers, which carry out the actuations queued by the controller and the sequence */
+
+    for (unsigned int i = 0; i < NUM_ACT_BUSES; i++) {
+        err = pthread_create(&bus_threads[i], NULL, actqueue_run, &state.buses[i]);
+        if (err) {
+            herr("Could not start %s actuator bus thread: %s\n", state.buses[i].name, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+
+#ifndef DESKTOP_BUILD
+        /* Give the bus workers the highest priority, so that queued actuations are carried out right away */
+
+        err = pthread_setschedprio(bus_threads[i], ACTUATOR_THREAD_PRIORITY);
+        if (err) {
+            herr("Could not set %s actuator bus thread priority: %s\n", state.buses[i].name, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+#endif
+    }
+
+    hinfo("Actuator bus threads started.\n");
+
+    err = sequence_init(&sequence, &state);
+    if (err) {
+        herr("Could not initialize the actuation sequence: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Start actuation sequence thread */
+
+    err = pthread_create(&sequence_thread, NULL, sequence_run, &sequence);
+    if (err) {
+        herr("Could not start sequence thread: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    hinfo("Sequence thread started.\n");
+
+#ifndef DESKTOP_BUILD
+    /* Give the sequence thread priority over the controller, so that steps are carried out on time */
+
+    err = pthread_setschedprio(sequence_thread, SEQUENCE_THREAD_PRIORITY);
+    if (err) {
+        herr("Could not set sequence thread priority: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    hinfo("Sequence thread priority set to %u.\n", SEQUENCE_THREAD_PRIORITY);
+#endif
+
     /* Start controller thread */
 
     err = pthread_create(&controller_thread, NULL, controller_run, &controller_args);
@@ -9,6 +9,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -17,6 +18,7 @@
 #include "../../debugging/logging.h"
 #include "actuator.h"
 #include "pwm_actuator.h"
+#include "state.h"
 
 /* Period of 4ms */
 #define DEFAULT_PERIOD 0.004                   /* Seconds */
@@ -24,95 +26,193 @@
 #define DEFAULT_FREQUENCY (1 / DEFAULT_PERIOD) /* Hz */
 
 /*
- * Sends a PWM signal to the device based on the open or close pulse duration.
- * @param act The PWM actuator to send the signal to
- * @param open True to send an open pulse, false to send a close pulse
- * @return 0 on success, error code on failure
+ * A PWM device, kept open for the life of the pad server. The configuration of all its channels is cached, so that an
+ * actuation only changes the duty cycle of its channel and writes the configuration back. Every PWM actuator is on the
+ * PWM bus, whose single worker carries out one actuation at a time once set up is done, so the cache needs no lock of
+ * its own.
  */
-static int pwm_send_signal(actuator_t *act, bool open_act) {
-    int fd;
+typedef struct {
+    const char *dev;          /* The PWM character device path, NULL for unused devices */
+    int fd;                   /* The open device, -1 if it could not be set up */
+    bool started;             /* Whether the PWM output was started; later configurations take effect immediately */
+    struct pwm_info_s config; /* The last configuration written to the device */
+} pwm_device_t;
+
+/* Private data of a PWM actuator */
+typedef struct {
+    const pwm_actinfo_t *info; /* The actuator's settings */
+    pwm_device_t *device;      /* The device the actuator is connected to */
+} pwm_actpriv_t;
+
+/* PWM devices in use, shared by the actuators on their channels */
+static pwm_device_t pwm_devices[PWM_MAX_DEVICES];
+
+/* Private data of the PWM actuators, by actuator ID */
+static pwm_actpriv_t pwm_privs[NUM_ACTUATORS];
+
+/*
+ * Find the PWM device at a path, claiming an unused one if it has not been seen before.
+ * @param dev The PWM character device path.
+ * @return The device, or NULL if all devices are in use.
+ */
+static pwm_device_t *pwm_device_get(const char *dev) {
+    for (unsigned int i = 0; i < PWM_MAX_DEVICES; i++) {
+        if (pwm_devices[i].dev == NULL) {
+            pwm_devices[i].dev = dev;
+            pwm_devices[i].fd = -1;
+            pwm_devices[i].started = false;
+            return &pwm_devices[i];
+        }
+        if (strcmp(pwm_devices[i].dev, dev) == 0) {
+            return &pwm_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Configure the channel of a PWM actuator in the cached configuration of its device.
+ * @param priv The PWM actuator's private data.
+ */
+static void pwm_channel_configure(pwm_actpriv_t *priv) {
+    uint8_t channel = priv->info->channel;
+
+    priv->device->config.channels[channel].channel = channel;
+    priv->device->config.channels[channel].cpol = 1;
+    priv->device->config.channels[channel].dcpol = 0;
+}
+
+/*
+ * Open a PWM device, read its configuration and configure the channels of the actuators on it, if it is not already
+ * open.
+ * @param device The PWM device to open.
+ * @return 0 on success, error code on failure.
+ */
+static int pwm_device_open(pwm_device_t *device) {
     int err;
-    pwm_actinfo_t *priv = (pwm_actinfo_t *)act->priv;
-    struct pwm_info_s pwm_config;
 
-    /* Open the PWM actuator file */
+    if (device->fd >= 0) return 0;
 
-    fd = open(priv->dev, O_RDWR);
-    if (fd < 0) {
-        return errno;
+    device->fd = open(device->dev, O_RDWR | O_CLOEXEC);
+    if (device->fd < 0) {
+        err = errno;
+        herr("Failed to open PWM device '%s' with err %d\n", device->dev, err);
+        return err;
     }
 
-    /* Get the configuration */
+    if (ioctl(device->fd, PWMIOC_GETCHARACTERISTICS, &device->config) < 0) {
+        err = errno;
+        herr("Failed to get characteristics of '%s' with err %d\n", device->dev, err);
+        close(device->fd);
+        device->fd = -1;
+        return err;
+    }
+
+    device->config.frequency = DEFAULT_FREQUENCY;
+    device->started = false;
 
-    hinfo("Got characteristics\n");
-    err = ioctl(fd, PWMIOC_GETCHARACTERISTICS, &pwm_config);
-    if (err < 0) {
-        return errno;
+    for (unsigned int i = 0; i < NUM_ACTUATORS; i++) {
+        if (pwm_privs[i].device == device) {
+            pwm_channel_configure(&pwm_privs[i]);
+        }
     }
+    return 0;
+}
 
-    hinfo("Freq: %lu\n", pwm_config.frequency);
-    hinfo("Duty 0: %lu\n", pwm_config.channels[0].duty);
-    hinfo("Duty 1: %lu\n", pwm_config.channels[1].duty);
+/*
+ * Sends a PWM signal to the device based on the open or close pulse duration.
+ * @param act The PWM actuator to send the signal to
+ * @param open True to send an open pulse, false to send a close pulse
+ * @return 0 on success, -1 on failure with errno set
+ */
+static int pwm_send_signal(actuator_t *act, bool open_act) {
+    pwm_actpriv_t *priv = act->priv;
+    pwm_device_t *device = priv->device;
+    int err;
 
-    pwm_config.frequency = DEFAULT_FREQUENCY;
+    if (device == NULL) {
+        errno = ENODEV;
+        return -1;
+    }
 
-    /* Configure only the active channel */
+    /* Only the first actuation after a failed set up pays for opening the device */
 
-    pwm_config.channels[priv->channel].channel = priv->channel;
-    pwm_config.channels[priv->channel].cpol = 1;
-    pwm_config.channels[priv->channel].dcpol = 0;
+    err = pwm_device_open(device);
+    if (err) {
+        errno = err;
+        return -1;
+    }
 
     /* Choose open or close pulse duration */
 
     if (open_act) {
-        pwm_config.channels[priv->channel].duty = priv->open_duty;
+        device->config.channels[priv->info->channel].duty = priv->info->open_duty;
     } else {
-        pwm_config.channels[priv->channel].duty = priv->close_duty;
+        device->config.channels[priv->info->channel].duty = priv->info->close_duty;
     }
 
-    hinfo("Freq: %lu\n", pwm_config.frequency);
-    hinfo("duty 0: %lu\n", pwm_config.channels[0].duty);
-    hinfo("duty 1: %lu\n", pwm_config.channels[1].duty);
-
-    /* Set the configuration */
+    /* Set the configuration, which takes effect immediately once the output is started */
 
-    err = ioctl(fd, PWMIOC_SETCHARACTERISTICS, &pwm_config);
-    if (err < 0) {
-        return errno;
+    if (ioctl(device->fd, PWMIOC_SETCHARACTERISTICS, &device->config) < 0) {
+        err = errno;
+        herr("Failed to set characteristics with err %d\n", err);
+        errno = err;
+        return -1;
     }
-    hinfo("Set characteristics\n");
 
-    /* Turn on the PWM signal */
+    /* Turn on the PWM signal the first time only */
 
-    err = ioctl(fd, PWMIOC_START, NULL);
-    if (err < 0) {
-        return errno;
+    if (!device->started) {
+        if (ioctl(device->fd, PWMIOC_START, NULL) < 0) {
+            err = errno;
+            herr("Failed to start PWM with err %d\n", err);
+            errno = err;
+            return -1;
+        }
+        device->started = true;
     }
-    hinfo("Started PWM\n");
 
-    return err;
+    return 0;
 }
 
 /*
  * Turn on the PWM actuator.
  * @param act The PWM actuator to turn on
- * @return 0 on success, error code on failure
+ * @return 0 on success, -1 on failure with errno set
  */
 static int pwm_actuator_on(actuator_t *act) { return pwm_send_signal(act, false); }
 
 /*
  * Turn off the PWM actuator.
  * @param act The PWM actuator to turn off
- * @return 0 on success, error code on failure
+ * @return 0 on success, -1 on failure with errno set
  */
 static int pwm_actuator_off(actuator_t *act) { return pwm_send_signal(act, true); }
 
 /*
- * Initialize a PWM actuator.
+ * Initialize a PWM actuator, opening and configuring its device so that actuations only change the duty cycle.
  * @param act The actuator structure to initialize.
  * @param id The actuator ID
  * @param info The information describing the PWM device settings
+ * @return 0 on success, an error code if the device could not be set up (it is set up again on the next actuation)
  */
-void pwm_actuator_init(actuator_t *act, uint8_t id, const pwm_actinfo_t *info) {
-    actuator_init(act, id, pwm_actuator_on, pwm_actuator_off, (void *)info);
+int pwm_actuator_init(actuator_t *act, uint8_t id, const pwm_actinfo_t *info) {
+    pwm_actpriv_t *priv = &pwm_privs[id];
+    int err;
+
+    priv->info = info;
+    priv->device = pwm_device_get(info->dev);
+    actuator_init(act, id, pwm_actuator_on, pwm_actuator_off, priv);
+    if (priv->device == NULL) {
+        herr("Too many PWM devices to add '%s'\n", info->dev);
+        return ENOMEM;
+    }
+
+    /* The device may already be open for an actuator on another of its channels */
+
+    err = pwm_device_open(priv->device);
+    if (err) return err;
+
+    pwm_channel_configure(priv);
+    return 0;
 }
@@ -10,12 +10,16 @@ typedef struct {
     uint16_t open_duty;  /* The duty cycle to open the device out of 0xffff being 100% */
 } pwm_actinfo_t;
 
+/* The maximum number of PWM devices actuators are connected to. Actuators on channels of the same device share it. */
+#define PWM_MAX_DEVICES 4
+
 /*
- * Initialize a PWM actuator.
+ * Initialize a PWM actuator, opening and configuring its device so that actuations only change the duty cycle.
  * @param act The actuator structure to initialize.
  * @param id The actuator ID
- * @param dev The path to the PWM character device
+ * @param info The information describing the PWM device settings
+ * @return 0 on success, an error code if the device could not be set up (it is set up again on the next actuation)
  */
-void pwm_actuator_init(actuator_t *act, uint8_t id, const pwm_actinfo_t *info);
+int pwm_actuator_init(actuator_t *act, uint8_t id, const pwm_actinfo_t *info);
 
 #endif // _PWM_ACTUATOR_H_
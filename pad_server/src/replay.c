@@ -0,0 +1,432 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../packets/packet.h"
+#include "replay.h"
+
+_Static_assert(sizeof(replay_header_t) == 48, "Replay file header layout changed");
+_Static_assert(sizeof(replay_column_t) == 32, "Replay file column layout changed");
+_Static_assert(sizeof(replay_index_t) == 8, "Replay file index layout changed");
+
+/* Round up to the next multiple of 8 bytes */
+
+#define align8(n) (((n) + 7) & ~((size_t)7))
+
+/* Mapping of a CSV column name to the telemetry it is replayed as */
+typedef struct {
+    const char *prefix; /* Column name, or column name prefix if the sensor ID is part of the name */
+    bool numbered;      /* True if the column name is the prefix followed by the sensor ID */
+    uint8_t subtype;    /* Telemetry sub-type the column is replayed as */
+    bool milli;         /* True if the telemetry message is in thousandths of the CSV column's unit */
+} replay_mapping_t;
+
+static const replay_mapping_t COLUMN_MAPPINGS[] = {
+    {.prefix = "Mass", .numbered = false, .subtype = TELEM_MASS, .milli = true},         /* kg -> g */
+    {.prefix = "Thrust", .numbered = false, .subtype = TELEM_THRUST, .milli = false},    /* N -> N */
+    {.prefix = "Cont", .numbered = false, .subtype = TELEM_CONT, .milli = false},        /* Open/closed */
+    {.prefix = "P", .numbered = true, .subtype = TELEM_PRESSURE, .milli = true},         /* PSI -> 0.001 PSI */
+    {.prefix = "T", .numbered = true, .subtype = TELEM_TEMP, .milli = true},             /* C -> 0.001 C */
+};
+
+/*
+ * Parse a decimal number into thousandths of its unit, rounding any further digits. No floating point is involved, so
+ * values such as 33.313 are represented exactly.
+ * @param str The string to parse, which may be surrounded by white space.
+ * @param out Output for the parsed value.
+ * @return 0 on success, EINVAL if the string is not a number, ERANGE if it does not fit.
+ */
+static int parse_milli(const char *str, int32_t *out) {
+    int64_t value = 0;
+    int frac_digits = 0;
+    bool negative = false;
+    bool digits = false;
+
+    while (isspace((unsigned char)*str)) str++;
+
+    if (*str == '-' || *str == '+') {
+        negative = *str == '-';
+        str++;
+    }
+
+    for (; isdigit((unsigned char)*str); str++) {
+        value = value * 10 + (*str - '0');
+        digits = true;
+        if (value > (int64_t)INT32_MAX + 1) return ERANGE;
+    }
+
+    if (*str == '.') {
+        str++;
+        for (; isdigit((unsigned char)*str); str++) {
+            digits = true;
+            if (frac_digits < 3) {
+                value = value * 10 + (*str - '0');
+                frac_digits++;
+            } else if (frac_digits == 3) {
+                value += (*str >= '5'); /* Round on the first digit past the resolution */
+                frac_digits++;
+            }
+        }
+    }
+
+    while (isspace((unsigned char)*str)) str++;
+    if (!digits || *str != '\0') return EINVAL;
+
+    for (; frac_digits < 3; frac_digits++) {
+        value *= 10;
+    }
+
+    value = negative ? -value : value;
+    if (value > INT32_MAX || value < INT32_MIN) return ERANGE;
+
+    *out = (int32_t)value;
+    return 0;
+}
+
+/*
+ * Find the telemetry a CSV column is replayed as.
+ * @param name The column name.
+ * @param column Output for the column description, whose offset is left untouched.
+ * @param milli Output set to true if the column is stored in thousandths of its CSV unit.
+ * @return True if the column is replayed, false if it has no telemetry equivalent.
+ */
+static bool replay_map_column(const char *name, replay_column_t *column, bool *milli) {
+    for (size_t i = 0; i < sizeof(COLUMN_MAPPINGS) / sizeof(COLUMN_MAPPINGS[0]); i++) {
+        const replay_mapping_t *map = &COLUMN_MAPPINGS[i];
+        size_t prefix_len = strlen(map->prefix);
+        unsigned long id = 0;
+
+        if (!map->numbered) {
+            if (strcasecmp(name, map->prefix) != 0) continue;
+        } else {
+            char *end;
+            if (strncasecmp(name, map->prefix, prefix_len) != 0 || !isdigit((unsigned char)name[prefix_len])) continue;
+            id = strtoul(&name[prefix_len], &end, 10);
+            if (*end != '\0' || id > UINT8_MAX) continue;
+        }
+
+        memset(column, 0, sizeof(*column));
+        strncpy(column->name, name, sizeof(column->name) - 1);
+        column->subtype = map->subtype;
+        column->id = (uint8_t)id;
+        *milli = map->milli;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Set up the section pointers of a replay from its file image, validating that every section lies within the image.
+ * @param replay The replay whose `base` and `size` describe the image.
+ * @return 0 on success, EINVAL if the image is not a valid replay file.
+ */
+static int replay_attach(replay_t *replay) {
+    const uint8_t *base = replay->base;
+    const replay_header_t *hdr = replay->base;
+    size_t col_bytes;
+
+    if (replay->size < sizeof(*hdr) || memcmp(hdr->magic, REPLAY_MAGIC, sizeof(hdr->magic)) != 0) return EINVAL;
+    if (hdr->version != REPLAY_VERSION) return EINVAL;
+    if (hdr->ncolumns == 0 || hdr->ncolumns > REPLAY_MAX_COLUMNS || hdr->nrows == 0 || hdr->index_stride == 0) {
+        return EINVAL;
+    }
+    if (hdr->nindex != (hdr->nrows + hdr->index_stride - 1) / hdr->index_stride) return EINVAL;
+
+    col_bytes = (size_t)hdr->nrows * sizeof(uint32_t);
+    if (sizeof(*hdr) + hdr->ncolumns * sizeof(replay_column_t) > replay->size) return EINVAL;
+    if (hdr->time_offset % 8 || hdr->time_offset > replay->size || replay->size - hdr->time_offset < col_bytes) {
+        return EINVAL;
+    }
+    if (hdr->index_offset % 8 || hdr->index_offset > replay->size ||
+        replay->size - hdr->index_offset < hdr->nindex * sizeof(replay_index_t)) {
+        return EINVAL;
+    }
+
+    replay->hdr = hdr;
+    replay->columns = (const replay_column_t *)(base + sizeof(*hdr));
+    replay->time = (const uint32_t *)(base + hdr->time_offset);
+    replay->index = (const replay_index_t *)(base + hdr->index_offset);
+
+    for (uint32_t c = 0; c < hdr->ncolumns; c++) {
+        const replay_column_t *col = &replay->columns[c];
+        if (col->offset % 8 || col->offset > replay->size || replay->size - col->offset < col_bytes) return EINVAL;
+        if (packet_telem_body_len(col->subtype) == 0) return EINVAL;
+        replay->values[c] = (const int32_t *)(base + col->offset);
+    }
+
+    return 0;
+}
+
+/*
+ * Open recorded data for replay. Replay files are memory mapped. Any other file is assumed to be a CSV file, which is
+ * parsed once into memory in the replay file layout.
+ * @param replay The replay to open.
+ * @param path The path to the replay or CSV file.
+ * @return 0 on success, error code on failure.
+ */
+int replay_open(replay_t *replay, const char *path) {
+    char magic[sizeof(((replay_header_t *)0)->magic)];
+    struct stat st;
+    int err;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return errno;
+
+    if (read(fd, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0) {
+        close(fd);
+        return replay_load_csv(replay, path, 0, NULL);
+    }
+
+    if (fstat(fd, &st) < 0) {
+        err = errno;
+        close(fd);
+        return err;
+    }
+
+    replay->size = st.st_size;
+    replay->base = mmap(NULL, replay->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    err = errno;
+    close(fd); /* The mapping stays valid without the descriptor */
+    if (replay->base == MAP_FAILED) return err;
+    replay->mapped = true;
+
+#ifdef MADV_SEQUENTIAL
+    madvise(replay->base, replay->size, MADV_SEQUENTIAL);
+#endif
+
+    err = replay_attach(replay);
+    if (err) replay_close(replay);
+    return err;
+}
+
+/*
+ * Parse a CSV file into memory in the replay file layout. The first line must name the columns. The column named
+ * "Time" holds time stamps in milliseconds; every other column whose name has a telemetry equivalent becomes a data
+ * column and the rest are ignored.
+ * @param replay The replay to load the data into.
+ * @param path The path to the CSV file.
+ * @param period_ms If non-zero, the time stamp of each row is its row number times this period and the "Time" column
+ * is not needed.
+ * @param clamped If not NULL, output for the number of rows whose time stamp went backwards and was clamped to the time
+ * stamp of the previous row.
+ * @return 0 on success, error code on failure.
+ */
+int replay_load_csv(replay_t *replay, const char *path, uint32_t period_ms, uint32_t *clamped) {
+    char line[BUFSIZ];
+    replay_column_t columns[REPLAY_MAX_COLUMNS];
+    bool milli[REPLAY_MAX_COLUMNS];
+    int csv_column[REPLAY_MAX_COLUMNS]; /* CSV column position of each data column */
+    int time_column = -1;
+    uint32_t ncolumns = 0;
+    uint32_t nrows = 0;
+    uint32_t nclamped = 0;
+    int err = 0;
+    FILE *csv;
+
+    csv = fopen(path, "r");
+    if (csv == NULL) return errno;
+
+    /* Map the columns named in the header line */
+
+    if (fgets(line, sizeof(line), csv) == NULL) {
+        fclose(csv);
+        return EINVAL;
+    }
+
+    char *rest = line;
+    char *name;
+    for (int pos = 0; (name = strtok_r(rest, ",\r\n", &rest)) != NULL; pos++) {
+        while (isspace((unsigned char)*name)) name++;
+
+        if (strcasecmp(name, "Time") == 0) {
+            time_column = pos;
+        } else if (ncolumns < REPLAY_MAX_COLUMNS && replay_map_column(name, &columns[ncolumns], &milli[ncolumns])) {
+            csv_column[ncolumns++] = pos;
+        }
+    }
+
+    if (ncolumns == 0 || (time_column < 0 && period_ms == 0)) {
+        fclose(csv);
+        return EINVAL;
+    }
+
+    /* First pass counts the rows so that the image can be allocated in one go */
+
+    long data_start = ftell(csv);
+    while (fgets(line, sizeof(line), csv) != NULL) {
+        if (line[strspn(line, " \t\r\n")] != '\0') nrows++;
+    }
+    if (nrows == 0) {
+        fclose(csv);
+        return EINVAL;
+    }
+
+    /* Lay out the image */
+
+    uint32_t nindex = (nrows + REPLAY_INDEX_STRIDE - 1) / REPLAY_INDEX_STRIDE;
+    size_t col_bytes = align8((size_t)nrows * sizeof(uint32_t));
+    size_t time_offset = align8(sizeof(replay_header_t) + ncolumns * sizeof(replay_column_t));
+    size_t index_offset = time_offset + col_bytes * (1 + ncolumns);
+
+    replay->size = index_offset + nindex * sizeof(replay_index_t);
+    replay->base = calloc(1, replay->size);
+    if (replay->base == NULL) {
+        fclose(csv);
+        return ENOMEM;
+    }
+    replay->mapped = false;
+
+    uint8_t *base = replay->base;
+    replay_header_t *hdr = replay->base;
+    memcpy(hdr->magic, REPLAY_MAGIC, sizeof(hdr->magic));
+    hdr->version = REPLAY_VERSION;
+    hdr->ncolumns = ncolumns;
+    hdr->nrows = nrows;
+    hdr->index_stride = REPLAY_INDEX_STRIDE;
+    hdr->nindex = nindex;
+    hdr->time_offset = time_offset;
+    hdr->index_offset = index_offset;
+
+    uint32_t *time = (uint32_t *)(base + time_offset);
+    int32_t *values[REPLAY_MAX_COLUMNS];
+    for (uint32_t c = 0; c < ncolumns; c++) {
+        columns[c].offset = time_offset + col_bytes * (1 + c);
+        values[c] = (int32_t *)(base + columns[c].offset);
+    }
+    memcpy(base + sizeof(*hdr), columns, ncolumns * sizeof(replay_column_t));
+
+    /* Second pass parses every row */
+
+    fseek(csv, data_start, SEEK_SET);
+    for (uint32_t row = 0; row < nrows && fgets(line, sizeof(line), csv) != NULL;) {
+        char *fields[REPLAY_MAX_COLUMNS * 2];
+        int nfields = 0;
+        int32_t value;
+
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        rest = line;
+        while (nfields < (int)(sizeof(fields) / sizeof(fields[0])) &&
+               (fields[nfields] = strtok_r(rest, ",\r\n", &rest)) != NULL) {
+            nfields++;
+        }
+
+        /* Time stamps must never decrease, so that the time index can be searched */
+
+        if (period_ms != 0) {
+            time[row] = row * period_ms;
+        } else {
+            if (time_column >= nfields || (err = parse_milli(fields[time_column], &value)) != 0 || value < 0) {
+                err = err ? err : EINVAL;
+                break;
+            }
+            time[row] = value / 1000;
+            if (row > 0 && time[row] < time[row - 1]) {
+                time[row] = time[row - 1];
+                nclamped++;
+            }
+        }
+
+        for (uint32_t c = 0; c < ncolumns; c++) {
+            if (csv_column[c] >= nfields || (err = parse_milli(fields[csv_column[c]], &value)) != 0) {
+                err = err ? err : EINVAL;
+                break;
+            }
+            values[c][row] = milli[c] ? value : value / 1000;
+        }
+        if (err) break;
+
+        row++;
+    }
+    fclose(csv);
+
+    if (err) {
+        replay_close(replay);
+        return err;
+    }
+
+    /* Build the time index */
+
+    replay_index_t *index = (replay_index_t *)(base + index_offset);
+    for (uint32_t i = 0; i < nindex; i++) {
+        index[i].row = i * REPLAY_INDEX_STRIDE;
+        index[i].time = time[index[i].row];
+    }
+
+    if (clamped != NULL) *clamped = nclamped;
+
+    return replay_attach(replay);
+}
+
+/*
+ * Write recorded data to a replay file.
+ * @param replay The replay to write.
+ * @param path The path of the replay file to create.
+ * @return 0 on success, error code on failure.
+ */
+int replay_write(const replay_t *replay, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) return errno;
+
+    if (fwrite(replay->base, 1, replay->size, out) != replay->size) {
+        int err = errno;
+        fclose(out);
+        return err;
+    }
+
+    if (fclose(out) != 0) return errno;
+    return 0;
+}
+
+/*
+ * Find the first row recorded at or after a time stamp.
+ * @param replay The replay to search.
+ * @param time The time stamp in milliseconds.
+ * @return The row number, or the number of rows if every row was recorded before `time`.
+ */
+uint32_t replay_seek(const replay_t *replay, uint32_t time) {
+    uint32_t lo = 0;
+    uint32_t hi = replay->hdr->nindex;
+
+    /* Find the last index entry before `time` */
+
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (replay->index[mid].time < time) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /* Scan the rows following that entry */
+
+    uint32_t row = replay->index[lo].row;
+    while (row < replay->hdr->nrows && replay->time[row] < time) {
+        row++;
+    }
+    return row;
+}
+
+/*
+ * Close recorded data opened for replay.
+ * @param replay The replay to close.
+ */
+void replay_close(replay_t *replay) {
+    if (replay->base == NULL) return;
+
+    if (replay->mapped) {
+        munmap(replay->base, replay->size);
+    } else {
+        free(replay->base);
+    }
+    replay->base = NULL;
+}
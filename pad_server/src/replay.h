@@ -0,0 +1,85 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Replay files hold recorded sensor data in a packed, columnar, binary form so that they can be memory mapped and
+ * replayed without any parsing. All values are in host byte order. The layout of a replay file is:
+ *
+ * - A `replay_header_t`
+ * - `ncolumns` of `replay_column_t`, describing each data column
+ * - The time column, `nrows` of `uint32_t` time stamps in milliseconds, never decreasing
+ * - Each data column, `nrows` of `int32_t` values already in the units of the column's telemetry message
+ * - The time index, `nindex` of `replay_index_t`, one entry every `index_stride` rows
+ *
+ * Every section starts on an 8 byte boundary.
+ */
+
+#define REPLAY_MAGIC "HYREPLAY"
+#define REPLAY_VERSION 1
+#define REPLAY_MAX_COLUMNS 16
+#define REPLAY_INDEX_STRIDE 256
+#define REPLAY_NAME_LEN 16
+
+/* Header of a replay file */
+typedef struct {
+    char magic[8];         /* Always REPLAY_MAGIC, without the null terminator */
+    uint32_t version;      /* Version of the replay file format */
+    uint32_t ncolumns;     /* Number of data columns */
+    uint32_t nrows;        /* Number of rows in every column */
+    uint32_t index_stride; /* Number of rows between consecutive time index entries */
+    uint32_t nindex;       /* Number of time index entries */
+    uint32_t reserved;
+    uint64_t time_offset;  /* Offset of the time column from the start of the file */
+    uint64_t index_offset; /* Offset of the time index from the start of the file */
+} replay_header_t;
+
+/* Description of a data column in a replay file */
+typedef struct {
+    char name[REPLAY_NAME_LEN]; /* Name of the column, null terminated */
+    uint8_t subtype;            /* Telemetry sub-type the column is replayed as */
+    uint8_t id;                 /* Sensor ID the column is replayed as */
+    uint8_t reserved[6];
+    uint64_t offset; /* Offset of the column's values from the start of the file */
+} replay_column_t;
+
+/* Entry of the time index of a replay file */
+typedef struct {
+    uint32_t time; /* Time stamp of the row in milliseconds */
+    uint32_t row;  /* Row number */
+} replay_index_t;
+
+/* Recorded data opened for replay */
+typedef struct {
+    void *base;                                   /* Start of the replay file image */
+    size_t size;                                  /* Size of the replay file image in bytes */
+    bool mapped;                                  /* True if the image is memory mapped, false if it is allocated */
+    const replay_header_t *hdr;                   /* The replay file header */
+    const replay_column_t *columns;               /* The data column descriptions */
+    const uint32_t *time;                         /* The time column */
+    const int32_t *values[REPLAY_MAX_COLUMNS];    /* The data columns */
+    const replay_index_t *index;                  /* The time index */
+} replay_t;
+
+/* Options controlling how recorded data is played back. Offsets are in milliseconds from the first recorded row. */
+typedef struct {
+    double speed;           /* Playback speed multiplier, or 0 to play back as fast as possible */
+    uint32_t seek_ms;       /* Offset to start playback from */
+    uint32_t loop_start_ms; /* Offset of the start of the region played in a loop */
+    uint32_t loop_end_ms;   /* Offset of the end of the region played in a loop, or 0 for the end of the recording */
+} replay_opts_t;
+
+/* Slowest and fastest playback speed multipliers, besides playing as fast as possible */
+#define REPLAY_SPEED_MIN 0.1
+#define REPLAY_SPEED_MAX 100.0
+
+int replay_open(replay_t *replay, const char *path);
+int replay_load_csv(replay_t *replay, const char *path, uint32_t period_ms, uint32_t *clamped);
+int replay_write(const replay_t *replay, const char *path);
+uint32_t replay_seek(const replay_t *replay, uint32_t time);
+void replay_close(replay_t *replay);
+
+#endif // _REPLAY_H_
@@ -0,0 +1,403 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__) || defined(CONFIG_TIMER_FD)
+#include <sys/timerfd.h>
+#define SEQUENCE_TIMERFD
+#endif
+
+#include "../../debugging/logging.h"
+#include "../../debugging/nxassert.h"
+#include "deadline.h"
+#include "sequence.h"
+
+/* Helper function for returning an error code from a thread */
+
+#define thread_return(e) pthread_exit((void *)(unsigned long)((e)))
+
+/*
+ * Initialize an empty actuation sequence.
+ * @param seq The sequence to initialize.
+ * @param state The pad state the sequence actuates.
+ * @return 0 on success, error code on failure.
+ */
+int sequence_init(sequence_t *seq, padstate_t *state) {
+    int err;
+
+    seq->state = state;
+    seq->nsteps = 0;
+    seq->running = false;
+    seq->aborted = false;
+    seq->timer = -1;
+
+    err = pthread_mutex_init(&seq->lock, NULL);
+    if (err) return err;
+
+    err = ringbuf_init(&seq->reports, seq->report_slots, sizeof(seq->report_slots[0]), SEQUENCE_REPORTS);
+    if (err) return err;
+
+    err = notify_init(&seq->requests);
+    if (err) return err;
+
+#if defined(SEQUENCE_TIMERFD)
+    seq->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (seq->timer < 0) {
+        err = errno;
+        notify_close(&seq->requests);
+        return err;
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * Upload steps of the actuation sequence. Steps are uploaded in order, and an upload starting at the first step
+ * replaces the whole sequence. The arming level is not checked here, but when each step is carried out. An invalid
+ * upload discards the sequence.
+ * @param seq The sequence to upload to.
+ * @param first The index of the first step uploaded.
+ * @param steps The steps to upload.
+ * @param count The number of steps to upload.
+ * @return SEQ_OK on success, SEQ_BUSY if the sequence is running, SEQ_INV if the steps are invalid or out of place.
+ */
+seq_ack_status_e sequence_upload(sequence_t *seq, uint8_t first, const seq_step_p *steps, uint8_t count) {
+    seq_ack_status_e status = SEQ_OK;
+    const seq_step_p *prev;
+
+    pthread_mutex_lock(&seq->lock);
+
+    if (seq->running) {
+        status = SEQ_BUSY;
+        goto unlock;
+    }
+
+    /* Steps must continue where the last upload left off, unless they replace the sequence */
+
+    if (first == 0) {
+        seq->nsteps = 0;
+    } else if (first != seq->nsteps) {
+        hwarn("Sequence upload starts at step %u, expected %u\n", first, seq->nsteps);
+        status = SEQ_INV;
+        goto unlock;
+    }
+
+    if (count > SEQ_UPLOAD_MAX || seq->nsteps + count > SEQUENCE_MAX_STEPS) {
+        hwarn("Sequence upload of %u steps is too long\n", count);
+        status = SEQ_INV;
+        goto unlock;
+    }
+
+    prev = seq->nsteps > 0 ? &seq->steps[seq->nsteps - 1] : NULL;
+    for (uint8_t i = 0; i < count; i++) {
+        if (steps[i].id >= NUM_ACTUATORS || steps[i].state > 1 || steps[i].offset > SEQ_OFFSET_MAX ||
+            (prev != NULL && steps[i].offset < prev->offset)) {
+            hwarn("Sequence step %u is invalid\n", first + i);
+            status = SEQ_INV;
+            goto unlock;
+        }
+        prev = &steps[i];
+    }
+
+    memcpy(&seq->steps[seq->nsteps], steps, count * sizeof(steps[0]));
+    seq->nsteps += count;
+    hinfo("Sequence has %u steps\n", seq->nsteps);
+
+unlock:
+
+    /* A refused upload discards the whole sequence, so that only part of it can never be started */
+
+    if (status == SEQ_INV) seq->nsteps = 0;
+    pthread_mutex_unlock(&seq->lock);
+    return status;
+}
+
+/*
+ * Start the uploaded actuation sequence.
+ * @param seq The sequence to start.
+ * @return SEQ_OK on success, SEQ_BUSY if the sequence is already running, SEQ_EMPTY if no steps were uploaded.
+ */
+seq_ack_status_e sequence_start(sequence_t *seq) {
+    seq_ack_status_e status = SEQ_OK;
+
+    pthread_mutex_lock(&seq->lock);
+    if (seq->running) {
+        status = SEQ_BUSY;
+    } else if (seq->nsteps == 0) {
+        status = SEQ_EMPTY;
+    } else {
+        seq->running = true;
+        seq->aborted = false;
+        notify_post(&seq->requests, SEQUENCE_START);
+    }
+    pthread_mutex_unlock(&seq->lock);
+    return status;
+}
+
+/*
+ * Abort the running actuation sequence. The steps already carried out are not undone, but no step is carried out once
+ * this returns.
+ * @param seq The sequence to abort.
+ * @return SEQ_OK, whether or not the sequence was running.
+ */
+seq_ack_status_e sequence_abort(sequence_t *seq) {
+    pthread_mutex_lock(&seq->lock);
+    if (seq->running) {
+        seq->aborted = true;
+        notify_post(&seq->requests, SEQUENCE_ABORT);
+    }
+    pthread_mutex_unlock(&seq->lock);
+    return SEQ_OK;
+}
+
+/*
+ * Take the reports of steps carried out since the last call. Only one thread may take reports.
+ * @param seq The sequence to take reports from.
+ * @param reports The buffer to copy reports into.
+ * @param max The number of reports `reports` can hold.
+ * @return The number of reports copied.
+ */
+size_t sequence_reports(sequence_t *seq, seq_step_state_p *reports, size_t max) {
+    return ringbuf_pull(&seq->reports, reports, max);
+}
+
+/*
+ * Get the time from the start of a sequence to a point in time.
+ * @param start The start of the sequence.
+ * @param now The point in time.
+ * @return The time elapsed in microseconds.
+ */
+static uint32_t sequence_elapsed_us(const struct timespec *start, const struct timespec *now) {
+    return (uint32_t)((int64_t)(now->tv_sec - start->tv_sec) * 1000000 + (now->tv_nsec - start->tv_nsec) / 1000);
+}
+
+/*
+ * Check whether the running sequence was aborted.
+ * @param seq The running sequence.
+ * @return True if the sequence was aborted.
+ */
+static bool sequence_aborted(sequence_t *seq) {
+    bool aborted;
+
+    pthread_mutex_lock(&seq->lock);
+    aborted = seq->aborted;
+    pthread_mutex_unlock(&seq->lock);
+    return aborted;
+}
+
+/*
+ * Mark the running sequence as aborted, when it cannot go on.
+ * @param seq The running sequence.
+ * @return True, for returning from `sequence_wait`.
+ */
+static bool sequence_give_up(sequence_t *seq) {
+    pthread_mutex_lock(&seq->lock);
+    seq->aborted = true;
+    pthread_mutex_unlock(&seq->lock);
+    return true;
+}
+
+/*
+ * Wait until a step's deadline, or until the sequence is aborted. An abort request left over from an earlier run
+ * only ends the wait early, so the caller must check whether the sequence was aborted.
+ * @param seq The running sequence.
+ * @param deadline The deadline of the step, measured on CLOCK_MONOTONIC.
+ * @return True if an abort was requested or the wait failed, false once the deadline is reached.
+ */
+static bool sequence_wait(sequence_t *seq, const struct timespec *deadline) {
+#if defined(SEQUENCE_TIMERFD)
+
+    /* The timer fires at the absolute deadline, so time spent carrying out earlier steps does not delay later ones */
+
+    struct itimerspec its = {.it_value = *deadline};
+    struct pollfd fds[2] = {
+        {.fd = seq->timer, .events = POLLIN},
+        {.fd = seq->requests.rfd, .events = POLLIN},
+    };
+    uint64_t expirations;
+
+    if (timerfd_settime(seq->timer, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        herr("Could not arm sequence timer: %d\n", errno);
+        deadline_sleep(deadline);
+        return (notify_wait(&seq->requests, 0) & SEQUENCE_ABORT) != 0;
+    }
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            herr("Could not wait for sequence step: %d\n", errno);
+            return sequence_give_up(seq);
+        }
+        if (fds[1].revents && (notify_wait(&seq->requests, 0) & SEQUENCE_ABORT)) return true;
+        if (fds[0].revents) {
+            read(seq->timer, &expirations, sizeof(expirations));
+            return false;
+        }
+    }
+#else
+
+    /* Without a timer descriptor, wait for aborts until just short of the deadline and sleep the rest of the way */
+
+    int64_t remaining;
+
+    for (;;) {
+        remaining = deadline_remaining_us(deadline);
+        if (remaining <= 0) return false;
+        if (remaining < 1000) {
+            deadline_sleep(deadline);
+            return false;
+        }
+        if (notify_wait(&seq->requests, remaining / 1000) & SEQUENCE_ABORT) return true;
+    }
+#endif
+}
+
+/*
+ * Queue the report of a step for telemetry.
+ * @param seq The running sequence.
+ * @param index The index of the step.
+ * @param step The step.
+ * @param scheduled The time the step was due, in microseconds since the sequence started.
+ * @param actual The time the step was carried out, in microseconds since the sequence started.
+ * @param status The outcome of the step.
+ */
+static void sequence_report(sequence_t *seq, uint8_t index, const seq_step_p *step, uint32_t scheduled,
+                            uint32_t actual, seq_step_status_e status) {
+    struct timespec now;
+    seq_step_state_p report;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    report.time = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    report.scheduled = scheduled;
+    report.actual = actual;
+    report.index = index;
+    report.id = step->id;
+    report.state = step->state;
+    report.status = (uint8_t)status;
+
+    if (!ringbuf_push(&seq->reports, &report)) {
+        hwarn("Dropped report of sequence step %u\n", index);
+    }
+    padstate_notify(seq->state, PADSTATE_CHANGED_SEQ);
+}
+
+/*
+ * Carry out the uploaded sequence, stopping at the first step which does not succeed or once it is aborted.
+ * @param seq The sequence to carry out.
+ */
+static void sequence_execute(sequence_t *seq) {
+    seq_step_p steps[SEQUENCE_MAX_STEPS];
+    actqueue_done_t done;
+    struct timespec start;
+    struct timespec deadline;
+    struct timespec now;
+    seq_step_status_e status = STEP_OK;
+    uint32_t scheduled;
+    uint8_t nsteps;
+    uint8_t i;
+    int err;
+
+    /* Uploads are refused while running, but take a copy so the lock is not held while waiting */
+
+    pthread_mutex_lock(&seq->lock);
+    nsteps = seq->nsteps;
+    memcpy(steps, seq->steps, nsteps * sizeof(steps[0]));
+    pthread_mutex_unlock(&seq->lock);
+
+    hinfo("Starting sequence of %u steps\n", nsteps);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < nsteps && status == STEP_OK; i++) {
+        deadline = start;
+        deadline_add_us(&deadline, (uint64_t)steps[i].offset * 1000);
+        scheduled = (uint32_t)((uint64_t)steps[i].offset * 1000); /* Uploads are limited to SEQ_OFFSET_MAX */
+
+        while (sequence_wait(seq, &deadline) && !sequence_aborted(seq)) {
+            /* A stale abort request, keep waiting */
+        }
+
+        /* The abort flag is checked under the lock the actuation is queued with, so that an acknowledged abort is
+         * never followed by another step */
+
+        pthread_mutex_lock(&seq->lock);
+        if (seq->aborted) {
+            pthread_mutex_unlock(&seq->lock);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            hwarn("Sequence aborted before step %u\n", i);
+            sequence_report(seq, i, &steps[i], scheduled, sequence_elapsed_us(&start, &now), STEP_ABORTED);
+            break;
+        }
+
+        /* The arming rules apply to every step as if it were commanded right now. Wait for the actuation to be carried
+         * out, so that the report holds the time it completed and whether it failed. */
+
+        err = pad_actuate(seq->state, steps[i].id, steps[i].state, &done);
+        pthread_mutex_unlock(&seq->lock);
+
+        if (err == ACT_OK) {
+            err = pad_actuate_wait(seq->state, steps[i].id, &done);
+            if (err) {
+                errno = err;
+                err = -1;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (err == ACT_OK) {
+            status = STEP_OK;
+        } else if (err == -1) {
+            herr("Sequence step %u failed: %s\n", i, strerror(errno));
+            status = STEP_FAILED;
+        } else if (err == ACT_BUSY) {
+            herr("Sequence step %u could not be queued\n", i);
+            status = STEP_FAILED;
+        } else {
+            hwarn("Sequence step %u was denied\n", i);
+            status = STEP_DENIED;
+        }
+
+        sequence_report(seq, i, &steps[i], scheduled, sequence_elapsed_us(&start, &now), status);
+    }
+
+    hinfo("Sequence finished after %u of %u steps\n", i, nsteps);
+
+    pthread_mutex_lock(&seq->lock);
+    seq->running = false;
+    pthread_mutex_unlock(&seq->lock);
+}
+
+/*
+ * Thread which carries out the actuation sequence each time it is started.
+ * @param arg A pointer to the sequence, of type `sequence_t`
+ * @return 0 on success, error code on failure (thread dies)
+ */
+void *sequence_run(void *arg) {
+    sequence_t *seq = arg;
+    struct pollfd pfd = {.fd = seq->requests.rfd, .events = POLLIN};
+    uint32_t requests;
+
+    for (;;) {
+
+        /* Aborts which arrive while idle have nothing to abort. An abort which arrives right after the start, before
+         * this thread wakes, is recorded in the sequence and stops it before its first step. */
+
+        requests = notify_wait(&seq->requests, 0);
+        if (requests & SEQUENCE_START) {
+            sequence_execute(seq);
+            continue;
+        }
+
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            herr("Could not wait for sequence requests: %d\n", errno);
+            thread_return(errno);
+        }
+    }
+
+    nxfail("sequence_run exited");
+    thread_return(0);
+}
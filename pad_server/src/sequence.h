@@ -0,0 +1,50 @@
+#ifndef _SEQUENCE_H_
+#define _SEQUENCE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../packets/packet.h"
+#include "../../ringbuf/ringbuf.h"
+#include "notify.h"
+#include "state.h"
+
+/* The maximum number of steps in an actuation sequence */
+#ifdef CONFIG_HYSIM_PAD_SERVER_MAX_SEQUENCE_STEPS
+#define SEQUENCE_MAX_STEPS CONFIG_HYSIM_PAD_SERVER_MAX_SEQUENCE_STEPS
+#else
+#define SEQUENCE_MAX_STEPS 32
+#endif
+
+_Static_assert(SEQUENCE_MAX_STEPS <= UINT8_MAX, "Sequence steps are indexed by a single byte");
+
+/* Number of step reports which can wait to be sent on telemetry, a power of two */
+#define SEQUENCE_REPORTS 64
+
+/* Requests to the sequence thread */
+#define SEQUENCE_START ((uint32_t)1 << 0) /* Start the uploaded sequence */
+#define SEQUENCE_ABORT ((uint32_t)1 << 1) /* Abort the running sequence */
+
+/* Actuation sequence, uploaded by the controller client and carried out on a schedule by its own thread */
+typedef struct {
+    padstate_t *state;                                /* The pad state actuated by the sequence */
+    pthread_mutex_t lock;                             /* Protects the steps, `running` and `aborted` */
+    seq_step_p steps[SEQUENCE_MAX_STEPS];             /* The uploaded steps, in order of offset */
+    uint8_t nsteps;                                   /* Number of uploaded steps */
+    bool running;                                     /* Whether the sequence is started and not yet finished */
+    bool aborted;                                     /* Whether the running sequence was aborted */
+    notify_t requests;                                /* Start and abort requests for the sequence thread */
+    ringbuf_t reports;                                /* Steps carried out, waiting to be sent on telemetry */
+    seq_step_state_p report_slots[SEQUENCE_REPORTS]; /* Storage of `reports` */
+    int timer;                                        /* Timer descriptor the thread waits on, -1 without one */
+} sequence_t;
+
+int sequence_init(sequence_t *seq, padstate_t *state);
+seq_ack_status_e sequence_upload(sequence_t *seq, uint8_t first, const seq_step_p *steps, uint8_t count);
+seq_ack_status_e sequence_start(sequence_t *seq);
+seq_ack_status_e sequence_abort(sequence_t *seq);
+size_t sequence_reports(sequence_t *seq, seq_step_state_p *reports, size_t max);
+void *sequence_run(void *arg);
+
+#endif // _SEQUENCE_H_
@@ -2,12 +2,18 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/ioctl.h>
+#include <time.h>
 
 #include "../../debugging/logging.h"
+#include "../../debugging/nxassert.h"
+#include "actqueue.h"
 #include "actuator.h"
+#include "arming.h"
 #include "gpio_actuator.h"
 #include "pwm_actuator.h"
 #include "state.h"
@@ -21,6 +27,8 @@ struct actuator_info {
     } priv;
 };
 
+_Static_assert(ARM_ALL_ACTUATORS == ACT_BIT(NUM_ACTUATORS) - 1, "The arming tables must cover every actuator");
+
 static const struct actuator_info ACTUATORS[] = {
     {.id = ID_XV1, .gpio = true, .priv = {.dev = "/dev/gpio0"}},
     {.id = ID_XV2, .gpio = true, .priv = {.dev = "/dev/gpio1"}},
@@ -56,80 +64,281 @@ static const struct actuator_info ACTUATORS[] = {
 };
 
 /*
- * Initialize the shared pad state. This includes initializing the synchronization objects (rwlock), pad arming state
- * and actuators.
+ * Begin writing the pad state. Readers retry rather than block, so the writer never waits on them; writers only wait on
+ * each other.
+ * @param state The pad state to write
+ * @return 0 on success, errno code on failure
+ */
+static int padstate_write_begin(padstate_t *state) {
+    int err = pthread_mutex_lock(&state->write_mut);
+    if (err) return err;
+
+    atomic_fetch_add_explicit(&state->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return 0;
+}
+
+/*
+ * Finish writing the pad state, publishing the changes to readers and notifying subscribers.
+ * @param state The pad state that was written
+ * @param changes The change mask of what was written, see `PADSTATE_CHANGED_*`
+ */
+static void padstate_write_end(padstate_t *state, uint32_t changes) {
+    atomic_fetch_add_explicit(&state->seq, 1, memory_order_release);
+    pthread_mutex_unlock(&state->write_mut);
+    padstate_notify(state, changes);
+}
+
+_Static_assert((PADSTATE_DONE_LEN & (PADSTATE_DONE_LEN - 1)) == 0, "PADSTATE_DONE_LEN must be a power of 2");
+
+/*
+ * Publish the outcome of an actuation carried out or dropped by the worker of a bus. A quick disconnect or igniter
+ * actuation raises the arming level only here, once it succeeded, so that later commands are checked against the level
+ * the hardware reached. The outcome is kept for subscribers to report, see `padstate_read_done`.
+ * @param ctx The pad state, of type `padstate_t`
+ * @param act The actuator which was actuated
+ * @param req_state The state the actuator was to be put in
+ * @param err 0 on success, ECANCELED if the actuation was pre-empted, errno code on failure
+ */
+static void pad_actuation_done(void *ctx, actuator_t *act, bool req_state, int err) {
+    padstate_t *state = ctx;
+    padstate_done_t *done;
+    uint32_t changes = PADSTATE_CHANGED_DONE;
+    uint32_t states;
+    arm_lvl_e level;
+    arm_lvl_e next;
+
+    if (err && err != ECANCELED) {
+        herr("Failed to set actuator %s -> %u: %s\n", actuator_get_name(act), req_state, strerror(err));
+    }
+
+    if (padstate_write_begin(state)) return;
+
+    /* The actuator's state and the arming level it leads to change in the same write, so a snapshot never shows one
+     * without the other */
+
+    if (!err) {
+        states = atomic_load_explicit(&state->act_states, memory_order_relaxed);
+        states = req_state ? states | ACT_BIT(act->id) : states & ~ACT_BIT(act->id);
+        atomic_store_explicit(&state->act_states, states, memory_order_relaxed);
+
+        level = atomic_load_explicit(&state->arm_level, memory_order_relaxed);
+        next = arming_after_actuation(level, act->id, req_state);
+        if (next != level) {
+            hinfo("Updated pad state to arming level %s.\n", arm_state_str(next));
+            atomic_store_explicit(&state->arm_level, next, memory_order_relaxed);
+            changes |= PADSTATE_CHANGED_ARM;
+        }
+
+        changes |= ACT_BIT(act->id);
+    }
+
+    done = &state->done[state->ndone & (PADSTATE_DONE_LEN - 1)];
+    done->id = act->id;
+    done->state = req_state;
+    done->err = err;
+    clock_gettime(CLOCK_MONOTONIC, &done->completed);
+    state->ndone++;
+
+    padstate_write_end(state, changes);
+}
+
+/*
+ * Initialize the shared pad state. This includes initializing the synchronization objects (seqlock), pad arming state,
+ * actuators and the actuation queues of their buses. The workers of the buses are started separately, see
+ * `actqueue_run`.
  * @param state The state to initialize.
+ * @return 0 on success, error code on failure.
  */
-void padstate_init(padstate_t *state) {
-    pthread_rwlock_init(&state->rw_lock, NULL);
+int padstate_init(padstate_t *state) {
+    int err;
 
-    state->arm_level = ARMED_PAD;
-    state->conn_status = CONN_RECONNECTING; /* We are attempting to connect on start-up */
+    atomic_init(&state->seq, 0);
+    atomic_init(&state->act_states, 0);
+    state->ndone = 0;
+    pthread_mutex_init(&state->write_mut, NULL);
+    pthread_mutex_init(&state->subs_mut, NULL);
+    for (unsigned int i = 0; i < PADSTATE_MAX_SUBS; i++) {
+        state->subs[i] = NULL;
+    }
 
-    /* Initialize all actuators */
+    atomic_init(&state->arm_level, ARMED_PAD);
+    atomic_init(&state->conn_status, CONN_RECONNECTING); /* We are attempting to connect on start-up */
+
+    err = actqueue_init(&state->buses[ACT_BUS_GPIO], "GPIO", pad_actuation_done, state);
+    if (err) return err;
+
+    err = actqueue_init(&state->buses[ACT_BUS_PWM], "PWM", pad_actuation_done, state);
+    if (err) return err;
+
+    /* Initialize all actuators. Devices are opened once here, so a device which fails to open is only reported; its
+     * actuator opens it again when actuated. */
 
     for (unsigned int i = 0; i < NUM_ACTUATORS; i++) {
         if (ACTUATORS[i].gpio) {
-            gpio_actuator_init(&state->actuators[ACTUATORS[i].id], ACTUATORS[i].id, ACTUATORS[i].priv.dev);
-            hinfo("Initialized GPIO actuator %d\n", ACTUATORS[i].id);
+            err = gpio_actuator_init(&state->actuators[ACTUATORS[i].id], ACTUATORS[i].id, ACTUATORS[i].priv.dev);
+            if (err) {
+                herr("Could not open GPIO actuator %d: %s\n", ACTUATORS[i].id, strerror(err));
+            } else {
+                hinfo("Initialized GPIO actuator %d\n", ACTUATORS[i].id);
+            }
         } else {
-            pwm_actuator_init(&state->actuators[ACTUATORS[i].id], ACTUATORS[i].id, &ACTUATORS[i].priv.pwm);
-            hinfo("Initialized PWM actuator %d\n", ACTUATORS[i].id);
+            err = pwm_actuator_init(&state->actuators[ACTUATORS[i].id], ACTUATORS[i].id, &ACTUATORS[i].priv.pwm);
+            if (err) {
+                herr("Could not set up PWM actuator %d: %s\n", ACTUATORS[i].id, strerror(err));
+            } else {
+                hinfo("Initialized PWM actuator %d\n", ACTUATORS[i].id);
+            }
         }
+        state->actuators[ACTUATORS[i].id].states = &state->act_states;
+        state->act_bus[ACTUATORS[i].id] = ACTUATORS[i].gpio ? ACT_BUS_GPIO : ACT_BUS_PWM;
     }
 
-    pthread_mutex_init(&state->update_mut, NULL);
-    pthread_cond_init(&state->update_cond, NULL);
-    state->update_recorded = false;
+    return 0;
 }
 
 /*
- * Gets the current arming level of the pad.
+ * Copy the fields of the pad state covered by the seqlock, which may be torn unless the copy is validated.
  * @param state The pad state
- * @return The current arming level, or -1 on failure
+ * @param snap The snapshot to fill
  */
-arm_lvl_e padstate_get_level(padstate_t *state) {
-    arm_lvl_e level = -1;
+static void padstate_copy(padstate_t *state, padstate_snapshot_t *snap) {
+    snap->arm_level = atomic_load_explicit(&state->arm_level, memory_order_relaxed);
+    snap->conn_status = atomic_load_explicit(&state->conn_status, memory_order_relaxed);
+    snap->act_states = atomic_load_explicit(&state->act_states, memory_order_relaxed);
+}
 
-    if (pthread_rwlock_rdlock(&state->rw_lock) != 0) {
-        return level;
+/*
+ * Take a consistent copy of the arming level, connection status and all actuator states. This does not block unless a
+ * writer keeps the state busy for PADSTATE_SNAPSHOT_RETRIES attempts, in which case the copy waits for the writer.
+ * @param state The pad state
+ * @param snap The snapshot to fill
+ */
+void padstate_snapshot(padstate_t *state, padstate_snapshot_t *snap) {
+    unsigned int seq;
+
+    for (unsigned int i = 0; i < PADSTATE_SNAPSHOT_RETRIES; i++) {
+        seq = atomic_load_explicit(&state->seq, memory_order_acquire);
+        if (seq & 1) continue;
+
+        padstate_copy(state, snap);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&state->seq, memory_order_relaxed) == seq) {
+            return;
+        }
     }
-    level = state->arm_level;
-    pthread_rwlock_unlock(&state->rw_lock);
-    return level;
+
+    /* Under a fixed priority scheduler, a reader which preempted a lower priority writer would spin forever, since the
+     * writer never runs. Blocking on the writers' lock lets the writer finish. */
+
+    pthread_mutex_lock(&state->write_mut);
+    padstate_copy(state, snap);
+    pthread_mutex_unlock(&state->write_mut);
+}
+
+/*
+ * Gets the current arming level of the pad.
+ * @param state The pad state
+ * @return The current arming level
+ */
+arm_lvl_e padstate_get_level(padstate_t *state) {
+    padstate_snapshot_t snap;
+    padstate_snapshot(state, &snap);
+    return snap.arm_level;
 }
 
 /*
  * Get the connection status of the control client to the pad server.
  * @param state The pad state to get the connection status from
- * @return The connection status, or -1 on failure.
+ * @return The connection status
  */
 conn_status_e padstate_get_connstatus(padstate_t *state) {
-    conn_status_e status = -1;
+    padstate_snapshot_t snap;
+    padstate_snapshot(state, &snap);
+    return snap.conn_status;
+}
+
+/*
+ * Subscribe to changes of the pad state.
+ * @param state The pad state to subscribe to.
+ * @param sub An initialized notification, which is posted the change mask (see `PADSTATE_CHANGED_*`) of every change.
+ * @return 0 on success, ENOMEM if there are too many subscribers, errno code on failure.
+ */
+int padstate_subscribe(padstate_t *state, notify_t *sub) {
+    int err = pthread_mutex_lock(&state->subs_mut);
+    if (err) return err;
 
-    if (pthread_rwlock_rdlock(&state->rw_lock) != 0) {
-        return status;
+    err = ENOMEM;
+    for (unsigned int i = 0; i < PADSTATE_MAX_SUBS; i++) {
+        if (state->subs[i] == NULL) {
+            state->subs[i] = sub;
+            err = 0;
+            break;
+        }
     }
-    status = state->conn_status;
-    pthread_rwlock_unlock(&state->rw_lock);
-    return status;
+
+    pthread_mutex_unlock(&state->subs_mut);
+    return err;
 }
 
 /*
- * Signal an update of the state.
- * @param state The pad state to signal an update for.
- * @return 0 on success, errno code on failure
+ * Stop a subscriber from being notified of changes to the pad state.
+ * @param state The pad state that was subscribed to.
+ * @param sub The subscribed notification.
  */
-int padstate_signal_update(padstate_t *state) {
-    int err;
+void padstate_unsubscribe(padstate_t *state, notify_t *sub) {
+    pthread_mutex_lock(&state->subs_mut);
+    for (unsigned int i = 0; i < PADSTATE_MAX_SUBS; i++) {
+        if (state->subs[i] == sub) {
+            state->subs[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&state->subs_mut);
+}
+
+/*
+ * Notify every subscriber of a change in the pad state.
+ * @param state The pad state that changed.
+ * @param changes The change mask, see `PADSTATE_CHANGED_*`.
+ */
+void padstate_notify(padstate_t *state, uint32_t changes) {
+    pthread_mutex_lock(&state->subs_mut);
+    for (unsigned int i = 0; i < PADSTATE_MAX_SUBS; i++) {
+        if (state->subs[i] != NULL) {
+            notify_post(state->subs[i], changes);
+        }
+    }
+    pthread_mutex_unlock(&state->subs_mut);
+}
 
-    err = pthread_mutex_lock(&state->update_mut);
+/*
+ * Read the next actuation outcome a subscriber has not read yet. Only the latest PADSTATE_DONE_LEN outcomes are kept,
+ * so a subscriber which falls further behind skips the oldest.
+ * @param state The pad state.
+ * @param next The number of the next outcome to read, 0 for a subscriber which has read none. Moved past the outcome
+ * read and any skipped.
+ * @param done Set to the outcome.
+ * @return 0 if an outcome was read, ENOENT if every outcome was read already, errno code on failure.
+ */
+int padstate_read_done(padstate_t *state, uint32_t *next, padstate_done_t *done) {
+    int err = pthread_mutex_lock(&state->write_mut);
     if (err) return err;
 
-    state->update_recorded = true;
-    err = pthread_cond_signal(&state->update_cond);
-    hinfo("Signalled padstate update.\n");
-    pthread_mutex_unlock(&state->update_mut);
+    if (state->ndone - *next > PADSTATE_DONE_LEN) {
+        hwarn("Skipped %u actuation outcomes which were overwritten before being read.\n",
+              state->ndone - *next - PADSTATE_DONE_LEN);
+        *next = state->ndone - PADSTATE_DONE_LEN;
+    }
+
+    if (*next == state->ndone) {
+        err = ENOENT;
+    } else {
+        *done = state->done[*next & (PADSTATE_DONE_LEN - 1)];
+        (*next)++;
+    }
+
+    pthread_mutex_unlock(&state->write_mut);
     return err;
 }
 
@@ -150,43 +359,23 @@ int padstate_change_level(padstate_t *state, arm_lvl_e new_arm) {
 
     /* Lock state for computation */
 
-    err = pthread_rwlock_wrlock(&state->rw_lock);
+    err = padstate_write_begin(state);
     if (err) return ARM_DENIED; /* Might be a better error to return, but this works */
 
-    /* Check if there is an attempt to increase the arming level */
-
-    bool lvl_increase = (new_arm == state->arm_level + 1 && new_arm <= ARMED_LAUNCH);
+    /* The transition table decides whether the arming level can go from where it is to where it is requested */
 
-    /* Check if we are decreasing from the ARMED_VALVES state */
-
-    bool lvl_decrease_from_armed_valves = (state->arm_level == ARMED_VALVES && new_arm == ARMED_PAD);
-
-    /* Check if we are decreasing the arming level from anywhere in the firing sequence, i.e. ignition, quick disconnect
-     * disconnected or armed for launch */
-
-    bool lvl_decrease_from_firing_sequence =
-        (new_arm == ARMED_VALVES && (state->arm_level == ARMED_IGNITION || state->arm_level == ARMED_DISCONNECTED ||
-                                     state->arm_level == ARMED_LAUNCH)) ||
-        new_arm == ARMED_PAD;
-
-    /* If any of these cases are true, we can perform the change */
-
-    if (lvl_increase || lvl_decrease_from_armed_valves || lvl_decrease_from_firing_sequence) {
-        hinfo("Updated pad state to arming level %s.\n", arm_state_str(new_arm));
-        state->arm_level = new_arm;
-    } else {
+    if (!arming_can_change(atomic_load_explicit(&state->arm_level, memory_order_relaxed), new_arm)) {
         hwarn("Rejected arming level %s.\n", arm_state_str(new_arm));
-        pthread_rwlock_unlock(&state->rw_lock);
+        padstate_write_end(state, 0);
         return ARM_DENIED;
     }
 
-    /* Unlock state now that new arming level has been decided */
-
-    pthread_rwlock_unlock(&state->rw_lock);
+    hinfo("Updated pad state to arming level %s.\n", arm_state_str(new_arm));
+    atomic_store_explicit(&state->arm_level, new_arm, memory_order_relaxed);
 
-    /* Signal an update in state */
+    /* Unlock state now that new arming level has been decided, signalling the update */
 
-    padstate_signal_update(state);
+    padstate_write_end(state, PADSTATE_CHANGED_ARM);
 
     return ARM_OK;
 }
@@ -200,18 +389,14 @@ int padstate_set_connstatus(padstate_t *state, conn_status_e new_status) {
 
     /* Get write access to the pad state */
 
-    err = pthread_rwlock_wrlock(&state->rw_lock);
+    err = padstate_write_begin(state);
     if (err) return err;
 
-    state->conn_status = new_status;
-
-    /* Unlock state now that status is set */
-
-    pthread_rwlock_unlock(&state->rw_lock);
+    atomic_store_explicit(&state->conn_status, new_status, memory_order_relaxed);
 
-    /* Signal an update in state */
+    /* Unlock state now that status is set, signalling the update */
 
-    padstate_signal_update(state);
+    padstate_write_end(state, PADSTATE_CHANGED_CONN);
 
     return ARM_OK;
 }
@@ -224,22 +409,19 @@ int padstate_set_connstatus(padstate_t *state, conn_status_e new_status) {
  */
 int padstate_get_actstate(padstate_t *state, uint8_t act_id, bool *act_state) {
     if (act_id >= NUM_ACTUATORS) return -1;
-    *act_state = atomic_load(&state->actuators[act_id].state);
+    *act_state = actuator_get_state(&state->actuators[act_id]);
     return 0;
 }
 
 /*
- * Set the value of an actuator with the required progression
+ * Check whether an actuation is permitted.
+ * @param state The pad state
+ * @param arm_lvl The arming level to check against
  * @param id The actuator id
  * @param req_state The new actuator state
- * @return ACT_OK for success, ACT_DNE for invalid id, ACT_INV for invalid req_state, -1 for errors eith errno being
- * set
+ * @return ACT_OK if the actuation is permitted, otherwise ACT_DNE, ACT_INV or ACT_DENIED
  */
-int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state) {
-    bool is_solenoid_valve;
-    arm_lvl_e arm_lvl;
-    int err;
-    actuator_t *act;
+static act_ack_status_e pad_check_actuation(padstate_t *state, arm_lvl_e arm_lvl, uint8_t id, uint8_t req_state) {
 
     /* Invalid actuator ID */
 
@@ -247,13 +429,6 @@ int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state) {
         hwarn("Invalid actuator ID: %u\n", id);
         return ACT_DNE;
     }
-    act = &state->actuators[id];
-
-    /* Actuator is the dump valve, which can always be actuated */
-
-    if (id == ID_DUMP) goto actuate_actuator;
-
-    is_solenoid_valve = (id >= ID_XV1 && id <= ID_XV12) && id != ID_FIRE_VALVE;
 
     /* Invalid state requested */
 
@@ -262,87 +437,156 @@ int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state) {
         return ACT_INV;
     }
 
-    /* Get the current arming level */
-
-    arm_lvl = padstate_get_level(state);
+    /* Check if the arming level permits for the actuator to be commanded. The dump valve is permitted at every
+     * level. */
 
-    /* Check if the current arming level permits for the actuator to be commanded */
-
-    switch (arm_lvl) {
-    case ARMED_PAD:
-        hwarn("Denied actuation of %s\n", actuator_get_name(act));
+    if (!arming_permits(arm_lvl, id)) {
+        hwarn("Denied actuation of %s\n", actuator_get_name(&state->actuators[id]));
         return ACT_DENIED;
-        break;
-
-    case ARMED_VALVES:
-        if (!is_solenoid_valve) {
-            hwarn("Denied actuation of %s\n", actuator_get_name(act));
-            return ACT_DENIED;
-        }
-        break;
-
-    case ARMED_IGNITION:
-        if (!is_solenoid_valve && id != ID_QUICK_DISCONNECT) {
-            hwarn("Denied actuation of %s\n", actuator_get_name(act));
-            return ACT_DENIED;
-        }
-        break;
+    }
 
-    case ARMED_DISCONNECTED:
-        if (!is_solenoid_valve && id != ID_QUICK_DISCONNECT && id != ID_IGNITER) {
-            hwarn("Denied actuation of %s\n", actuator_get_name(act));
-            return ACT_DENIED;
-        }
-        break;
+    return ACT_OK;
+}
 
-    case ARMED_LAUNCH:
-        /* Every command is available */
-        break;
-    }
+/*
+ * Queue the actuations of several actuators as one unit. The arming level is checked once for the whole batch: either
+ * every actuation is permitted and queued on the actuators' buses under a single pad state update, or none is. Each
+ * bus's worker then carries out its actuations in order and publishes them as they complete. Opening or closing the
+ * dump valve pre-empts the actuations still queued on its bus. Actuations which raise the arming level (quick
+ * disconnect, igniter) do so once their bus's worker has carried them out successfully, so they cannot permit later
+ * entries of the same batch nor commands which arrive before they were carried out, and a failed or pre-empted
+ * actuation does not raise it at all. The control client checks its commands the same way, against the level the pad
+ * last reported.
+ * @param state The pad state
+ * @param reqs The actuations to perform, in order
+ * @param count The number of actuations in `reqs`, at most MULTI_ACT_MAX
+ * @param bad Set to the index of the actuation which caused the batch to be refused. May be NULL.
+ * @param done Where to report the outcome of each actuation, see `actqueue_wait`. NULL if nobody waits on them.
+ * @return ACT_OK for success, ACT_DNE for an invalid id, ACT_INV for an invalid req_state, ACT_DENIED if the arming
+ * level does not permit one of the actuations, ACT_BUSY if a bus has too many actuations queued, -1 for errors with
+ * errno being set
+ */
+static int pad_queue_multi(padstate_t *state, const act_cmd_p *reqs, uint8_t count, uint8_t *bad,
+                           actqueue_done_t *done) {
+    unsigned int needed[NUM_ACT_BUSES] = {0};
+    act_ack_status_e status = ACT_OK;
+    uint8_t i;
+    int b;
+    int err;
 
-actuate_actuator:
+    nxassert(count <= MULTI_ACT_MAX);
 
-    /* For now just always actuate the actuator */
+    /* The arming check and the queuing happen under the same write lock, so the arming level cannot change in
+     * between. Read the level directly, since a snapshot would wait for this write to end. */
 
-    err = actuator_set(act, req_state);
+    err = padstate_write_begin(state);
     if (err) {
-        hwarn("Failed to set actuator %s -> %u\n", actuator_get_name(act), req_state);
         errno = err;
         return -1;
     }
 
-    /* Now we made it past the permission being denied *and* the actuator was successfully actuated.
-     * Check if this actuator is a special actuator that increases the arming level */
+    for (i = 0; i < count; i++) {
+        status = pad_check_actuation(state, atomic_load_explicit(&state->arm_level, memory_order_relaxed), reqs[i].id,
+                                     reqs[i].state);
+        if (status != ACT_OK) {
+            padstate_write_end(state, 0);
+            if (bad != NULL) *bad = i;
+            return status;
+        }
+        needed[state->act_bus[reqs[i].id]]++;
+    }
 
-    if (id == ID_QUICK_DISCONNECT) {
+    /* Buses are always locked in the same order. Either the whole batch fits on its buses or nothing is queued. */
 
-        /* If we disconnected and we're in a state less than ARMED_DISCONNECTED, advance the state */
+    for (b = 0; b < NUM_ACT_BUSES; b++) {
+        actqueue_lock(&state->buses[b]);
+    }
 
-        if (req_state && padstate_get_level(state) < ARMED_DISCONNECTED) {
-            padstate_change_level(state, ARMED_DISCONNECTED);
+    for (i = 0; i < count && status == ACT_OK; i++) {
+        b = state->act_bus[reqs[i].id];
+        if (needed[b] > actqueue_space(&state->buses[b])) {
+            hwarn("Too many actuations queued on the %s bus\n", state->buses[b].name);
+            if (bad != NULL) *bad = i;
+            status = ACT_BUSY;
         }
+    }
 
-        /* If we re-connected, move back a level prior */
+    for (i = 0; i < count && status == ACT_OK; i++) {
+        actqueue_push(&state->buses[state->act_bus[reqs[i].id]], &state->actuators[reqs[i].id], reqs[i].state,
+                      reqs[i].id == ID_DUMP, done != NULL ? &done[i] : NULL);
+    }
 
-        if (!req_state) {
-            padstate_change_level(state, ARMED_IGNITION);
-        }
+    for (b = NUM_ACT_BUSES - 1; b >= 0; b--) {
+        actqueue_unlock(&state->buses[b]);
+    }
 
-    } else if (id == ID_IGNITER) {
+    /* Subscribers hear about each actuation from its bus's worker once it is carried out */
 
-        /* If we ignited and we're in a state less than ARMED_LAUNCH, advance the state */
+    padstate_write_end(state, 0);
+    return status;
+}
 
-        if (req_state && padstate_get_level(state) < ARMED_LAUNCH) {
-            padstate_change_level(state, ARMED_LAUNCH);
-        }
+/*
+ * Set the values of several actuators as one unit, see `pad_queue_multi`.
+ * @param state The pad state
+ * @param reqs The actuations to perform, in order
+ * @param count The number of actuations in `reqs`, at most MULTI_ACT_MAX
+ * @param bad Set to the index of the actuation which caused the batch to be refused or to fail. May be NULL.
+ * @param wait True to wait until every actuation has been carried out, false to return once they are queued
+ * @return ACT_OK for success, ACT_DNE for an invalid id, ACT_INV for an invalid req_state, ACT_DENIED if the arming
+ * level does not permit one of the actuations, ACT_BUSY if a bus has too many actuations queued, -1 for errors with
+ * errno being set (including failed or pre-empted actuations when waiting)
+ */
+int pad_actuate_multi(padstate_t *state, const act_cmd_p *reqs, uint8_t count, uint8_t *bad, bool wait) {
+    actqueue_done_t done[MULTI_ACT_MAX];
+    uint8_t i;
+    int result;
+    int err;
+
+    result = pad_queue_multi(state, reqs, count, bad, wait ? done : NULL);
+    if (result != ACT_OK || !wait) {
+        return result;
+    }
 
-        /* If we un-ignited, move back a level prior */
+    /* Every outcome must be collected, since the workers write them here */
 
-        if (!req_state) {
-            padstate_change_level(state, ARMED_DISCONNECTED);
+    err = 0;
+    for (i = 0; i < count; i++) {
+        result = actqueue_wait(&state->buses[state->act_bus[reqs[i].id]], &done[i]);
+        if (result && !err) {
+            if (bad != NULL) *bad = i;
+            err = result;
         }
     }
 
-    padstate_signal_update(state);
+    if (err) {
+        errno = err;
+        return -1;
+    }
     return ACT_OK;
 }
+
+/*
+ * Set the value of an actuator with the required progression
+ * @param id The actuator id
+ * @param req_state The new actuator state
+ * @param done Where to report the outcome, which must stay valid until it is collected with `pad_actuate_wait`. NULL
+ * to return once the actuation is queued without collecting its outcome.
+ * @return ACT_OK for success, ACT_DNE for invalid id, ACT_INV for invalid req_state, ACT_BUSY if the actuator's bus
+ * has too many actuations queued, -1 for errors with errno being set
+ */
+int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state, actqueue_done_t *done) {
+    act_cmd_p req = {.id = id, .state = req_state};
+    return pad_queue_multi(state, &req, 1, NULL, done);
+}
+
+/*
+ * Wait for an actuation queued by `pad_actuate` to be carried out.
+ * @param state The pad state
+ * @param id The actuator id
+ * @param done The outcome passed to `pad_actuate`
+ * @return 0 on success, ECANCELED if the actuation was pre-empted, errno code if it failed.
+ */
+int pad_actuate_wait(padstate_t *state, uint8_t id, actqueue_done_t *done) {
+    return actqueue_wait(&state->buses[state->act_bus[id]], done);
+}
@@ -1,11 +1,14 @@
 #ifndef _STATE_H_
 #define _STATE_H_
+#include "actqueue.h"
 #include "actuator.h"
 #define MAX_READERS 255 // random number, feel free to change
 
 #include "../../packets/packet.h"
+#include "notify.h"
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
 /* Number of actuators in the system:
@@ -17,24 +20,80 @@
 
 #define NUM_ACTUATORS (12 + 1 + 1 + 1)
 
+/* Buses the actuators are driven over. Each has its own worker, so actuators on one never wait on the other. */
+
+typedef enum {
+    ACT_BUS_GPIO = 0, /* Solenoid valves and the igniter */
+    ACT_BUS_PWM = 1,  /* Servos: the quick disconnect and the dump valve */
+    NUM_ACT_BUSES,
+} act_bus_e;
+
+/* Number of times a snapshot is attempted while writers keep the pad state busy, before waiting for them */
+
+#define PADSTATE_SNAPSHOT_RETRIES 16
+
+/* Number of actuation outcomes kept for subscribers which have not read them yet, see `padstate_read_done` */
+
+#define PADSTATE_DONE_LEN 32
+
+/* Maximum number of consumers subscribed to pad state changes */
+
+#define PADSTATE_MAX_SUBS 4
+
+/* Bits of a pad state change mask. The bits below `NUM_ACTUATORS` are the actuators, see `ACT_BIT`. */
+
+#define PADSTATE_CHANGED_DONE ((uint32_t)1 << 28) /* An actuation was carried out or dropped */
+#define PADSTATE_CHANGED_SEQ ((uint32_t)1 << 29)  /* An actuation sequence step was carried out */
+#define PADSTATE_CHANGED_ARM ((uint32_t)1 << 30)  /* The arming level changed */
+#define PADSTATE_CHANGED_CONN ((uint32_t)1 << 31) /* The connection status changed */
+#define PADSTATE_CHANGED_ALL ((ACT_BIT(NUM_ACTUATORS) - 1) | PADSTATE_CHANGED_ARM | PADSTATE_CHANGED_CONN)
+
+_Static_assert(NUM_ACTUATORS <= 28, "Actuator states must fit in a change mask beside the other change bits");
+
+/* Outcome of an actuation which a bus's worker carried out or dropped */
+typedef struct {
+    uint8_t id;                /* The actuator */
+    bool state;                /* The state the actuator was to be put in */
+    int err;                   /* 0 on success, errno code on failure, ECANCELED if it was pre-empted */
+    struct timespec completed; /* When the outcome was known, measured on CLOCK_MONOTONIC */
+} padstate_done_t;
+
 /* State of the entire pad control system */
 typedef struct {
     actuator_t actuators[NUM_ACTUATORS];
+    _Atomic arm_lvl_e arm_level;             /* Arming level, only stored while holding `write_mut` */
+    _Atomic conn_status_e conn_status;       /* Connection status, only stored while holding `write_mut` */
+    _Atomic uint32_t act_states;             /* Bitmask of actuator states, only stored while holding `write_mut` */
+    atomic_uint seq;                         /* Seqlock count over the fields above, odd while they are being written */
+    pthread_mutex_t write_mut;               /* Serializes writers of the seqlock, readers never take it */
+    padstate_done_t done[PADSTATE_DONE_LEN]; /* Latest actuation outcomes, only accessed holding `write_mut` */
+    uint32_t ndone;                          /* Number of outcomes ever recorded, likewise */
+    pthread_mutex_t subs_mut;                /* Protects the list of subscribers */
+    notify_t *subs[PADSTATE_MAX_SUBS];       /* Consumers notified of pad state changes */
+    uint8_t act_bus[NUM_ACTUATORS];          /* The bus of each actuator, see `act_bus_e` */
+    actqueue_t buses[NUM_ACT_BUSES];         /* Actuations queued on each bus */
+} padstate_t;
+
+/* Consistent copy of the pad state, as seen at a single point in time */
+typedef struct {
     arm_lvl_e arm_level;
     conn_status_e conn_status;
-    pthread_rwlock_t rw_lock;
-    pthread_mutex_t update_mut;
-    pthread_cond_t update_cond;
-    bool update_recorded;
-} padstate_t;
+    uint32_t act_states; /* Bitmask of actuator states, see `ACT_BIT` */
+} padstate_snapshot_t;
 
-void padstate_init(padstate_t *state);
+int padstate_init(padstate_t *state);
+void padstate_snapshot(padstate_t *state, padstate_snapshot_t *snap);
 arm_lvl_e padstate_get_level(padstate_t *state);
 conn_status_e padstate_get_connstatus(padstate_t *state);
 int padstate_set_connstatus(padstate_t *state, conn_status_e new_status);
 int padstate_get_actstate(padstate_t *state, uint8_t act_id, bool *act_val);
-int padstate_signal_update(padstate_t *state);
+int padstate_subscribe(padstate_t *state, notify_t *sub);
+void padstate_unsubscribe(padstate_t *state, notify_t *sub);
+void padstate_notify(padstate_t *state, uint32_t changes);
+int padstate_read_done(padstate_t *state, uint32_t *next, padstate_done_t *done);
 int padstate_change_level(padstate_t *state, arm_lvl_e new_arm);
-int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state);
+int pad_actuate(padstate_t *state, uint8_t id, uint8_t req_state, actqueue_done_t *done);
+int pad_actuate_wait(padstate_t *state, uint8_t id, actqueue_done_t *done);
+int pad_actuate_multi(padstate_t *state, const act_cmd_p *reqs, uint8_t count, uint8_t *bad, bool wait);
 
 #endif // _STATE_H_
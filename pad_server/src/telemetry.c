@@ -13,6 +13,7 @@
 
 #if !defined(DESKTOP_BUILD)
 #include <nuttx/analog/ads1115.h>
+#include <semaphore.h>
 #endif
 
 #if defined(DESKTOP_BUILD) || defined(CONFIG_HYSIM_PAD_SERVER_MOCK_DATA)
@@ -21,6 +22,10 @@
 
 #include "../../debugging/logging.h"
 #include "../../debugging/nxassert.h"
+#include "../../ringbuf/ringbuf.h"
+#include "batch.h"
+#include "deadline.h"
+#include "replay.h"
 #include "sensors.h"
 #include "state.h"
 #include "telemetry.h"
@@ -61,7 +66,44 @@ static int telemetry_init(telemetry_sock_t *sock, uint16_t port, char *addr) {
     sock->addr.sin_addr.s_addr = inet_addr(addr);
     sock->addr.sin_port = htons(port);
 
-    return 0;
+    /* Bind to an ephemeral port right away so that clients can send keyframe requests back to where telemetry comes
+     * from. */
+
+    struct sockaddr_in local = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY), .sin_port = 0};
+    if (bind(sock->sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        herr("Failed to bind telemetry UDP socket\n");
+        close(sock->sock);
+        return errno;
+    }
+
+    atomic_init(&sock->seq, 0);
+
+    return pthread_mutex_init(&sock->lock, NULL);
+}
+
+/*
+ * Lock the telemetry socket to number and send frames. Receivers count frames missing from the sequence numbers as
+ * lost and frames behind them as reordered, so frames must leave in the order they were numbered even though several
+ * threads publish on the socket.
+ * @param sock The telemetry socket.
+ * @param cancel_state Output for the thread's cancellation state, to pass to `telemetry_sock_unlock`.
+ */
+void telemetry_sock_lock(telemetry_sock_t *sock, int *cancel_state) {
+
+    /* Sending is a cancellation point, and the lock must not be left held by a cancelled thread */
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, cancel_state);
+    pthread_mutex_lock(&sock->lock);
+}
+
+/*
+ * Unlock the telemetry socket.
+ * @param sock The telemetry socket.
+ * @param cancel_state The thread's cancellation state returned by `telemetry_sock_lock`.
+ */
+void telemetry_sock_unlock(telemetry_sock_t *sock, int cancel_state) {
+    pthread_mutex_unlock(&sock->lock);
+    pthread_setcancelstate(cancel_state, NULL);
 }
 
 /*
@@ -78,18 +120,36 @@ static int telemetry_close(telemetry_sock_t *sock) {
 }
 
 /*
- * Publish a telemetry message to all listeners.
+ * Publish a telemetry frame to all listeners.
  * @param sock The telemetry socket on which to publish.
- * @param msg The message to send.
+ * @param msg The message to send. The first I/O vector is reserved for the frame header, which is filled in here. The
+ * remaining I/O vectors must be pairs of packet header and body, one pair per record.
  * @return 0 for success, error code on failure.
  */
 static int telemetry_publish(telemetry_sock_t *sock, struct msghdr *msg) {
+    telem_frame_p frame;
+    size_t len = 0;
+    int cancel_state;
+    int err = 0;
+
+    assert(msg->msg_iovlen >= 1 && msg->msg_iovlen % 2 == 1);
+
+    for (size_t i = 1; i < (size_t)msg->msg_iovlen; i++) {
+        len += msg->msg_iov[i].iov_len;
+    }
+    nxassert(sizeof(frame) + len <= TELEM_FRAME_MAX);
+
+    msg->msg_iov[0] = (struct iovec){.iov_base = &frame, .iov_len = sizeof(frame)};
     msg->msg_name = &sock->addr;
     msg->msg_namelen = sizeof(sock->addr);
+
+    telemetry_sock_lock(sock, &cancel_state);
+    packet_telem_frame_init(&frame, atomic_fetch_add(&sock->seq, 1), msg->msg_iovlen / 2, len);
     if (sendmsg(sock->sock, msg, MSG_NOSIGNAL) < 0) {
-        return errno;
+        err = errno;
     }
-    return 0;
+    telemetry_sock_unlock(sock, cancel_state);
+    return err;
 }
 
 /*
@@ -99,6 +159,16 @@ static int telemetry_publish(telemetry_sock_t *sock, struct msghdr *msg) {
  */
 static void telemetry_cleanup(void *arg) { telemetry_close((telemetry_sock_t *)(arg)); }
 
+/*
+ * pthread cleanup handler for the pad state subscription of the telemetry pad state thread.
+ * @param arg A pointer to the pad state thread's arguments.
+ */
+static void telemetry_unsubscribe(void *arg) {
+    telemetry_padstate_args_t *args = (telemetry_padstate_args_t *)arg;
+    padstate_unsubscribe(args->state, &args->changes);
+    notify_close(&args->changes);
+}
+
 static void telemetry_cancel_padstate_thread(void *arg) {
     pthread_t telemetry_padstate_thread = *(pthread_t *)arg;
     pthread_cancel(telemetry_padstate_thread);
@@ -106,24 +176,80 @@ static void telemetry_cancel_padstate_thread(void *arg) {
     herr("Telemetry pad state thread terminated\n");
 }
 
+static void telemetry_cancel_keyframe_thread(void *arg) {
+    pthread_t keyframe_thread = *(pthread_t *)arg;
+    pthread_cancel(keyframe_thread);
+    pthread_join(keyframe_thread, NULL);
+    herr("Telemetry keyframe request thread terminated\n");
+}
+
+#ifndef DESKTOP_BUILD
+static void telemetry_cancel_sensor_thread(void *arg) {
+    pthread_t sensor_thread = *(pthread_t *)arg;
+    pthread_cancel(sensor_thread);
+    pthread_join(sensor_thread, NULL);
+    herr("Sensor acquisition thread terminated\n");
+}
+#endif
+
+/*
+ * Queue a single measurement as a telemetry record.
+ * @param batch The telemetry batch to queue the record in
+ * @param subtype The telemetry subtype of the measurement
+ * @param id The sensor ID, ignored for continuity
+ * @param time The time stamp of the measurement in milliseconds
+ * @param value The measurement value
+ * @param acquired When the measurement was taken on CLOCK_MONOTONIC, for its latency trace. NULL if it is only taken
+ * as it is queued, as for replayed data.
+ */
+static void telemetry_batch_measurement(telemetry_batch_t *batch, uint8_t subtype, uint8_t id, uint32_t time,
+                                        int32_t value, const struct timespec *acquired) {
+    switch ((telem_subtype_e)subtype) {
+    case TELEM_PRESSURE: {
+        pressure_p body;
+        packet_pressure_init(&body, id, time, value);
+        telemetry_batch_add(batch, TELEM_PRESSURE, &body, sizeof(body), acquired);
+    } break;
+    case TELEM_MASS: {
+        mass_p body;
+        packet_mass_init(&body, id, time, value);
+        telemetry_batch_add(batch, TELEM_MASS, &body, sizeof(body), acquired);
+    } break;
+    case TELEM_TEMP: {
+        temp_p body;
+        packet_temp_init(&body, id, time, value);
+        telemetry_batch_add(batch, TELEM_TEMP, &body, sizeof(body), acquired);
+    } break;
+    case TELEM_THRUST: {
+        thrust_p body;
+        packet_thrust_init(&body, id, time, value);
+        telemetry_batch_add(batch, TELEM_THRUST, &body, sizeof(body), acquired);
+    } break;
+    case TELEM_CONT: {
+        continuity_state_p body;
+        packet_continuity_state_init(&body, time, value ? CONTINUITY_HIGH : CONTINUITY_LOW);
+        telemetry_batch_add(batch, TELEM_CONT, &body, sizeof(body), acquired);
+    } break;
+    default:
+        herr("Invalid telemetry data type: %u\n", subtype);
+        break;
+    }
+}
+
 #if defined(DESKTOP_BUILD) || defined(CONFIG_HYSIM_PAD_SERVER_MOCK_DATA)
-/* A function to create random data if not put in any file to read from
- * @params telem The telemetry socket to send random data over
+/* A function to create random data if not put in any file to read from. Records are paced against absolute deadlines
+ * one period apart, so time spent publishing does not accumulate as drift.
+ * @params batch The telemetry batch to queue random data in
+ * @params rate The rate in Hz at which to generate data
  */
-static void random_data(telemetry_sock_t *telem) {
-    struct iovec pkt[2];
-    struct msghdr msg = {
-        .msg_iov = pkt,
-        .msg_iovlen = sizeof(pkt) / sizeof(pkt[0]),
-    };
-    header_p hdr;
+static void random_data(telemetry_batch_t *batch, uint32_t rate) {
     struct timespec time;
+    struct timespec deadline;
     uint32_t time_ms;
+    uint32_t period_us = 1000000 / rate;
+    int64_t wait_us;
 
-    /* Set up the header info for every message */
-
-    pkt[0].iov_base = &hdr;
-    pkt[0].iov_len = sizeof(hdr);
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
 
     for (;;) {
 
@@ -134,28 +260,133 @@ static void random_data(telemetry_sock_t *telem) {
 
         /* Send pressure transducer data for transducers 0 through 5 */
 
-        hdr.type = TYPE_TELEM;
-        hdr.subtype = TELEM_PRESSURE;
-
         pressure_p pressure;
         for (int i = 0; i < 6; i++) {
             packet_pressure_init(&pressure, i, time_ms, (uint32_t)(1000 * (rand() / RAND_MAX)));
-            pkt[1].iov_base = &pressure;
-            pkt[1].iov_len = sizeof(pressure);
-            telemetry_publish(telem, &msg);
+            telemetry_batch_add(batch, TELEM_PRESSURE, &pressure, sizeof(pressure), &time);
         }
 
         /* Send single continuity measurement */
 
-        hdr.subtype = TELEM_CONT;
         continuity_state_p cont;
         packet_continuity_state_init(&cont, time_ms, rand() % 2);
+        telemetry_batch_add(batch, TELEM_CONT, &cont, sizeof(cont), &time);
+
+        /* Wait for the next period. After falling more than a period behind, start over from now rather than sending
+         * the missed records in a burst. */
+
+        deadline_add_us(&deadline, period_us);
+        wait_us = deadline_remaining_us(&deadline);
+        if (wait_us < -(int64_t)period_us) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            wait_us = 0;
+        }
+
+        telemetry_batch_idle(batch, wait_us > 0 ? wait_us : 0);
+        if (wait_us > 0) deadline_sleep(&deadline);
+    }
+}
 
-        pkt[1].iov_base = &cont;
-        pkt[1].iov_len = sizeof(cont);
-        telemetry_publish(telem, &msg);
+/*
+ * pthread cleanup handler for recorded data.
+ * @param arg A pointer to the replay to close.
+ */
+static void replay_cleanup(void *arg) { replay_close((replay_t *)(arg)); }
 
-        usleep(100000); /* 100ms sleep */
+/*
+ * Queue the telemetry for every data column of a recorded row.
+ * @param batch The telemetry batch to queue the records in
+ * @param replay The recorded data
+ * @param row The row to queue
+ */
+static void replay_row(telemetry_batch_t *batch, const replay_t *replay, uint32_t row) {
+    for (uint32_t c = 0; c < replay->hdr->ncolumns; c++) {
+        const replay_column_t *col = &replay->columns[c];
+        telemetry_batch_measurement(batch, col->subtype, col->id, replay->time[row], replay->values[c][row], NULL);
+    }
+}
+
+/*
+ * Get the nominal time between rows of a looped region, which also separates the last row of one pass from the first
+ * row of the next.
+ * @param replay The recorded data
+ * @param start_row The first row of the region
+ * @param end_row The row after the last row of the region
+ * @return The mean time between the rows of the region in milliseconds, or of the whole recording if the region holds
+ * a single row. Never less than 1 ms, so that a loop cannot spin.
+ */
+static double replay_loop_gap_ms(const replay_t *replay, uint32_t start_row, uint32_t end_row) {
+    double gap = 0;
+
+    if (end_row - start_row > 1) {
+        gap = (double)(replay->time[end_row - 1] - replay->time[start_row]) / (end_row - 1 - start_row);
+    } else if (replay->hdr->nrows > 1) {
+        gap = (double)(replay->time[replay->hdr->nrows - 1] - replay->time[0]) / (replay->hdr->nrows - 1);
+    }
+    return gap < 1 ? 1 : gap;
+}
+
+/*
+ * Replay recorded data, pacing every row by its recorded time stamp scaled by the playback speed. Rows are paced
+ * against absolute deadlines from the start of each pass through the looped region, so time spent publishing does not
+ * accumulate as drift. Each pass starts one nominal row period after the last row of the previous one.
+ * @param batch The telemetry batch to queue the recorded data in
+ * @param replay The recorded data
+ * @param opts The playback options
+ */
+static void replay_data(telemetry_batch_t *batch, const replay_t *replay, const replay_opts_t *opts) {
+    uint32_t first = replay->time[0];
+    uint32_t start_row = replay_seek(replay, first + opts->loop_start_ms);
+    uint32_t end_row = opts->loop_end_ms ? replay_seek(replay, first + opts->loop_end_ms) : replay->hdr->nrows;
+    uint32_t row = replay_seek(replay, first + opts->seek_ms);
+    uint64_t loop_gap_us;
+    struct timespec pass_start;
+    struct timespec deadline;
+    uint32_t pass_time;
+    int64_t wait_us;
+
+    if (start_row >= end_row) {
+        fprintf(stderr, "Replay loop region %u-%u ms contains no recorded data\n", opts->loop_start_ms,
+                opts->loop_end_ms);
+        thread_return(EINVAL);
+    }
+
+    if (row < start_row || row >= end_row) {
+        hwarn("Seek offset %u ms is outside of the loop region, starting from the loop region instead\n",
+              opts->seek_ms);
+        row = start_row;
+    }
+
+    loop_gap_us = opts->speed > 0 ? (uint64_t)(replay_loop_gap_ms(replay, start_row, end_row) * 1000 / opts->speed) : 0;
+    clock_gettime(CLOCK_MONOTONIC, &pass_start);
+    deadline = pass_start;
+    pass_time = replay->time[row];
+
+    for (;;) {
+
+        /* Wait until the row is due, unless playing back as fast as possible */
+
+        if (opts->speed > 0) {
+            deadline = pass_start;
+            deadline_add_us(&deadline, (uint64_t)((double)(replay->time[row] - pass_time) * 1000 / opts->speed));
+
+            wait_us = deadline_remaining_us(&deadline);
+            if (wait_us > 0) {
+                telemetry_batch_idle(batch, wait_us);
+                deadline_sleep(&deadline);
+            }
+        }
+
+        replay_row(batch, replay, row);
+
+        /* At the end of the loop region, start another pass one row period after this one left off */
+
+        if (++row == end_row) {
+            row = start_row;
+            pass_start = deadline;
+            deadline_add_us(&pass_start, loop_gap_us);
+            pass_time = replay->time[row];
+        }
     }
 }
 
@@ -165,79 +396,88 @@ static void random_data(telemetry_sock_t *telem) {
  * @param telem The telemetry socket to output data on
  */
 static void mock_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
-    int err = 0;
-    char buffer[BUFSIZ];
+    int err;
+    replay_t replay;
+    static telemetry_batch_t batch; /* Static, since it is too large for the stack on NuttX */
+
+    telemetry_batch_init(&batch, telem, TELEMETRY_BATCH_DELAY_US, args->trace);
 
     /* NULL telemetry file means generate random data */
 
     if (args->data_file == NULL) {
-        random_data(telem);
+        random_data(&batch, args->mock_rate);
     } else {
 
-        /* Open telemetry file */
-        FILE *data = fopen(args->data_file, "r");
-        if (data == NULL) {
-            fprintf(stderr, "Could not open telemetry file \"%s\" with error: %s\n", args->data_file, strerror(errno));
+        /* Open telemetry file, which is either parsed up front or memory mapped */
+
+        err = replay_open(&replay, args->data_file);
+        if (err) {
+            fprintf(stderr, "Could not open telemetry file \"%s\" with error: %s\n", args->data_file, strerror(err));
             thread_return(err);
         }
+        pthread_cleanup_push(replay_cleanup, &replay);
 
-        /* Start transmitting telemetry to active clients */
-        for (;;) {
-
-            /* Handle file errors */
-            if (ferror(data)) {
-                fprintf(stderr, "Error reading telemetry file: %s\n", strerror(errno));
-                thread_return(err);
-            }
-
-            /* Read from file in a loop */
-            if (feof(data)) {
-                rewind(data);
-            }
+        /* Start transmitting telemetry to active clients, replaying the file in a loop */
 
-            /* Read next line */
-            if (fgets(buffer, sizeof(buffer), data) == NULL) {
-                continue;
-            }
+        replay_data(&batch, &replay, &args->replay_opts);
 
-            /* TODO: parse all data */
-
-            char *rest = buffer;
-            char *time_str = strtok_r(rest, ",", &rest);
-            uint32_t time = strtoul(time_str, NULL, 10);
-            char *pstr = strtok_r(rest, ",", &rest);
-            uint32_t pressure = strtoul(pstr, NULL, 10);
-
-            header_p hdr = {.type = TYPE_TELEM, .subtype = TELEM_PRESSURE};
-            pressure_p body = {.id = 1, .time = time, .pressure = pressure};
-
-            struct iovec pkt[2] = {
-                {.iov_base = &hdr, .iov_len = sizeof(hdr)},
-                {.iov_base = &body, .iov_len = sizeof(body)},
-            };
-            struct msghdr msg = {
-                .msg_iov = pkt,
-                .msg_iovlen = (sizeof(pkt) / sizeof(struct iovec)),
-            };
-            telemetry_publish(telem, &msg);
-            usleep(1000000);
-        }
+        pthread_cleanup_pop(1);
     }
 }
 #endif
 
 #ifndef DESKTOP_BUILD
+
+/* Number of samples the acquisition thread can queue ahead of the publisher, must be a power of 2 */
+
+#define SENSOR_QUEUE_LEN 256
+
+/* Priority of the sensor acquisition thread, above the telemetry thread which publishes its samples */
+
+#define SENSOR_THREAD_PRIORITY 150
+
+/* A single sensor measurement, as queued by the acquisition thread for publishing */
+
+typedef struct {
+    uint32_t time;   /* Time stamp of the measurement in milliseconds */
+    int32_t value;   /* Converted measurement value */
+    uint8_t subtype; /* Telemetry subtype of the measurement */
+    uint8_t id;      /* Sensor ID */
+} sensor_sample_t;
+
+/* Queue of samples handed from the acquisition thread to the publisher */
+
+typedef struct {
+    ringbuf_t ring;                            /* Queued samples */
+    sensor_sample_t samples[SENSOR_QUEUE_LEN]; /* Storage for the ring */
+    sem_t ready;                               /* Posted after each scan of the sensors */
+} sensor_queue_t;
+
 /*
- * Thread logic responsible for reading data from sensors and publishing the data as telemetry.
+ * Queue a sensor measurement for publishing. When the publisher falls behind and the queue is full the sample is
+ * dropped; it is counted by the queue and reported by the publisher.
+ * @param queue The sample queue
+ * @param subtype The telemetry subtype of the measurement
+ * @param id The sensor ID
+ * @param time The time stamp of the measurement in milliseconds
+ * @param value The measurement value
+ */
+static void sensor_queue_push(sensor_queue_t *queue, uint8_t subtype, uint8_t id, uint32_t time, int32_t value) {
+    sensor_sample_t sample = {.time = time, .value = value, .subtype = subtype, .id = id};
+    ringbuf_push(&queue->ring, &sample);
+}
+
+/*
+ * Thread logic responsible for reading data from sensors and queuing it for publishing. This thread never touches the
+ * network, so a slow send can not delay the next conversion.
  * NOTE: only works on NuttX builds
- * @param args The telemetry thread arguments
- * @param telem The telemetry socket to output data on
+ * @param arg The queue to push samples to, of type `sensor_queue_t`
  */
-static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
+static void *sensor_acquire(void *arg) {
+    sensor_queue_t *queue = (sensor_queue_t *)arg;
     int err;
 
-    assert(args != NULL);
-    assert(telem != NULL);
+    assert(queue != NULL);
 
 #if defined(CONFIG_SENSORS_NAU7802)
     sensor_mass_t sensor_mass = {
@@ -338,21 +578,8 @@ static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
 #endif
 
     for (;;) {
-        struct iovec pkt[(32) * 2]; /* 32 possible measurements, headers and bodies */
-        int sensor_count = 0;
         struct timespec time_t;
         uint32_t time_ms;
-        header_p headers[32];
-
-        /* All possible sensor bodies */
-
-        union {
-            pressure_p pressure;
-            mass_p mass;
-            temp_p temp;
-            thrust_p thrust;
-            continuity_state_p continuity;
-        } bodies[32];
 
 #if defined(CONFIG_ADC_ADS1115)
         struct adc_msg_s sample;
@@ -422,46 +649,7 @@ static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
                     continue;
                 }
 
-                /* Put the converted value in the packet */
-
-                headers[sensor_count] = (header_p){.type = TYPE_TELEM, .subtype = channel->type};
-                pkt[sensor_count * 2] = (struct iovec){
-                    .iov_base = &headers[sensor_count],
-                    .iov_len = sizeof(headers[sensor_count]),
-                };
-
-                switch (channel->type) {
-                case TELEM_PRESSURE:
-                    bodies[sensor_count].pressure =
-                        (pressure_p){.time = time_ms, .id = channel->sensor_id, .pressure = sensor_val};
-                    pkt[sensor_count * 2 + 1] =
-                        (struct iovec){.iov_base = &bodies[sensor_count].pressure, .iov_len = sizeof(pressure_p)};
-                    sensor_count++;
-                    break;
-                case TELEM_TEMP:
-                    bodies[sensor_count].temp =
-                        (temp_p){.time = time_ms, .id = channel->sensor_id, .temperature = sensor_val};
-                    pkt[sensor_count * 2 + 1] =
-                        (struct iovec){.iov_base = &bodies[sensor_count].temp, .iov_len = sizeof(temp_p)};
-                    sensor_count++;
-                    break;
-                case TELEM_THRUST:
-                    bodies[sensor_count].thrust =
-                        (thrust_p){.time = time_ms, .id = channel->sensor_id, .thrust = sensor_val};
-                    pkt[sensor_count * 2 + 1] =
-                        (struct iovec){.iov_base = &bodies[sensor_count].thrust, .iov_len = sizeof(thrust_p)};
-                    sensor_count++;
-                    break;
-                case TELEM_CONT:
-                    bodies[sensor_count].continuity = (continuity_state_p){.time = time_ms, .state = sensor_val};
-                    pkt[sensor_count * 2 + 1] = (struct iovec){.iov_base = &bodies[sensor_count].continuity,
-                                                               .iov_len = sizeof(continuity_state_p)};
-                    sensor_count++;
-                    break;
-                default:
-                    herr("Invalid telemetry data type: %u\n", channel->type);
-                    break;
-                }
+                sensor_queue_push(queue, channel->type, channel->sensor_id, time_ms, sensor_val);
             }
         }
 #endif
@@ -472,19 +660,11 @@ static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
             if (err < 0) {
                 herr("Error fetching mass data: %d\n", err);
             } else {
-                headers[sensor_count] = (header_p){.type = TYPE_TELEM, .subtype = TELEM_MASS};
-
                 float slope = (float)sensor_mass.known_mass_grams /
                               (float)(sensor_mass.known_mass_point - sensor_mass.zero_point);
                 int32_t output = (int32_t)((sensor_mass.data.force - sensor_mass.zero_point) * slope);
                 time_ms = sensor_mass.data.timestamp / 1000;
-                bodies[sensor_count].mass = (mass_p){.time = time_ms, .id = 0, .mass = output};
-                pkt[sensor_count * 2] =
-                    (struct iovec){.iov_base = &headers[sensor_count], .iov_len = sizeof(headers[sensor_count])};
-                pkt[sensor_count * 2 + 1] =
-                    (struct iovec){.iov_base = &bodies[sensor_count].mass, .iov_len = sizeof(mass_p)};
-
-                sensor_count++;
+                sensor_queue_push(queue, TELEM_MASS, 0, time_ms, output);
             }
         }
 #endif
@@ -501,34 +681,86 @@ static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
                 }
 
                 time_ms = sensor_temp[i].data.timestamp / 1000;
-                headers[sensor_count] = (header_p){.type = TYPE_TELEM, .subtype = TELEM_TEMP};
-                bodies[sensor_count].temp = (temp_p){
-                    .time = time_ms,
-                    .id = sensor_temp[i].sensor_id,
-                    .temperature = sensor_temp[i].data.temperature * 1000,
-                };
-                pkt[sensor_count * 2] = (struct iovec){
-                    .iov_base = &headers[sensor_count],
-                    .iov_len = sizeof(headers[sensor_count]),
-                };
-                pkt[sensor_count * 2 + 1] = (struct iovec){
-                    .iov_base = &bodies[sensor_count].temp,
-                    .iov_len = sizeof(temp_p),
-                };
-                sensor_count++;
+                sensor_queue_push(queue, TELEM_TEMP, sensor_temp[i].sensor_id, time_ms,
+                                  sensor_temp[i].data.temperature * 1000);
             }
         }
 #endif
 
-        /* Send the telemetry that was collected */
+        /* Wake the publisher once per scan so the samples of a scan go out together */
 
-        if (sensor_count > 0) {
-            struct msghdr msg = {.msg_iov = pkt, .msg_iovlen = sensor_count * 2};
-            telemetry_publish(telem, &msg);
-        } else {
-            herr("No sensor data to send\n");
+        sem_post(&queue->ready);
+    }
+
+    return NULL;
+}
+
+/*
+ * Thread logic responsible for publishing the data read from sensors as telemetry. Acquisition runs in its own,
+ * higher priority thread; this thread drains whatever it has queued in batches and sends it.
+ * NOTE: only works on NuttX builds
+ * @param args The telemetry thread arguments
+ * @param telem The telemetry socket to output data on
+ */
+static void sensor_telemetry(telemetry_args_t *args, telemetry_sock_t *telem) {
+    static sensor_queue_t queue;
+    static telemetry_batch_t batch;
+    sensor_sample_t samples[32];
+    struct timespec acquired;
+    unsigned long dropped = 0;
+    pthread_t acquire_thread;
+    size_t queued;
+    size_t count;
+    int err;
+
+    assert(args != NULL);
+    assert(telem != NULL);
+
+    err = ringbuf_init(&queue.ring, queue.samples, sizeof(queue.samples[0]), SENSOR_QUEUE_LEN);
+    nxassert(err == 0);
+    sem_init(&queue.ready, 0, 0);
+    telemetry_batch_init(&batch, telem, TELEMETRY_BATCH_DELAY_US, args->trace);
+
+    err = pthread_create(&acquire_thread, NULL, sensor_acquire, &queue);
+    if (err) {
+        herr("Could not start sensor acquisition thread: %s\n", strerror(err));
+        return;
+    }
+    pthread_cleanup_push(telemetry_cancel_sensor_thread, &acquire_thread);
+
+    err = pthread_setschedprio(acquire_thread, SENSOR_THREAD_PRIORITY);
+    if (err) {
+        herr("Could not set sensor acquisition thread priority: %s\n", strerror(err));
+    }
+
+    for (;;) {
+        sem_wait(&queue.ready);
+
+        /* Drain everything queued so far, including scans that completed while this thread was sending */
+
+        queued = 0;
+        while ((count = ringbuf_pull(&queue.ring, samples, arr_len(samples))) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                acquired.tv_sec = samples[i].time / 1000;
+                acquired.tv_nsec = (samples[i].time % 1000) * 1000000;
+                telemetry_batch_measurement(&batch, samples[i].subtype, samples[i].id, samples[i].time,
+                                            samples[i].value, &acquired);
+            }
+            queued += count;
+        }
+
+        /* Scans drained by an earlier wake-up still post the semaphore, so waking to an empty ring is expected */
+
+        if (queued == 0) continue;
+        telemetry_batch_flush(&batch);
+
+        if (ringbuf_dropped(&queue.ring) != dropped) {
+            dropped = ringbuf_dropped(&queue.ring);
+            herr("Sensor queue full, %lu samples dropped in total\n", dropped);
         }
     }
+
+    pthread_cleanup_pop(1);
 }
 #endif
 
@@ -555,7 +787,24 @@ void *telemetry_run(void *arg) {
     /* Start thread to periodically update telemetry stream with the pad state */
 
     pthread_t telemetry_padstate_thread;
-    telemetry_padstate_args_t telemetry_padstate_args = {.sock = &telem, .state = args->state};
+    telemetry_padstate_args_t telemetry_padstate_args = {
+        .sock = &telem,
+        .state = args->state,
+        .sequence = args->sequence,
+        .keyframe_sec = args->keyframe_sec,
+    };
+    err = notify_init(&telemetry_padstate_args.changes);
+    if (err) {
+        herr("Could not create pad state notification: %s\n", strerror(err));
+        thread_return(err);
+    }
+    err = padstate_subscribe(args->state, &telemetry_padstate_args.changes);
+    if (err) {
+        herr("Could not subscribe to pad state changes: %s\n", strerror(err));
+        thread_return(err);
+    }
+    pthread_cleanup_push(telemetry_unsubscribe, &telemetry_padstate_args);
+
     err = pthread_create(&telemetry_padstate_thread, NULL, telemetry_update_padstate, &telemetry_padstate_args);
     if (err) {
         herr("Could not start telemetry padstate sending thread: %s\n", strerror(err));
@@ -563,6 +812,16 @@ void *telemetry_run(void *arg) {
     }
     pthread_cleanup_push(telemetry_cancel_padstate_thread, &telemetry_padstate_thread);
 
+    /* Start thread to listen for keyframe requests from clients */
+
+    pthread_t telemetry_keyframe_thread;
+    err = pthread_create(&telemetry_keyframe_thread, NULL, telemetry_listen_keyframe, &telemetry_padstate_args);
+    if (err) {
+        herr("Could not start telemetry keyframe request thread: %s\n", strerror(err));
+        thread_return(err);
+    }
+    pthread_cleanup_push(telemetry_cancel_keyframe_thread, &telemetry_keyframe_thread);
+
 #ifndef DESKTOP_BUILD
     /* Give the telemetry pad-state thread a higher priority TODO: make this constant between CONTROL and TELEM
      * priorities */
@@ -594,17 +853,23 @@ void *telemetry_run(void *arg) {
 
     pthread_cleanup_pop(1);
     pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
 }
 
 /*
- * Helper function to send the entire padstate over telemetry
+ * Helper function to send the padstate over telemetry. The arming level and connection status are always sent, but
+ * outside of keyframes only the actuators whose state differs from what was last sent are included.
  * @param state the pad state
  * @param sock the telemetry socket
+ * @param sent Bitmask of the actuator states last sent, updated with what is sent now
+ * @param keyframe True to send every actuator state regardless of whether it changed
  */
-void telemetry_send_padstate(padstate_t *state, telemetry_sock_t *sock) {
+void telemetry_send_padstate(padstate_t *state, telemetry_sock_t *sock, uint32_t *sent, bool keyframe) {
 
     assert(state != NULL);
     assert(sock != NULL);
+    assert(sent != NULL);
 
     struct timespec time;
     uint32_t time_ms;
@@ -614,64 +879,99 @@ void telemetry_send_padstate(padstate_t *state, telemetry_sock_t *sock) {
     conn_status_p conn_body;
     header_p headers[NUM_ACTUATORS];
     act_state_p bodies[NUM_ACTUATORS];
-    bool act_state;
+    unsigned int nacts = 0;
+    padstate_snapshot_t snap;
+    uint32_t changed;
 
-    /* One packet per actuator
+    /* At most one packet per actuator
      * + one packet for the arming state
      * + one packet for the connection state.
      *
-     * All multiplied by 2 because there is a header and a body for each.
+     * All multiplied by 2 because there is a header and a body for each, plus the frame header.
      */
 
-    struct iovec pkt[(NUM_ACTUATORS + 2) * 2];
-    struct msghdr msg = {
-        .msg_iov = pkt,
-        .msg_iovlen = (sizeof(pkt) / sizeof(struct iovec)),
-    };
+    struct iovec pkt[1 + (NUM_ACTUATORS + 2) * 2];
+    struct msghdr msg = {.msg_iov = pkt};
 
-    /* Get the current time and convert it to milliseconds */
+    /* Take a consistent copy of the pad state along with the current time in milliseconds */
 
+    padstate_snapshot(state, &snap);
     clock_gettime(CLOCK_MONOTONIC, &time);
     time_ms = time.tv_sec * 1000 + time.tv_nsec / 1000000;
 
     /* Construct packets for arming level and for connection status */
 
     packet_header_init(&arm_hdr, TYPE_TELEM, TELEM_ARM);
-    packet_arm_state_init(&arm_body, time_ms, padstate_get_level(state));
+    packet_arm_state_init(&arm_body, time_ms, snap.arm_level);
     packet_header_init(&conn_hdr, TYPE_TELEM, TELEM_CONN);
-    packet_conn_init(&conn_body, time_ms, padstate_get_connstatus(state));
+    packet_conn_init(&conn_body, time_ms, snap.conn_status);
 
     /* Arming state packet */
 
-    pkt[0] = (struct iovec){.iov_base = &arm_hdr, .iov_len = sizeof(arm_hdr)};
-    pkt[1] = (struct iovec){.iov_base = &arm_body, .iov_len = sizeof(arm_body)};
+    pkt[1] = (struct iovec){.iov_base = &arm_hdr, .iov_len = sizeof(arm_hdr)};
+    pkt[2] = (struct iovec){.iov_base = &arm_body, .iov_len = sizeof(arm_body)};
 
     /* Connection state packet */
 
-    pkt[2] = (struct iovec){.iov_base = &conn_hdr, .iov_len = sizeof(conn_hdr)};
-    pkt[3] = (struct iovec){.iov_base = &conn_body, .iov_len = sizeof(conn_body)};
+    pkt[3] = (struct iovec){.iov_base = &conn_hdr, .iov_len = sizeof(conn_hdr)};
+    pkt[4] = (struct iovec){.iov_base = &conn_body, .iov_len = sizeof(conn_body)};
 
     /* Send actuator updates */
 
+    changed = keyframe ? ACT_BIT(NUM_ACTUATORS) - 1 : snap.act_states ^ *sent;
+    *sent = snap.act_states;
+
     for (int i = 0; i < NUM_ACTUATORS; i++) {
+        if (!(changed & ACT_BIT(i))) continue;
 
         /* Store the data in the arrays */
 
-        packet_header_init(&headers[i], TYPE_TELEM, TELEM_ACT);
-        padstate_get_actstate(state, i, &act_state);
-        packet_act_state_init(&bodies[i], i, time_ms, act_state);
+        packet_header_init(&headers[nacts], TYPE_TELEM, TELEM_ACT);
+        packet_act_state_init(&bodies[nacts], i, time_ms, (snap.act_states & ACT_BIT(i)) != 0);
 
         /* Point to the stored data in the iovecs */
 
-        pkt[4 + (i * 2)] = (struct iovec){.iov_base = &headers[i], .iov_len = sizeof(headers[i])};
-        pkt[4 + (i * 2) + 1] = (struct iovec){.iov_base = &bodies[i], .iov_len = sizeof(bodies[i])};
+        pkt[5 + (nacts * 2)] = (struct iovec){.iov_base = &headers[nacts], .iov_len = sizeof(headers[nacts])};
+        pkt[5 + (nacts * 2) + 1] = (struct iovec){.iov_base = &bodies[nacts], .iov_len = sizeof(bodies[nacts])};
+        nacts++;
+    }
+
+    msg.msg_iovlen = 5 + nacts * 2;
+    telemetry_publish(sock, &msg);
+}
+
+/*
+ * Send the reports of actuation sequence steps carried out since the last call, several to a frame.
+ * @param sequence The actuation sequence
+ * @param sock The telemetry socket
+ */
+void telemetry_send_sequence(sequence_t *sequence, telemetry_sock_t *sock) {
+    header_p headers[SEQUENCE_REPORTS];
+    seq_step_state_p reports[SEQUENCE_REPORTS];
+    struct iovec pkt[1 + SEQUENCE_REPORTS * 2];
+    struct msghdr msg = {.msg_iov = pkt};
+    size_t n;
+
+    _Static_assert(sizeof(telem_frame_p) + SEQUENCE_REPORTS * (sizeof(header_p) + sizeof(seq_step_state_p)) <=
+                       TELEM_FRAME_MAX,
+                   "Every queued sequence report must fit in one frame");
+
+    n = sequence_reports(sequence, reports, SEQUENCE_REPORTS);
+    if (n == 0) return;
+
+    for (size_t i = 0; i < n; i++) {
+        packet_header_init(&headers[i], TYPE_TELEM, TELEM_SEQ_STEP);
+        pkt[1 + i * 2] = (struct iovec){.iov_base = &headers[i], .iov_len = sizeof(headers[i])};
+        pkt[2 + i * 2] = (struct iovec){.iov_base = &reports[i], .iov_len = sizeof(reports[i])};
     }
 
+    msg.msg_iovlen = 1 + n * 2;
     telemetry_publish(sock, &msg);
 }
 
 /*
- * Thread which periodically sends information about the pad's state.
+ * Thread which periodically sends information about the pad's state. Every update carries only the actuators which
+ * changed, with the full state sent as a keyframe on an interval, when a client requests it, and on start-up.
  * @param arg Arguments of type `telemetry_padstate_args_t`
  * @return 0 on success, error code on failure (thread dies)
  */
@@ -680,34 +980,82 @@ void *telemetry_update_padstate(void *arg) {
     assert(arg != NULL);
     assert(args->state != NULL);
     padstate_t *state = args->state;
-    int err = -1;
+    uint32_t sent = 0;
+    uint32_t changes;
+    struct timespec next_keyframe;
+    bool keyframe;
+
+    clock_gettime(CLOCK_MONOTONIC, &next_keyframe); /* First update is a keyframe */
 
     for (;;) {
-        struct timespec cond_timeout;
-        clock_gettime(CLOCK_REALTIME, &cond_timeout);
-        cond_timeout.tv_sec += PADSTATE_UPDATE_TIMEOUT_SEC;
 
-        err = pthread_mutex_lock(&state->update_mut);
-        assert(err == 0 && "Failed to lock mutex");
+        /* Wait until either the pad state changes or it is time for a heartbeat. Changes made while this thread was
+         * sending are merged into a single wake-up. */
 
-        // waiting until either the cond times out or an update is received
-        // and we confirmed it was not a spurious wakeup
-        while (err != ETIMEDOUT && !state->update_recorded) {
-            err = pthread_cond_timedwait(&state->update_cond, &state->update_mut, &cond_timeout);
+        changes = notify_wait(&args->changes, PADSTATE_UPDATE_TIMEOUT_SEC * 1000);
+
+        /* Actuation outcomes are reported to the control client, and the state changes they carry come with them */
+
+        if (changes & PADSTATE_CHANGED_DONE) {
+            changes &= ~PADSTATE_CHANGED_DONE;
+            if (changes == 0) continue;
+        }
+
+        /* Sequence steps are reported on their own, and only cause a pad state update if the state changed too */
+
+        if (changes & PADSTATE_CHANGED_SEQ) {
+            telemetry_send_sequence(args->sequence, args->sock);
+            changes &= ~PADSTATE_CHANGED_SEQ;
+            if (changes == 0) continue;
         }
 
-        if (state->update_recorded) {
+        keyframe = (changes & PADSTATE_CHANGED_ALL) == PADSTATE_CHANGED_ALL || args->keyframe_sec == 0 ||
+                   deadline_remaining_us(&next_keyframe) <= 0;
+
+        if (keyframe) {
+            hinfo("Sent padstate keyframe.\n");
+            clock_gettime(CLOCK_MONOTONIC, &next_keyframe);
+            deadline_add_us(&next_keyframe, (uint64_t)args->keyframe_sec * 1000000);
+        } else if (changes) {
             hinfo("Sent updated padstate.\n");
         } else {
             hinfo("Sent padstate as heartbeat.\n");
         }
 
-        telemetry_send_padstate(state, args->sock);
-        state->update_recorded = false;
-        err = pthread_mutex_unlock(&state->update_mut);
-        assert(err == 0);
+        telemetry_send_padstate(state, args->sock, &sent, keyframe);
     }
 
     nxfail("telemetry_update_padstate exited");
     thread_return(0);
 }
+
+/*
+ * Thread which listens on the telemetry socket for clients requesting a pad state keyframe, and has one sent with the
+ * next pad state update, which happens right away.
+ * @param arg Arguments of type `telemetry_padstate_args_t`
+ * @return 0 on success, error code on failure (thread dies)
+ */
+void *telemetry_listen_keyframe(void *arg) {
+    telemetry_padstate_args_t *args = (telemetry_padstate_args_t *)arg;
+    assert(arg != NULL);
+    header_p hdr;
+    ssize_t b_read;
+
+    for (;;) {
+        b_read = recv(args->sock->sock, &hdr, sizeof(hdr), 0);
+        if (b_read < 0) {
+            herr("Could not receive keyframe request: %s\n", strerror(errno));
+            continue;
+        }
+
+        if (b_read != sizeof(hdr) || hdr.type != TYPE_CNTRL || hdr.subtype != CNTRL_KEYFRAME_REQ) {
+            hwarn("Ignored invalid message on telemetry socket.\n");
+            continue;
+        }
+
+        notify_post(&args->changes, PADSTATE_CHANGED_ALL);
+    }
+
+    nxfail("telemetry_listen_keyframe exited");
+    thread_return(0);
+}
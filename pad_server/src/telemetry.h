@@ -1,34 +1,58 @@
 #ifndef _TELEMETRY_H_
 #define _TELEMETRY_H_
 
+#include "replay.h"
+#include "sequence.h"
 #include "state.h"
 #include <netinet/in.h>
+#include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <sys/socket.h>
 
 #define MAX_TELEMETRY 5
 #define PADSTATE_UPDATE_TIMEOUT_SEC 5
 
+/* Default interval in seconds between full pad state keyframes, with only changes sent in between */
+#define PADSTATE_KEYFRAME_SEC 30
+
+/* Default rate in Hz at which random mock data is generated */
+#define TELEMETRY_MOCK_RATE_HZ 10
+
 /* The main telemetry socket */
 typedef struct {
     int sock;
     struct sockaddr_in addr;
+    _Atomic uint32_t seq; /* Sequence number of the next frame to be published */
+    pthread_mutex_t lock; /* Held while numbering and sending frames, so that they are sent in sequence order */
 } telemetry_sock_t;
 
 typedef struct {
     telemetry_sock_t *sock;
     padstate_t *state;
+    sequence_t *sequence;  /* Actuation sequence whose step reports are sent */
+    uint32_t keyframe_sec; /* Interval between full pad state keyframes, 0 to always send the full state */
+    notify_t changes;      /* Pad state changes, or all changes when a client requests a keyframe */
 } telemetry_padstate_args_t;
 
 typedef struct {
     padstate_t *state;
+    sequence_t *sequence; /* Actuation sequence whose step reports are sent */
     uint16_t port;
     char *addr;
     char *data_file;
+    uint32_t mock_rate;        /* Rate in Hz at which random mock data is generated */
+    replay_opts_t replay_opts; /* How the data file is played back */
+    uint32_t keyframe_sec;     /* Interval between full pad state keyframes, 0 to always send the full state */
+    bool trace;                /* Whether to send a latency trace with every sensor measurement */
 } telemetry_args_t;
 
+void telemetry_sock_lock(telemetry_sock_t *sock, int *cancel_state);
+void telemetry_sock_unlock(telemetry_sock_t *sock, int cancel_state);
 void *telemetry_run(void *arg);
 void *telemetry_update_padstate(void *arg);
-void telemetry_send_padstate(padstate_t *state, telemetry_sock_t *sock);
+void *telemetry_listen_keyframe(void *arg);
+void telemetry_send_padstate(padstate_t *state, telemetry_sock_t *sock, uint32_t *sent, bool keyframe);
+void telemetry_send_sequence(sequence_t *sequence, telemetry_sock_t *sock);
 
 #endif // _TELEMETRY_H_
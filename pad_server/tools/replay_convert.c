@@ -0,0 +1,81 @@
+/* NOTE: desktop-only tool, which converts CSV test data into replay files for the pad server. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../packets/packet.h"
+#include "../src/replay.h"
+
+#define HELP_TEXT                                                                                                      \
+    "replay_convert 0.0.0\n2024 CU InSpace\n\nDESCRIPTION:\n    Converts a CSV file of recorded sensor data into a "   \
+    "replay file which the pad\n    server can memory map and replay without parsing.\n\nUSAGE:\n    replay_convert "   \
+    "[options] input.csv output.bin\n\nOPTIONS:\n    -p period   Ignore the Time column and time stamp rows every "      \
+    "`period`\n                milliseconds instead.\n\nEXAMPLES:\n    replay_convert coldflow-fill.csv coldflow-fill.bin\n"
+
+/* Names of the telemetry sub-types data columns can be replayed as */
+static const char *SUBTYPE_STR[] = {
+    [TELEM_TEMP] = "temperature", [TELEM_PRESSURE] = "pressure", [TELEM_MASS] = "mass",
+    [TELEM_THRUST] = "thrust",    [TELEM_CONT] = "continuity",
+};
+
+int main(int argc, char **argv) {
+    uint32_t period_ms = 0;
+    uint32_t clamped = 0;
+    replay_t replay;
+    int err;
+    int c;
+
+    while ((c = getopt(argc, argv, ":hp:")) != -1) {
+        switch (c) {
+        case 'h':
+            puts(HELP_TEXT);
+            exit(EXIT_SUCCESS);
+            break;
+        case 'p':
+            period_ms = strtoul(optarg, NULL, 10);
+            if (period_ms == 0) {
+                fprintf(stderr, "Invalid sample period %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case '?':
+            fprintf(stderr, "Unknown option -%c\n", optopt);
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "Expected an input CSV file and an output replay file.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    err = replay_load_csv(&replay, argv[optind], period_ms, &clamped);
+    if (err) {
+        fprintf(stderr, "Could not convert \"%s\": %s\n", argv[optind], strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < replay.hdr->ncolumns; i++) {
+        printf("Column %s -> %s #%u\n", replay.columns[i].name, SUBTYPE_STR[replay.columns[i].subtype],
+               replay.columns[i].id);
+    }
+    if (clamped > 0) {
+        fprintf(stderr, "%u rows had time stamps going backwards and were clamped.\n", clamped);
+    }
+
+    err = replay_write(&replay, argv[optind + 1]);
+    if (err) {
+        fprintf(stderr, "Could not write \"%s\": %s\n", argv[optind + 1], strerror(err));
+        replay_close(&replay);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Wrote %u rows spanning %u ms to %s\n", replay.hdr->nrows, replay.time[replay.hdr->nrows - 1] - replay.time[0],
+           argv[optind + 1]);
+    replay_close(&replay);
+    return EXIT_SUCCESS;
+}
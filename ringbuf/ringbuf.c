@@ -0,0 +1,96 @@
+#include <errno.h>
+#include <string.h>
+
+#include "ringbuf.h"
+
+/*
+ * Initialize a ring buffer.
+ * @param ring The ring buffer to initialize.
+ * @param storage Storage for the elements, at least `elem_size * capacity` bytes long.
+ * @param elem_size The size of each element in bytes.
+ * @param capacity The number of elements the ring can hold. Must be a power of 2.
+ * @return 0 on success, EINVAL if the capacity is not a power of 2.
+ */
+int ringbuf_init(ringbuf_t *ring, void *storage, size_t elem_size, size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return EINVAL;
+    }
+
+    ring->buf = storage;
+    ring->elem_size = elem_size;
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return 0;
+}
+
+/*
+ * Push an element onto the ring. Must only be called by the producer.
+ * @param ring The ring buffer to push to.
+ * @param elem The element to copy into the ring.
+ * @return True if the element was pushed, false if the ring was full and the element was dropped.
+ */
+bool ringbuf_push(ringbuf_t *ring, const void *elem) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail == ring->capacity) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(&ring->buf[(head & (ring->capacity - 1)) * ring->elem_size], elem, ring->elem_size);
+
+    /* Release the element to the consumer only once it has been copied in */
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+/*
+ * Pull up to `max` elements from the ring. Must only be called by the consumer.
+ * @param ring The ring buffer to pull from.
+ * @param elems Destination for the elements, at least `max` elements long.
+ * @param max The maximum number of elements to pull.
+ * @return The number of elements pulled, 0 if the ring was empty.
+ */
+size_t ringbuf_pull(ringbuf_t *ring, void *elems, size_t max) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t n = head - tail;
+    unsigned char *dst = elems;
+
+    if (n > max) n = max;
+
+    /* Copy out in at most two pieces, since the elements may wrap around the end of the storage */
+
+    size_t start = tail & (ring->capacity - 1);
+    size_t first = n < ring->capacity - start ? n : ring->capacity - start;
+    memcpy(dst, &ring->buf[start * ring->elem_size], first * ring->elem_size);
+    memcpy(dst + first * ring->elem_size, ring->buf, (n - first) * ring->elem_size);
+
+    /* Only hand the slots back to the producer once they have been copied out */
+
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/*
+ * Get the number of elements waiting in the ring. The count may be stale by the time it is used if the other side is
+ * running.
+ * @param ring The ring buffer.
+ * @return The number of elements in the ring.
+ */
+size_t ringbuf_count(ringbuf_t *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+/*
+ * Get the number of elements dropped because the ring was full.
+ * @param ring The ring buffer.
+ * @return The number of dropped elements.
+ */
+unsigned long ringbuf_dropped(ringbuf_t *ring) { return atomic_load_explicit(&ring->dropped, memory_order_relaxed); }
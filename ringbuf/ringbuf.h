@@ -0,0 +1,30 @@
+#ifndef _RINGBUF_H_
+#define _RINGBUF_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Size of a cache line, used to keep the producer's and consumer's indices from sharing one */
+#define RINGBUF_CACHE_LINE 64
+
+/*
+ * Lock-free ring buffer of fixed-size elements, for exactly one producer thread and one consumer thread. Neither side
+ * ever blocks: pushing to a full ring drops the element and pulling from an empty ring returns nothing.
+ */
+typedef struct {
+    unsigned char *buf; /* Storage for `capacity` elements */
+    size_t elem_size;   /* Size of each element in bytes */
+    size_t capacity;    /* Number of elements the ring can hold, a power of 2 */
+    _Alignas(RINGBUF_CACHE_LINE) atomic_size_t head; /* Count of elements pushed, only written by the producer */
+    atomic_ulong dropped;                            /* Count of elements dropped because the ring was full */
+    _Alignas(RINGBUF_CACHE_LINE) atomic_size_t tail; /* Count of elements pulled, only written by the consumer */
+} ringbuf_t;
+
+int ringbuf_init(ringbuf_t *ring, void *storage, size_t elem_size, size_t capacity);
+bool ringbuf_push(ringbuf_t *ring, const void *elem);
+size_t ringbuf_pull(ringbuf_t *ring, void *elems, size_t max);
+size_t ringbuf_count(ringbuf_t *ring);
+unsigned long ringbuf_dropped(ringbuf_t *ring);
+
+#endif // _RINGBUF_H_
@@ -1,21 +1,32 @@
 CC = gcc
-CFLAGS = -Wall -Wextra
+CFLAGS = -Wall -Wextra -pthread
 OUT = telem_client
+LDLIBS = -lm
 
 SRCDIR = $(abspath ./src)
 SRCS = $(wildcard $(SRCDIR)/*.c)
 SRCS += $(wildcard ../packets/*.c)
+SRCS += $(wildcard ../ringbuf/*.c)
 
 OBJS = $(patsubst %.c,%.o,$(SRCS))
 
-all: $(OUT)
+# Recording export tool
+
+EXPORT_OUT = telem_export
+EXPORT_SRCS = $(abspath ./tools/telem_export.c) $(SRCDIR)/recording.c $(SRCDIR)/frame.c ../packets/packet.c
+EXPORT_OBJS = $(patsubst %.c,%.o,$(EXPORT_SRCS))
+
+all: $(OUT) $(EXPORT_OUT)
 
 $(OUT): $(OBJS)
-	$(CC) $(CFLAGS) $(OBJS) -o $(OUT)
+	$(CC) $(CFLAGS) $(OBJS) -o $(OUT) $(LDLIBS)
+
+$(EXPORT_OUT): $(EXPORT_OBJS)
+	$(CC) $(CFLAGS) $(EXPORT_OBJS) -o $(EXPORT_OUT)
 
 %.o: %.c
 	$(CC) $(CFLAGS) $(WARNINGS) -o $@ -c $<
 
 clean:
-	@rm $(OUT)
-	@rm $(OBJS)
+	@rm $(OUT) $(EXPORT_OUT)
+	@rm $(sort $(OBJS) $(EXPORT_OBJS))
@@ -13,5 +13,6 @@ MAINSRC = src/telem_client_main.c
 
 CSRCS += $(wildcard src/*.c)
 CSRCS += ../packets/packet.c
+CSRCS += ../ringbuf/ringbuf.c
 
 include $(APPDIR)/Application.mk
@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "fmt.h"
+
+/* Every pair of decimal digits, so that numbers are converted two digits per division */
+static const char DIGIT_PAIRS[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+/*
+ * Hand the buffered output to the stream, without flushing the stream itself.
+ * @param out The output buffer.
+ */
+static void fmt_drain(fmt_buf_t *out) {
+    if (out->len == 0) return;
+    fwrite(out->data, 1, out->len, out->stream);
+    out->len = 0;
+}
+
+/*
+ * Make room in the output buffer.
+ * @param out The output buffer.
+ * @param n The number of bytes needed, at most FMT_BUFSIZ.
+ * @return Where to write the bytes.
+ */
+static char *fmt_reserve(fmt_buf_t *out, size_t n) {
+    if (out->len + n > sizeof(out->data)) fmt_drain(out);
+    return &out->data[out->len];
+}
+
+/*
+ * Convert a number to decimal, right aligned so that it ends at `end`.
+ * @param end One past where the last digit goes.
+ * @param value The number.
+ * @return Where the first digit went.
+ */
+static char *fmt_digits(char *end, uint32_t value) {
+    char *pos = end;
+
+    while (value >= 100) {
+        unsigned int pair = (value % 100) * 2;
+        value /= 100;
+        pos -= 2;
+        pos[0] = DIGIT_PAIRS[pair];
+        pos[1] = DIGIT_PAIRS[pair + 1];
+    }
+
+    if (value >= 10) {
+        pos -= 2;
+        pos[0] = DIGIT_PAIRS[value * 2];
+        pos[1] = DIGIT_PAIRS[value * 2 + 1];
+    } else {
+        *--pos = '0' + value;
+    }
+    return pos;
+}
+
+/*
+ * Write a number, with an optional sign and fraction of three digits.
+ * @param dst Where to write the number, with room for FMT_NUM_MAX bytes.
+ * @param negative Whether to prefix a minus sign.
+ * @param magnitude The magnitude of the number, in thousandths if `milli` is true.
+ * @param milli Whether the last three digits are a fraction.
+ * @return One past the last byte written.
+ */
+static char *put_number(char *dst, bool negative, uint32_t magnitude, bool milli) {
+    char tmp[FMT_NUM_MAX];
+    char *end = &tmp[sizeof(tmp)];
+    char *start;
+    size_t n;
+
+    if (milli) {
+        uint32_t frac = magnitude % 1000;
+        end -= 4;
+        end[0] = '.';
+        end[1] = '0' + frac / 100;
+        end[2] = DIGIT_PAIRS[(frac % 100) * 2];
+        end[3] = DIGIT_PAIRS[(frac % 100) * 2 + 1];
+        magnitude /= 1000;
+    }
+
+    start = fmt_digits(end, magnitude);
+    if (negative) *--start = '-';
+
+    n = &tmp[sizeof(tmp)] - start;
+    memcpy(dst, start, n);
+    return dst + n;
+}
+
+/*
+ * Write a string of known length.
+ * @param dst Where to write the string, with room for `n` bytes.
+ * @param str The string.
+ * @param n The length of the string.
+ * @return One past the last byte written.
+ */
+static char *put_str(char *dst, const char *str, size_t n) {
+    memcpy(dst, str, n);
+    return dst + n;
+}
+
+/*
+ * Append a number, with an optional sign and fraction of three digits.
+ * @param out The output buffer.
+ * @param negative Whether to prefix a minus sign.
+ * @param magnitude The magnitude of the number, in thousandths if `milli` is true.
+ * @param milli Whether the last three digits are a fraction.
+ */
+static void fmt_number(fmt_buf_t *out, bool negative, uint32_t magnitude, bool milli) {
+    char *dst = fmt_reserve(out, FMT_NUM_MAX);
+    out->len = put_number(dst, negative, magnitude, milli) - out->data;
+}
+
+/*
+ * Initialize an empty output buffer.
+ * @param out The output buffer.
+ * @param stream Where the output goes.
+ */
+void fmt_init(fmt_buf_t *out, FILE *stream) {
+    out->len = 0;
+    out->stream = stream;
+}
+
+/*
+ * Append a string.
+ * @param out The output buffer.
+ * @param str The null terminated string.
+ */
+void fmt_str(fmt_buf_t *out, const char *str) {
+    size_t n = strlen(str);
+
+    /* Strings too long for the buffer go straight to the stream */
+
+    if (n > sizeof(out->data)) {
+        fmt_drain(out);
+        fwrite(str, 1, n, out->stream);
+        return;
+    }
+
+    put_str(fmt_reserve(out, n), str, n);
+    out->len += n;
+}
+
+/*
+ * Append an unsigned number in decimal.
+ * @param out The output buffer.
+ * @param value The number.
+ */
+void fmt_uint(fmt_buf_t *out, uint32_t value) { fmt_number(out, false, value, false); }
+
+/*
+ * Append a line reporting a measurement, such as "Pressure transducer #1: 33.313 PSI @ 446 ms". The whole line is
+ * formatted in one go, as this is most of the console output.
+ * @param out The output buffer.
+ * @param name The name of the kind of sensor.
+ * @param id The ID of the sensor.
+ * @param value The measurement, in thousandths of `unit` if `milli` is true.
+ * @param milli Whether the last three digits of `value` are a fraction.
+ * @param unit The unit of the measurement.
+ * @param time The time stamp of the measurement in milliseconds.
+ */
+void fmt_measurement(fmt_buf_t *out, const char *name, uint8_t id, int32_t value, bool milli, const char *unit,
+                     uint32_t time) {
+    size_t name_len = strlen(name);
+    size_t unit_len = strlen(unit);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    char *dst;
+
+    dst = fmt_reserve(out, name_len + unit_len + 3 * FMT_NUM_MAX + sizeof(" #: @ ms\n"));
+    dst = put_str(dst, name, name_len);
+    dst = put_str(dst, " #", 2);
+    dst = put_number(dst, false, id, false);
+    dst = put_str(dst, ": ", 2);
+    dst = put_number(dst, value < 0, magnitude, milli);
+    *dst++ = ' ';
+    dst = put_str(dst, unit, unit_len);
+    dst = put_str(dst, " @ ", 3);
+    dst = put_number(dst, false, time, false);
+    dst = put_str(dst, " ms\n", 4);
+    out->len = dst - out->data;
+}
+
+/*
+ * Write out everything appended so far and flush the stream.
+ * @param out The output buffer.
+ */
+void fmt_flush(fmt_buf_t *out) {
+    fmt_drain(out);
+    fflush(out->stream);
+}
@@ -0,0 +1,36 @@
+#ifndef _FMT_H_
+#define _FMT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Size of the console output buffer, which is handed to its stream in one piece when full */
+#ifdef CONFIG_HYSIM_TELEM_CLIENT_FMT_BUFSIZ
+#define FMT_BUFSIZ CONFIG_HYSIM_TELEM_CLIENT_FMT_BUFSIZ
+#else
+#define FMT_BUFSIZ (64 * 1024)
+#endif
+
+/* Longest number written, which is a signed 32 bit number with a fraction */
+#define FMT_NUM_MAX 16
+
+/*
+ * Output buffer which telemetry lines are formatted into without going through printf. The buffer is only handed to
+ * its stream when full or flushed, so it must be flushed before anything else is printed to the same stream.
+ */
+typedef struct {
+    char data[FMT_BUFSIZ]; /* Formatted output not yet handed to the stream */
+    size_t len;            /* Number of bytes in `data` */
+    FILE *stream;          /* Where the output goes */
+} fmt_buf_t;
+
+void fmt_init(fmt_buf_t *out, FILE *stream);
+void fmt_str(fmt_buf_t *out, const char *str);
+void fmt_uint(fmt_buf_t *out, uint32_t value);
+void fmt_measurement(fmt_buf_t *out, const char *name, uint8_t id, int32_t value, bool milli, const char *unit,
+                     uint32_t time);
+void fmt_flush(fmt_buf_t *out);
+
+#endif // _FMT_H_
@@ -0,0 +1,65 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "frame.h"
+
+/*
+ * Decode a telemetry frame, calling `handler` on every record it contains in the order they were packed.
+ * Records before the first malformed record in the frame are still handed to `handler`.
+ * @param buf The datagram containing the frame.
+ * @param n The length of the datagram in bytes.
+ * @param frame Output for the frame header.
+ * @param handler The function to call on every record.
+ * @param arg An argument passed through to `handler`.
+ * @return 0 on success, EBADMSG if the frame is truncated or its header disagrees with its contents, EPROTO if a record
+ * of unknown sub-type is encountered.
+ */
+int frame_decode(const void *buf, size_t n, telem_frame_p *frame, frame_record_f handler, void *arg) {
+    const uint8_t *pos = buf;
+    const uint8_t *end;
+    const header_p *hdr;
+    size_t body_len;
+
+    if (n < sizeof(*frame)) {
+        return EBADMSG;
+    }
+
+    memcpy(frame, pos, sizeof(*frame));
+    pos += sizeof(*frame);
+
+    if (frame->len != n - sizeof(*frame)) {
+        return EBADMSG;
+    }
+    end = pos + frame->len;
+
+    /* Walk every record in the frame */
+
+    for (uint8_t i = 0; i < frame->count; i++) {
+        if ((size_t)(end - pos) < sizeof(header_p)) {
+            return EBADMSG;
+        }
+        hdr = (const header_p *)pos;
+        pos += sizeof(header_p);
+
+        if (hdr->type != TYPE_TELEM) {
+            return EPROTO;
+        }
+
+        body_len = packet_telem_body_len(hdr->subtype);
+        if (body_len == 0) {
+            return EPROTO;
+        }
+
+        if ((size_t)(end - pos) < body_len) {
+            return EBADMSG;
+        }
+
+        handler(hdr, pos, arg);
+        pos += body_len;
+    }
+
+    /* Every byte of the frame should belong to a record */
+
+    return pos == end ? 0 : EBADMSG;
+}
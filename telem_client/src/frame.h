@@ -0,0 +1,13 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stddef.h>
+
+#include "../../packets/packet.h"
+
+/* Function called on every record decoded from a telemetry frame. */
+typedef void (*frame_record_f)(const header_p *hdr, const void *body, void *arg);
+
+int frame_decode(const void *buf, size_t n, telem_frame_p *frame, frame_record_f handler, void *arg);
+
+#endif // _FRAME_H_
@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <string.h>
+
+#include "framequeue.h"
+
+/*
+ * Initialize the condition the output thread waits on, so that its time-outs are measured on CLOCK_MONOTONIC and are
+ * not stretched or cut short when the wall clock is set. Where a condition cannot use CLOCK_MONOTONIC (macOS), it falls
+ * back to CLOCK_REALTIME.
+ * @param queue The queue whose condition to initialize.
+ * @return 0 on success, error code on failure.
+ */
+static int framequeue_init_cond(framequeue_t *queue) {
+#ifndef __APPLE__
+    pthread_condattr_t attr;
+    int err;
+
+    err = pthread_condattr_init(&attr);
+    if (err) return err;
+
+    queue->clock = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0 ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+    err = pthread_cond_init(&queue->ready, &attr);
+    pthread_condattr_destroy(&attr);
+    return err;
+#else
+    queue->clock = CLOCK_REALTIME;
+    return pthread_cond_init(&queue->ready, NULL);
+#endif
+}
+
+/*
+ * Initialize an empty frame queue.
+ * @param queue The queue to initialize.
+ * @return 0 on success, error code on failure.
+ */
+int framequeue_init(framequeue_t *queue) {
+    int err;
+
+    err = ringbuf_init(&queue->ring, queue->entries, sizeof(queue->entries[0]), FRAMEQUEUE_LEN);
+    if (err) return err;
+
+    err = pthread_mutex_init(&queue->lock, NULL);
+    if (err) return err;
+
+    err = framequeue_init_cond(queue);
+    if (err) return err;
+
+    atomic_init(&queue->peak, 0);
+    return 0;
+}
+
+/*
+ * Queue every datagram of a received batch, then wake the output thread. Datagrams which do not fit are dropped and
+ * counted. Must only be called by the receive thread.
+ * @param queue The queue.
+ * @param batch The received datagrams.
+ */
+void framequeue_push(framequeue_t *queue, const stream_batch_t *batch) {
+    static framequeue_entry_t entry; /* Only used by the receive thread, kept out of its stack */
+    size_t depth;
+
+    for (unsigned int i = 0; i < batch->count; i++) {
+        entry.received = batch->received[i];
+        entry.addr = batch->addrs[i];
+        entry.len = batch->lens[i];
+        memcpy(entry.data, batch->bufs[i], batch->lens[i]);
+        ringbuf_push(&queue->ring, &entry);
+    }
+
+    depth = ringbuf_count(&queue->ring);
+    if (depth > atomic_load_explicit(&queue->peak, memory_order_relaxed)) {
+        atomic_store_explicit(&queue->peak, depth, memory_order_relaxed);
+    }
+
+    /* The output thread checks for datagrams under the lock before waiting, so this wake-up can not be missed */
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * Take the oldest queued datagram, waiting for one if the queue is empty. Must only be called by the output thread.
+ * @param queue The queue.
+ * @param entry Output for the datagram.
+ * @param timeout_ms The longest time to wait for a datagram in milliseconds.
+ * @return True if a datagram was taken, false if none arrived before the time-out.
+ */
+bool framequeue_pull(framequeue_t *queue, framequeue_entry_t *entry, uint32_t timeout_ms) {
+    struct timespec deadline;
+
+    if (ringbuf_pull(&queue->ring, entry, 1) == 1) return true;
+
+    clock_gettime(queue->clock, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (ringbuf_count(&queue->ring) == 0) {
+        if (pthread_cond_timedwait(&queue->ready, &queue->lock, &deadline) == ETIMEDOUT) break;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return ringbuf_pull(&queue->ring, entry, 1) == 1;
+}
+
+/*
+ * Print the depth and drop counters of the queue.
+ * @param queue The queue.
+ * @param stream Where to print the counters.
+ */
+void framequeue_print(framequeue_t *queue, FILE *stream) {
+    fprintf(stream, "Telemetry datagrams queued for output: %zu (peak %zu of %u), %lu dropped\n",
+            ringbuf_count(&queue->ring), atomic_load_explicit(&queue->peak, memory_order_relaxed), FRAMEQUEUE_LEN,
+            ringbuf_dropped(&queue->ring));
+}
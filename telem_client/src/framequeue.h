@@ -0,0 +1,49 @@
+#ifndef _FRAMEQUEUE_H_
+#define _FRAMEQUEUE_H_
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../../packets/packet.h"
+#include "../../ringbuf/ringbuf.h"
+#include "stream.h"
+
+/* Number of datagrams which can wait between the receive thread and the output, must be a power of 2 */
+#ifdef CONFIG_HYSIM_TELEM_CLIENT_QUEUE_LEN
+#define FRAMEQUEUE_LEN CONFIG_HYSIM_TELEM_CLIENT_QUEUE_LEN
+#else
+#define FRAMEQUEUE_LEN 1024
+#endif
+
+/* A received datagram waiting to be decoded */
+typedef struct {
+    struct timespec received;      /* Time the datagram arrived, on CLOCK_REALTIME */
+    struct sockaddr_in addr;       /* Sender of the datagram */
+    uint16_t len;                  /* Length of the datagram in bytes */
+    uint8_t data[TELEM_FRAME_MAX]; /* The datagram */
+} framequeue_entry_t;
+
+/*
+ * Queue of received datagrams handed from the receive thread, which only drains the socket, to the thread which decodes
+ * and logs them. When the output falls behind and the queue is full, datagrams are dropped and counted.
+ */
+typedef struct {
+    ringbuf_t ring;                             /* Queued datagrams */
+    framequeue_entry_t entries[FRAMEQUEUE_LEN]; /* Storage for the ring */
+    pthread_mutex_t lock;                       /* Protects waiting for datagrams */
+    pthread_cond_t ready;                       /* Signalled after each batch of datagrams is queued */
+    clockid_t clock;                            /* Clock the deadlines of waits on `ready` are measured on */
+    atomic_size_t peak;                         /* Most datagrams ever waiting at once */
+} framequeue_t;
+
+int framequeue_init(framequeue_t *queue);
+void framequeue_push(framequeue_t *queue, const stream_batch_t *batch);
+bool framequeue_pull(framequeue_t *queue, framequeue_entry_t *entry, uint32_t timeout_ms);
+void framequeue_print(framequeue_t *queue, FILE *stream);
+
+#endif // _FRAMEQUEUE_H_
@@ -1,5 +1,27 @@
 #define HELP_TEXT                                                                                                      \
     "telem_client 0.0.0\n(c) CU InSpace 2024\n\nDESCRIPTION:\n    Acts a client c"                                     \
     "onsuming telemetry data from the pad server.\n\nUSAGE:\n    telem_client [options]\n\nOPTIONS:\n"                 \
-    "   -a addr The multicast address to listen on. If not specified, address 224.0.0.10 is used. \n\n"                \
-    "EXAMPLES:\n    telem_client -a 224.0.0.10\n"
+    "   -a addr The multicast address to listen on. If not specified, address 224.0.0.10 is used. \n"                  \
+    "   -s sec  Print the frame loss counters, and the latency of traced\n"                                            \
+    "           telemetry, every `sec` seconds. If not specified, they are only\n"                                     \
+    "           printed on exit and on SIGUSR1.\n"                                                                     \
+    "   -r file Record every telemetry frame received to `file`, which can be\n"                                       \
+    "           exported to CSV with telem_export.\n"                                                                  \
+    "   -R MiB  Start a new recording file, named `file.1`, `file.2` and so on,\n"                                     \
+    "           once the current one reaches `MiB` mebibytes. If not specified,\n"                                     \
+    "           the recording is a single file.\n"                                                                     \
+    "   -D      Write the recording with direct I/O, bypassing the page cache,\n"                                      \
+    "           where the file system supports it.\n"                                                                  \
+    "   -q      Do not log every telemetry record to the console.\n"                                                   \
+    "   -w secs Keep the minimum, maximum, mean and standard deviation of every\n"                                     \
+    "           sensor over windows of these lengths in seconds, separated by\n"                                       \
+    "           commas. If not specified, the windows are 1, 10 and 60 seconds.\n\n"                                   \
+    "COMMANDS:\n    Typed on standard input while the client runs.\n"                                                  \
+    "    list              List the sensors measurements were received from.\n"                                        \
+    "    stats sensor [s]  Report the statistics of a sensor, such as P2, T1, Mass\n"                                  \
+    "                      or Thrust, over the window of `s` seconds or every window.\n\n"                             \
+    "SIGNALS:\n    SIGUSR1 Print the frame loss counters, and the latency of the traced\n"                             \
+    "            telemetry received so far if the pad server sends latency traces.\n\n"                                \
+    "EXAMPLES:\n    telem_client -a 224.0.0.10\n"                                                                      \
+    "    telem_client -q -r coldflow.rec -R 256\n"                                                                     \
+    "    telem_client -q -w 0.5,5,30\n"
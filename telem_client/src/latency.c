@@ -0,0 +1,155 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "latency.h"
+
+/* Names of the traced telemetry sub-types, for the summary */
+static const char *SUBTYPE_NAMES[LATENCY_SUBTYPES] = {
+    [TELEM_TEMP] = "Temperature",
+    [TELEM_PRESSURE] = "Pressure",
+    [TELEM_MASS] = "Mass",
+    [TELEM_THRUST] = "Thrust",
+    [TELEM_ARM] = "Arming state",
+    [TELEM_ACT] = "Actuator state",
+    [TELEM_WARN] = "Warning",
+    [TELEM_CONT] = "Continuity",
+    [TELEM_CONN] = "Connection status",
+    [TELEM_SEQ_STEP] = "Sequence step",
+};
+
+/* Names of the stages, for the summary */
+static const char *STAGE_NAMES[NUM_LATENCY_STAGES] = {
+    [LATENCY_PAD] = "pad",
+    [LATENCY_NETWORK] = "network",
+    [LATENCY_TOTAL] = "total",
+};
+
+/*
+ * Get the bucket a latency falls in. Latencies below LATENCY_SUB_BUCKETS each have their own bucket; above that, each
+ * power of two is split into LATENCY_SUB_BUCKETS buckets of equal width.
+ * @param us The latency in microseconds, below 2^32.
+ * @return The index of the bucket.
+ */
+static unsigned int latency_bucket(uint64_t us) {
+    unsigned int shift = 0;
+
+    if (us < LATENCY_SUB_BUCKETS) return us;
+
+    while ((us >> shift) >= 2 * LATENCY_SUB_BUCKETS) shift++;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (unsigned int)(us >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+/*
+ * Get the highest latency which falls in a bucket.
+ * @param bucket The index of the bucket.
+ * @return The highest latency of the bucket in microseconds.
+ */
+static uint64_t latency_bucket_max(unsigned int bucket) {
+    unsigned int shift;
+
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+    shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    return (((uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+/*
+ * Add a latency to a histogram.
+ * @param hist The histogram.
+ * @param start When the stage started, in microseconds.
+ * @param end When the stage ended, in microseconds.
+ */
+static void latency_add(latency_hist_t *hist, uint64_t start, uint64_t end) {
+    uint64_t us = 0;
+
+    if (end >= start) {
+        us = end - start;
+    } else {
+        hist->negative++;
+    }
+
+    if (us > UINT32_MAX) us = UINT32_MAX;
+    hist->buckets[latency_bucket(us)]++;
+    hist->count++;
+    if (us > hist->max) hist->max = us;
+}
+
+/*
+ * Initialize empty latency histograms.
+ * @param lat The latencies to initialize.
+ */
+void latency_init(latency_t *lat) { memset(lat, 0, sizeof(*lat)); }
+
+/*
+ * Record the latency of a traced telemetry record.
+ * @param lat The latencies.
+ * @param subtype The sub-type of the traced record.
+ * @param trace The trace of the record.
+ * @param received When the record was received, in microseconds since the epoch.
+ */
+void latency_record(latency_t *lat, uint8_t subtype, const trace_p *trace, uint64_t received) {
+    if (subtype >= LATENCY_SUBTYPES) return;
+
+    latency_add(&lat->hists[subtype][LATENCY_PAD], trace->acquired, trace->sent);
+    latency_add(&lat->hists[subtype][LATENCY_NETWORK], trace->sent, received);
+    latency_add(&lat->hists[subtype][LATENCY_TOTAL], trace->acquired, received);
+}
+
+/*
+ * Get a percentile of a histogram. The result is the top of the bucket the percentile falls in, so it is never lower
+ * than the true percentile.
+ * @param hist The histogram.
+ * @param percentile The percentile, from 0 to 100.
+ * @return The percentile in microseconds, 0 if the histogram is empty.
+ */
+uint64_t latency_percentile(const latency_hist_t *hist, double percentile) {
+    uint64_t rank = (uint64_t)(hist->count * percentile / 100);
+    uint64_t seen = 0;
+
+    if (hist->count == 0) return 0;
+    if (rank >= hist->count) rank = hist->count - 1;
+
+    for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank) {
+            return latency_bucket_max(i) < hist->max ? latency_bucket_max(i) : hist->max;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Print the 50th and 99th percentile and the maximum latency of every traced sub-type and stage.
+ * @param lat The latencies.
+ * @param stream Where to print the summary.
+ */
+void latency_print(const latency_t *lat, FILE *stream) {
+    const latency_hist_t *hist;
+    bool any = false;
+
+    for (unsigned int i = 0; i < LATENCY_SUBTYPES; i++) {
+        if (lat->hists[i][LATENCY_TOTAL].count == 0) continue;
+
+        if (!any) {
+            fprintf(stream, "Telemetry latency in microseconds (p50 / p99 / max):\n");
+            any = true;
+        }
+
+        fprintf(stream, "%s, %llu records:\n", SUBTYPE_NAMES[i],
+                (unsigned long long)lat->hists[i][LATENCY_TOTAL].count);
+        for (unsigned int s = 0; s < NUM_LATENCY_STAGES; s++) {
+            hist = &lat->hists[i][s];
+            fprintf(stream, "    %-8s %8llu / %8llu / %8llu", STAGE_NAMES[s],
+                    (unsigned long long)latency_percentile(hist, 50), (unsigned long long)latency_percentile(hist, 99),
+                    (unsigned long long)hist->max);
+            if (hist->negative > 0) {
+                fprintf(stream, " (%llu negative, clocks out of sync?)", (unsigned long long)hist->negative);
+            }
+            fprintf(stream, "\n");
+        }
+    }
+
+    if (!any) {
+        fprintf(stream, "No latency traces received, start the pad server with -T to send them.\n");
+    }
+}
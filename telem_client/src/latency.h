@@ -0,0 +1,44 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../packets/packet.h"
+
+/* Number of buckets per power of two in a latency histogram, which bounds the error of a percentile to 1/8 */
+#define LATENCY_SUB_BUCKETS 8
+
+/* Number of buckets in a latency histogram, enough for latencies up to 2^32 microseconds */
+#define LATENCY_BUCKETS (32 * LATENCY_SUB_BUCKETS)
+
+/* Number of telemetry sub-types which can be traced, which is every sub-type before the trace itself */
+#define LATENCY_SUBTYPES TELEM_TRACE
+
+/* Stages of the path from a sensor to the telemetry client */
+typedef enum {
+    LATENCY_PAD,        /* From acquisition to sending, spent on the pad */
+    LATENCY_NETWORK,    /* From sending to receiving, spent on the network */
+    LATENCY_TOTAL,      /* From acquisition to receiving */
+    NUM_LATENCY_STAGES, /* Number of stages */
+} latency_stage_e;
+
+/* Histogram of latencies in microseconds, with buckets whose width grows with the latency */
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS]; /* Number of latencies in each bucket */
+    uint64_t count;                    /* Number of latencies recorded */
+    uint64_t max;                      /* Highest latency recorded */
+    uint64_t negative;                 /* Number of negative latencies, counted as 0, from clocks out of sync */
+} latency_hist_t;
+
+/* Latencies of traced telemetry, for each sub-type and stage */
+typedef struct {
+    latency_hist_t hists[LATENCY_SUBTYPES][NUM_LATENCY_STAGES];
+} latency_t;
+
+void latency_init(latency_t *lat);
+void latency_record(latency_t *lat, uint8_t subtype, const trace_p *trace, uint64_t received);
+uint64_t latency_percentile(const latency_hist_t *hist, double percentile);
+void latency_print(const latency_t *lat, FILE *stream);
+
+#endif // _LATENCY_H_
@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "../../packets/packet.h"
+#include "query.h"
+
+/* How a kind of sensor is named in commands and reported */
+typedef struct {
+    uint8_t subtype;    /* Telemetry sub-type of the measurements */
+    const char *prefix; /* Name of the sensor in commands, before its ID */
+    const char *name;   /* Name of the kind of sensor, as it is logged */
+    const char *unit;   /* Unit the measurements are reported in */
+    bool milli;         /* Whether the measurements are in thousandths of `unit` */
+} query_sensor_t;
+
+/* The same names as the columns of exported recordings. Longer prefixes come first so that "Thrust" is not "T". */
+static const query_sensor_t SENSORS[] = {
+    {.subtype = TELEM_THRUST, .prefix = "Thrust", .name = "Thrust sensor", .unit = "N", .milli = false},
+    {.subtype = TELEM_MASS, .prefix = "Mass", .name = "Load cell", .unit = "kg", .milli = true},
+    {.subtype = TELEM_PRESSURE, .prefix = "P", .name = "Pressure transducer", .unit = "PSI", .milli = true},
+    {.subtype = TELEM_TEMP, .prefix = "T", .name = "Thermocouple", .unit = "C", .milli = true},
+};
+
+#define NSENSORS (sizeof(SENSORS) / sizeof(SENSORS[0]))
+
+/*
+ * @param subtype A telemetry sub-type kept in the store.
+ * @return How the kind of sensor is named.
+ */
+static const query_sensor_t *sensor_kind(uint8_t subtype) {
+    for (unsigned int i = 0; i < NSENSORS; i++) {
+        if (SENSORS[i].subtype == subtype) return &SENSORS[i];
+    }
+    return NULL;
+}
+
+/*
+ * Parse the name of a sensor, such as "P2" or "Thrust", ignoring case. The ID may be left out if it is 0.
+ * @param str The name.
+ * @param kind Set to the kind of sensor.
+ * @param id Set to the ID of the sensor.
+ * @return True if the name is valid.
+ */
+static bool parse_sensor(const char *str, const query_sensor_t **kind, uint8_t *id) {
+    for (unsigned int i = 0; i < NSENSORS; i++) {
+        size_t len = strlen(SENSORS[i].prefix);
+        char *end;
+
+        if (strncasecmp(str, SENSORS[i].prefix, len) != 0) continue;
+        str += len;
+        if (*str == '\0') {
+            *id = 0;
+        } else {
+            unsigned long parsed = strtoul(str, &end, 10);
+            if (*str < '0' || *str > '9' || *end != '\0' || parsed > UINT8_MAX) return false;
+            *id = parsed;
+        }
+        *kind = &SENSORS[i];
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Report the statistics of a window of a series.
+ * @param series The series.
+ * @param kind The kind of sensor of the series.
+ * @param window The number of the window.
+ * @param stream Where to report.
+ */
+static void print_window(const series_t *series, const query_sensor_t *kind, unsigned int window, FILE *stream) {
+    series_stats_t stats;
+    double scale = kind->milli ? 1000.0 : 1.0;
+    int decimals = kind->milli ? 3 : 0;
+
+    series_stats(series, window, &stats);
+    fprintf(stream, "%s #%u, last %g s: %u samples, min %.*f, max %.*f, mean %.3f, stddev %.3f %s", kind->name,
+            series->id, stats.span / 1000.0, stats.count, decimals, stats.min / scale, decimals, stats.max / scale,
+            stats.mean / scale, stats.stddev / scale, kind->unit);
+    if (stats.truncated) {
+        fprintf(stream, " (only the last %g s are kept)", stats.covered / 1000.0);
+    }
+    fprintf(stream, "\n");
+}
+
+/*
+ * List every sensor with samples kept, and its latest sample.
+ * @param store The store.
+ * @param stream Where to report.
+ */
+static void run_list(const series_store_t *store, FILE *stream) {
+    if (store->nseries == 0) {
+        fprintf(stream, "No measurements received yet.\n");
+        return;
+    }
+
+    for (unsigned int i = 0; i < store->nseries; i++) {
+        const series_t *series = &store->series[i];
+        const query_sensor_t *kind = sensor_kind(series->subtype);
+        uint32_t last = (series->next - 1) & (SERIES_LEN - 1);
+        uint32_t kept = series->next < SERIES_LEN ? series->next : SERIES_LEN;
+
+        fprintf(stream, "%s%u: %s #%u, %u samples kept, latest %.*f %s @ %u ms\n", kind->prefix, series->id, kind->name,
+                series->id, kept, kind->milli ? 3 : 0, series->value[last] / (kind->milli ? 1000.0 : 1.0), kind->unit,
+                series->time[last]);
+    }
+}
+
+/*
+ * Report the statistics of a sensor, over every window or over the one given.
+ * @param store The store.
+ * @param sensor The name of the sensor.
+ * @param seconds The length of the window in seconds, or NULL for every window.
+ * @param stream Where to report.
+ */
+static void run_stats(const series_store_t *store, const char *sensor, const char *seconds, FILE *stream) {
+    const query_sensor_t *kind;
+    const series_t *series;
+    uint8_t id;
+
+    if (!parse_sensor(sensor, &kind, &id)) {
+        fprintf(stream, "Unknown sensor %s, expected a name such as P1, T2, Mass or Thrust.\n", sensor);
+        return;
+    }
+
+    series = series_find(store, kind->subtype, id);
+    if (series == NULL || series->next == 0) {
+        fprintf(stream, "No measurements received from %s #%u.\n", kind->name, id);
+        return;
+    }
+
+    if (seconds == NULL) {
+        for (unsigned int i = 0; i < store->nwindows; i++) {
+            print_window(series, kind, i, stream);
+        }
+        return;
+    }
+
+    char *end;
+    double span = strtod(seconds, &end) * 1000.0;
+    for (unsigned int i = 0; *end == '\0' && span > 0 && i < store->nwindows; i++) {
+        if ((uint32_t)(span + 0.5) == store->spans[i]) {
+            print_window(series, kind, i, stream);
+            return;
+        }
+    }
+
+    fprintf(stream, "No window of %s s, the windows are:", seconds);
+    for (unsigned int i = 0; i < store->nwindows; i++) {
+        fprintf(stream, " %g", store->spans[i] / 1000.0);
+    }
+    fprintf(stream, " s\n");
+}
+
+/*
+ * Carry out a command.
+ * @param line The command, without its newline.
+ * @param store The store.
+ * @param stream Where to report.
+ */
+static void run_command(char *line, const series_store_t *store, FILE *stream) {
+    char *saveptr;
+    char *command = strtok_r(line, " \t\r", &saveptr);
+    char *first = strtok_r(NULL, " \t\r", &saveptr);
+    char *second = strtok_r(NULL, " \t\r", &saveptr);
+
+    if (command == NULL) {
+        return;
+    } else if (strcmp(command, "stats") == 0 && first != NULL && strtok_r(NULL, " \t\r", &saveptr) == NULL) {
+        run_stats(store, first, second, stream);
+    } else if (strcmp(command, "list") == 0 && first == NULL) {
+        run_list(store, stream);
+    } else {
+        fprintf(stream, "Commands:\n"
+                        "    list                List the sensors measurements were received from\n"
+                        "    stats sensor [sec]  Report the minimum, maximum, mean and standard deviation of the\n"
+                        "                        measurements of a sensor, such as P2, over the last `sec`\n"
+                        "                        seconds or over every window\n");
+    }
+}
+
+/*
+ * Start reading commands.
+ * @param query The commands to initialize.
+ * @param fd Where the commands are read from, usually standard input.
+ */
+void query_init(query_t *query, int fd) {
+    query->fd = fd;
+    query->len = 0;
+    query->skipping = false;
+}
+
+/*
+ * Carry out every command typed so far, without waiting for more. Commands are read only while the client is in the
+ * foreground, so that a client running in the background of a shell is not stopped for reading the terminal.
+ * @param query The commands.
+ * @param store The samples the commands ask about.
+ * @param stream Where to report, which is flushed after every command.
+ */
+void query_poll(query_t *query, const series_store_t *store, FILE *stream) {
+    struct pollfd pfd = {.fd = query->fd, .events = POLLIN};
+    ssize_t n;
+    char *newline;
+
+    while (query->fd >= 0 && poll(&pfd, 1, 0) > 0) {
+#if defined(__linux__) || defined(__APPLE__)
+        if (isatty(query->fd) && tcgetpgrp(query->fd) != getpgrp()) return;
+#endif
+
+        n = read(query->fd, &query->line[query->len], sizeof(query->line) - 1 - query->len);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return;
+        } else if (n <= 0) {
+            query->fd = -1; /* Closed, so no more commands */
+            return;
+        }
+        query->len += n;
+        query->line[query->len] = '\0';
+
+        while ((newline = strchr(query->line, '\n')) != NULL) {
+            *newline = '\0';
+            if (!query->skipping) {
+                run_command(query->line, store, stream);
+                fflush(stream);
+            }
+            query->skipping = false;
+            query->len -= newline + 1 - query->line;
+            memmove(query->line, newline + 1, query->len + 1);
+        }
+
+        if (query->len == sizeof(query->line) - 1) {
+            if (!query->skipping) {
+                fprintf(stream, "Command too long, ignored.\n");
+                fflush(stream);
+            }
+            query->skipping = true;
+            query->len = 0;
+        }
+    }
+}
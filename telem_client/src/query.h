@@ -0,0 +1,24 @@
+#ifndef _QUERY_H_
+#define _QUERY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "series.h"
+
+/* Longest command line, including the newline */
+#define QUERY_LINE_MAX 128
+
+/* Commands typed by the operator, asking about the recent samples of the sensors */
+typedef struct {
+    int fd;                    /* Where the commands are read from, -1 once it is closed */
+    char line[QUERY_LINE_MAX]; /* Command being read */
+    size_t len;                /* Number of bytes of the command read so far */
+    bool skipping;             /* Whether the rest of a command which was too long is being skipped */
+} query_t;
+
+void query_init(query_t *query, int fd);
+void query_poll(query_t *query, const series_store_t *store, FILE *stream);
+
+#endif // _QUERY_H_
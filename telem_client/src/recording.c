@@ -0,0 +1,496 @@
+#ifdef __linux__
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../packets/packet.h"
+#include "recording.h"
+
+_Static_assert(sizeof(recording_header_t) == 32, "Recording file header layout changed");
+_Static_assert(sizeof(recording_block_t) == 32, "Recording block layout changed");
+_Static_assert(sizeof(recording_frame_t) == 16, "Recording frame layout changed");
+_Static_assert(sizeof(recording_index_t) == 16, "Recording index layout changed");
+_Static_assert(sizeof(recording_footer_t) == 32, "Recording footer layout changed");
+_Static_assert(RECORDING_BLOCK_SIZE % RECORDING_ALIGN == 0, "Recording blocks must be aligned");
+_Static_assert(RECORDING_BLOCK_SIZE >= sizeof(recording_block_t) + sizeof(recording_frame_t) + TELEM_FRAME_MAX + 8,
+               "Recording blocks must fit the largest telemetry frame");
+
+/* Round up to the next multiple of 8 bytes */
+
+#define align8(n) (((n) + 7) & ~((size_t)7))
+
+/* Helper macro to access the header of the block being filled */
+
+#define block_hdr(rec) ((recording_block_t *)((rec)->block))
+
+/*
+ * Hash bytes with 32 bit FNV-1a, to detect blocks which were only partly written.
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @return The hash.
+ */
+static uint32_t recording_hash(const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Write a whole buffer at an offset in a file.
+ * @param fd The file.
+ * @param buf The buffer.
+ * @param len The length of the buffer in bytes.
+ * @param offset The offset to write at.
+ * @return 0 on success, error code on failure.
+ */
+static int write_all(int fd, const void *buf, size_t len, uint64_t offset) {
+    const uint8_t *pos = buf;
+    ssize_t written;
+
+    while (len > 0) {
+        written = pwrite(fd, pos, len, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        pos += written;
+        len -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+/*
+ * Empty the block being filled.
+ * @param rec The recording.
+ */
+static void recorder_reset_block(recorder_t *rec) {
+    memset(rec->block, 0, RECORDING_BLOCK_SIZE);
+    block_hdr(rec)->magic = RECORDING_BLOCK_MAGIC;
+    block_hdr(rec)->used = sizeof(recording_block_t);
+    rec->dirty = false;
+}
+
+/*
+ * Write the block being filled at its place in the file, whether or not it is full.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+static int recorder_write_block(recorder_t *rec) {
+    recording_block_t *hdr = block_hdr(rec);
+    int err;
+
+    hdr->checksum = recording_hash(rec->block + sizeof(*hdr), hdr->used - sizeof(*hdr));
+    err = write_all(rec->fd, rec->block, RECORDING_BLOCK_SIZE, rec->offset);
+    if (err) return err;
+
+    clock_gettime(CLOCK_MONOTONIC, &rec->last_sync);
+    rec->dirty = false;
+    return 0;
+}
+
+/*
+ * Write the block being filled for the last time, add it to the index and move on to the next block.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+static int recorder_next_block(recorder_t *rec) {
+    recording_index_t *index;
+    int err;
+
+    err = recorder_write_block(rec);
+    if (err) return err;
+
+    if (rec->nblocks == rec->index_len) {
+        index = realloc(rec->index, rec->index_len * 2 * sizeof(*index));
+        if (index == NULL) return ENOMEM;
+        rec->index = index;
+        rec->index_len *= 2;
+    }
+
+    rec->index[rec->nblocks].offset = rec->offset;
+    rec->index[rec->nblocks].first = block_hdr(rec)->first;
+    rec->nblocks++;
+    rec->offset += RECORDING_BLOCK_SIZE;
+    recorder_reset_block(rec);
+    return 0;
+}
+
+/*
+ * Start the next file of the recording and write its header.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+static int recorder_start_file(recorder_t *rec) {
+    char path[PATH_MAX];
+    recording_header_t *hdr;
+    struct timespec now;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int err;
+
+    if (rec->part == 0) {
+        snprintf(path, sizeof(path), "%s", rec->path);
+    } else {
+        snprintf(path, sizeof(path), "%s.%u", rec->path, rec->part);
+    }
+
+#ifdef O_DIRECT
+    if (rec->direct) flags |= O_DIRECT;
+#endif
+
+    rec->fd = open(path, flags, 0644);
+
+#ifdef O_DIRECT
+    /* Not every file system supports direct I/O, in which case the page cache has to do */
+
+    if (rec->fd < 0 && errno == EINVAL && rec->direct) {
+        rec->direct = false;
+        rec->fd = open(path, flags & ~O_DIRECT, 0644);
+    }
+#elif defined(F_NOCACHE)
+    if (rec->fd >= 0 && rec->direct) fcntl(rec->fd, F_NOCACHE, 1);
+#else
+    rec->direct = false;
+#endif
+
+    if (rec->fd < 0) return errno;
+
+    /* The header is written from the empty block, since writes must come from aligned memory for direct I/O */
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    memset(rec->block, 0, RECORDING_ALIGN);
+    hdr = (recording_header_t *)rec->block;
+    memcpy(hdr->magic, RECORDING_MAGIC, sizeof(hdr->magic));
+    hdr->version = RECORDING_VERSION;
+    hdr->block_size = RECORDING_BLOCK_SIZE;
+    hdr->part = rec->part;
+    hdr->started = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+
+    err = write_all(rec->fd, rec->block, RECORDING_ALIGN, 0);
+    if (err) {
+        close(rec->fd);
+        rec->fd = -1;
+        return err;
+    }
+
+    rec->offset = RECORDING_ALIGN;
+    rec->nblocks = 0;
+    rec->frames = 0;
+    recorder_reset_block(rec);
+    return 0;
+}
+
+/*
+ * Finish the file being written with the block index and footer, and close it. The file is closed even if finishing it
+ * fails, and `fd` is left at -1.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+static int recorder_finish_file(recorder_t *rec) {
+    recording_footer_t *footer;
+    size_t index_bytes;
+    size_t len;
+    uint8_t *buf;
+    int err = 0;
+
+    if (block_hdr(rec)->count > 0) {
+        err = recorder_next_block(rec);
+    }
+
+    /* The index and footer are written in one aligned piece, with the footer at the very end */
+
+    index_bytes = rec->nblocks * sizeof(recording_index_t);
+    len = (index_bytes + sizeof(*footer) + RECORDING_ALIGN - 1) / RECORDING_ALIGN * RECORDING_ALIGN;
+    if (!err && posix_memalign((void **)&buf, RECORDING_ALIGN, len) != 0) err = ENOMEM;
+
+    if (!err) {
+        memset(buf, 0, len);
+        memcpy(buf, rec->index, index_bytes);
+        footer = (recording_footer_t *)(buf + len - sizeof(*footer));
+        footer->index_offset = rec->offset;
+        footer->frames = rec->frames;
+        footer->nblocks = rec->nblocks;
+        footer->checksum = recording_hash(rec->index, index_bytes);
+        memcpy(footer->magic, RECORDING_FOOTER_MAGIC, sizeof(footer->magic));
+
+        err = write_all(rec->fd, buf, len, rec->offset);
+        free(buf);
+    }
+
+    if (fsync(rec->fd) < 0 && !err) err = errno;
+    if (close(rec->fd) < 0 && !err) err = errno;
+    rec->fd = -1;
+    return err;
+}
+
+/*
+ * Start a recording.
+ * @param rec The recording to start.
+ * @param path The path of the first file of the recording, which must stay valid until the recording is closed.
+ * @param rotate_bytes The size in bytes at which to start the next file of the recording, 0 to never split it.
+ * @param direct Whether to bypass the page cache. This is silently dropped where the file system or platform does not
+ * support it, which is reflected in the recording's `direct` field.
+ * @return 0 on success, error code on failure.
+ */
+int recorder_open(recorder_t *rec, const char *path, uint64_t rotate_bytes, bool direct) {
+    int err;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->path = path;
+    rec->rotate_bytes = rotate_bytes;
+    rec->direct = direct;
+
+    if (posix_memalign((void **)&rec->block, RECORDING_ALIGN, RECORDING_BLOCK_SIZE) != 0) return ENOMEM;
+
+    rec->index_len = 64;
+    rec->index = malloc(rec->index_len * sizeof(*rec->index));
+    if (rec->index == NULL) {
+        free(rec->block);
+        return ENOMEM;
+    }
+
+    err = recorder_start_file(rec);
+    if (err) {
+        free(rec->index);
+        free(rec->block);
+    }
+    return err;
+}
+
+/*
+ * Add a received datagram to the recording. Datagrams are gathered into blocks, which are only written once full or by
+ * `recorder_sync`.
+ * @param rec The recording.
+ * @param addr The address the datagram came from.
+ * @param received When the datagram arrived, on CLOCK_REALTIME.
+ * @param data The datagram.
+ * @param len The length of the datagram in bytes, at most TELEM_FRAME_MAX.
+ * @return 0 on success, error code on failure.
+ */
+int recorder_add(recorder_t *rec, const struct sockaddr_in *addr, const struct timespec *received, const void *data,
+                 size_t len) {
+    recording_block_t *hdr = block_hdr(rec);
+    recording_frame_t frame;
+    size_t size = align8(sizeof(frame) + len);
+    int err;
+
+    if (len > TELEM_FRAME_MAX) return EMSGSIZE;
+
+    if (hdr->used + size > RECORDING_BLOCK_SIZE) {
+        err = recorder_next_block(rec);
+        if (err) return err;
+
+        /* Only split the recording between blocks, once the next block would take the file over the limit */
+
+        if (rec->rotate_bytes > 0 && rec->offset + RECORDING_BLOCK_SIZE > rec->rotate_bytes) {
+            err = recorder_finish_file(rec);
+            if (err) return err;
+            rec->part++;
+            err = recorder_start_file(rec);
+            if (err) return err;
+        }
+    }
+
+    frame.received = received->tv_sec * 1000000ull + received->tv_nsec / 1000;
+    frame.addr = addr->sin_addr.s_addr;
+    frame.port = addr->sin_port;
+    frame.len = len;
+
+    memcpy(rec->block + hdr->used, &frame, sizeof(frame));
+    memcpy(rec->block + hdr->used + sizeof(frame), data, len);
+    hdr->used += size;
+
+    if (hdr->count == 0) hdr->first = frame.received;
+    hdr->last = frame.received;
+    hdr->count++;
+    rec->frames++;
+    rec->dirty = true;
+    return 0;
+}
+
+/*
+ * Write the partly filled block if it has held frames for RECORDING_SYNC_MS, so that little is lost if the client
+ * crashes. The block is written in place, and rewritten as it fills.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+int recorder_sync(recorder_t *rec) {
+    struct timespec now;
+    int64_t elapsed_ms;
+    int err;
+
+    if (!rec->dirty) return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - rec->last_sync.tv_sec) * 1000 + (now.tv_nsec - rec->last_sync.tv_nsec) / 1000000;
+    if (elapsed_ms < RECORDING_SYNC_MS) return 0;
+
+    err = recorder_write_block(rec);
+    if (err) return err;
+
+    if (fsync(rec->fd) < 0) return errno;
+    return 0;
+}
+
+/*
+ * Finish a recording, writing the remaining frames and the block index. If starting the next file of the recording
+ * failed, there is no file left to finish.
+ * @param rec The recording.
+ * @return 0 on success, error code on failure.
+ */
+int recorder_close(recorder_t *rec) {
+    int err = rec->fd >= 0 ? recorder_finish_file(rec) : 0;
+    free(rec->index);
+    free(rec->block);
+    return err;
+}
+
+/*
+ * Open a recording file for reading. The file is memory mapped.
+ * @param rec The recording to open.
+ * @param path The path of the recording file.
+ * @return 0 on success, EINVAL if the file is not a recording, error code on failure.
+ */
+int recording_open(recording_t *rec, const char *path) {
+    const recording_footer_t *footer;
+    struct stat st;
+    int err;
+    int fd;
+
+    memset(rec, 0, sizeof(*rec));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return errno;
+
+    if (fstat(fd, &st) < 0) {
+        err = errno;
+        close(fd);
+        return err;
+    }
+
+    if ((size_t)st.st_size < RECORDING_ALIGN) {
+        close(fd);
+        return EINVAL;
+    }
+
+    rec->size = st.st_size;
+    rec->base = mmap(NULL, rec->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    err = errno;
+    close(fd); /* The mapping stays valid without the descriptor */
+    if (rec->base == MAP_FAILED) {
+        rec->base = NULL;
+        return err;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise(rec->base, rec->size, MADV_SEQUENTIAL);
+#endif
+
+    rec->hdr = rec->base;
+    if (memcmp(rec->hdr->magic, RECORDING_MAGIC, sizeof(rec->hdr->magic)) != 0 ||
+        rec->hdr->version != RECORDING_VERSION || rec->hdr->block_size < RECORDING_ALIGN ||
+        rec->hdr->block_size % RECORDING_ALIGN != 0) {
+        recording_close(rec);
+        return EINVAL;
+    }
+
+    /* Use the index if the recording was closed cleanly, otherwise its blocks are scanned */
+
+    footer = (const recording_footer_t *)((const uint8_t *)rec->base + rec->size - sizeof(*footer));
+    if (memcmp(footer->magic, RECORDING_FOOTER_MAGIC, sizeof(footer->magic)) == 0 && footer->index_offset % 8 == 0 &&
+        footer->index_offset <= rec->size - sizeof(*footer) &&
+        (rec->size - sizeof(*footer) - footer->index_offset) / sizeof(recording_index_t) >= footer->nblocks) {
+        const recording_index_t *index =
+            (const recording_index_t *)((const uint8_t *)rec->base + footer->index_offset);
+        if (recording_hash(index, footer->nblocks * sizeof(*index)) == footer->checksum) {
+            rec->index = index;
+            rec->nblocks = footer->nblocks;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Call `handler` on every frame of a block.
+ * @param rec The recording.
+ * @param offset The offset of the block.
+ * @param handler The function to call on every frame.
+ * @param arg An argument passed through to `handler`.
+ * @return 0 on success, EBADMSG if the block is incomplete or corrupt.
+ */
+static int recording_block(const recording_t *rec, uint64_t offset, recording_frame_f handler, void *arg) {
+    const uint8_t *block = (const uint8_t *)rec->base + offset;
+    const recording_block_t *hdr = (const recording_block_t *)block;
+    recording_frame_t frame;
+    size_t pos = sizeof(*hdr);
+
+    if (offset > rec->size || rec->size - offset < rec->hdr->block_size) return EBADMSG;
+    if (hdr->magic != RECORDING_BLOCK_MAGIC || hdr->used < sizeof(*hdr) || hdr->used > rec->hdr->block_size) {
+        return EBADMSG;
+    }
+    if (recording_hash(block + sizeof(*hdr), hdr->used - sizeof(*hdr)) != hdr->checksum) return EBADMSG;
+
+    for (uint32_t i = 0; i < hdr->count; i++) {
+        if (hdr->used - pos < sizeof(frame)) return EBADMSG;
+        memcpy(&frame, block + pos, sizeof(frame));
+        if (hdr->used - pos - sizeof(frame) < frame.len) return EBADMSG;
+
+        handler(&frame, block + pos + sizeof(frame), arg);
+        pos += align8(sizeof(frame) + frame.len);
+    }
+    return 0;
+}
+
+/*
+ * Call `handler` on every frame of a recording file, in the order they were recorded. A file which was not closed
+ * cleanly is read up to its first incomplete block.
+ * @param rec The recording.
+ * @param handler The function to call on every frame.
+ * @param arg An argument passed through to `handler`.
+ * @param nblocks If not NULL, output for the number of blocks read.
+ * @return 0 on success, EBADMSG if a block in the index is corrupt.
+ */
+int recording_foreach(const recording_t *rec, recording_frame_f handler, void *arg, uint32_t *nblocks) {
+    uint32_t count = 0;
+    int err = 0;
+
+    if (rec->index != NULL) {
+        for (; count < rec->nblocks; count++) {
+            err = recording_block(rec, rec->index[count].offset, handler, arg);
+            if (err) break;
+        }
+    } else {
+        for (uint64_t offset = RECORDING_ALIGN; offset + rec->hdr->block_size <= rec->size;
+             offset += rec->hdr->block_size) {
+            if (recording_block(rec, offset, handler, arg) != 0) break;
+            count++;
+        }
+    }
+
+    if (nblocks != NULL) *nblocks = count;
+    return err;
+}
+
+/*
+ * Close a recording file opened for reading.
+ * @param rec The recording to close.
+ */
+void recording_close(recording_t *rec) {
+    if (rec->base == NULL) return;
+    munmap(rec->base, rec->size);
+    rec->base = NULL;
+}
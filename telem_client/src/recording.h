@@ -0,0 +1,127 @@
+#ifndef _RECORDING_H_
+#define _RECORDING_H_
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Recordings hold every telemetry frame received, exactly as it arrived, so that a test can be analysed afterwards
+ * without relying on the console output. All values are in host byte order, except for addresses and ports which are in
+ * network byte order. The layout of a recording file is:
+ *
+ * - A `recording_header_t`, padded to RECORDING_ALIGN bytes
+ * - Blocks of `block_size` bytes, each a `recording_block_t` followed by `count` frames. Each frame is a
+ *   `recording_frame_t` followed by the datagram, padded to 8 bytes.
+ * - If the recording was closed cleanly, the block index: `nblocks` of `recording_index_t`, then zeroes up to a
+ *   `recording_footer_t` which ends the file, so that the file is a multiple of RECORDING_ALIGN bytes long.
+ *
+ * Blocks are always written whole and carry a checksum of their contents, so a recording which was cut short is still
+ * readable up to its last good block by scanning the blocks instead of using the index.
+ *
+ * A recording split into several files by size is named `path`, `path.1`, `path.2` and so on.
+ */
+
+#define RECORDING_MAGIC "HYRECORD"
+#define RECORDING_FOOTER_MAGIC "HYRECIDX"
+#define RECORDING_BLOCK_MAGIC 0x4b4c4248 /* "HBLK" */
+#define RECORDING_VERSION 1
+
+/* Alignment of every write to a recording, which suits direct I/O */
+#define RECORDING_ALIGN 4096
+
+/* Size of the blocks frames are gathered into before writing, a multiple of RECORDING_ALIGN */
+#ifdef CONFIG_HYSIM_TELEM_CLIENT_RECORD_BLOCK
+#define RECORDING_BLOCK_SIZE CONFIG_HYSIM_TELEM_CLIENT_RECORD_BLOCK
+#else
+#define RECORDING_BLOCK_SIZE (64 * 1024)
+#endif
+
+/* Longest time frames sit in a partly filled block before the block is written, in milliseconds */
+#define RECORDING_SYNC_MS 1000
+
+/* Header of a recording file */
+typedef struct {
+    char magic[8];       /* Always RECORDING_MAGIC, without the null terminator */
+    uint32_t version;    /* Version of the recording file format */
+    uint32_t block_size; /* Size of every block in bytes */
+    uint32_t part;       /* Number of the file in a recording split into several, from 0 */
+    uint32_t reserved;
+    uint64_t started; /* Time the file was started, in microseconds since the epoch */
+} recording_header_t;
+
+/* Header of a block of frames */
+typedef struct {
+    uint32_t magic;    /* Always RECORDING_BLOCK_MAGIC */
+    uint32_t checksum; /* FNV-1a hash of the block following this header, up to `used` */
+    uint32_t used;     /* Number of bytes of the block in use, including this header */
+    uint32_t count;    /* Number of frames in the block */
+    uint64_t first;    /* Time the first frame of the block arrived, in microseconds since the epoch */
+    uint64_t last;     /* Time the last frame of the block arrived, in microseconds since the epoch */
+} recording_block_t;
+
+/* Header of a recorded frame */
+typedef struct {
+    uint64_t received; /* Time the datagram arrived, in microseconds since the epoch */
+    uint32_t addr;     /* IPv4 address of the sender */
+    uint16_t port;     /* UDP port of the sender */
+    uint16_t len;      /* Length of the datagram in bytes */
+} recording_frame_t;
+
+/* Entry of the block index */
+typedef struct {
+    uint64_t offset; /* Offset of the block from the start of the file */
+    uint64_t first;  /* Time the first frame of the block arrived, in microseconds since the epoch */
+} recording_index_t;
+
+/* Footer of a recording file which was closed cleanly, at the very end of the file */
+typedef struct {
+    uint64_t index_offset; /* Offset of the block index from the start of the file */
+    uint64_t frames;       /* Number of frames in the file */
+    uint32_t nblocks;      /* Number of blocks, and of entries in the block index */
+    uint32_t checksum;     /* FNV-1a hash of the block index */
+    char magic[8];         /* Always RECORDING_FOOTER_MAGIC, without the null terminator */
+} recording_footer_t;
+
+/* A recording being written */
+typedef struct {
+    const char *path;          /* Path of the first file of the recording */
+    int fd;                    /* The file being written, -1 once it is closed */
+    unsigned int part;         /* Number of the file being written */
+    uint64_t rotate_bytes;     /* Size at which to start the next file, 0 to never split the recording */
+    bool direct;               /* Whether the file bypasses the page cache */
+    uint64_t offset;           /* Offset of the block being filled */
+    uint8_t *block;            /* The block being filled, aligned to RECORDING_ALIGN */
+    bool dirty;                /* Whether the block has frames which were not written yet */
+    recording_index_t *index;  /* Index of the blocks of the file so far */
+    uint32_t nblocks;          /* Number of blocks in the index */
+    uint32_t index_len;        /* Number of entries the index has room for */
+    uint64_t frames;           /* Number of frames in the file */
+    struct timespec last_sync; /* When the block being filled was last written, on CLOCK_MONOTONIC */
+} recorder_t;
+
+/* A recording file opened for reading */
+typedef struct {
+    void *base;                     /* Start of the memory mapped file */
+    size_t size;                    /* Size of the file in bytes */
+    const recording_header_t *hdr;  /* The file header */
+    const recording_index_t *index; /* The block index, NULL if the file was not closed cleanly */
+    uint32_t nblocks;               /* Number of blocks in the index */
+} recording_t;
+
+/* Function called on every frame of a recording, with the frame header and the datagram */
+typedef void (*recording_frame_f)(const recording_frame_t *frame, const void *data, void *arg);
+
+int recorder_open(recorder_t *rec, const char *path, uint64_t rotate_bytes, bool direct);
+int recorder_add(recorder_t *rec, const struct sockaddr_in *addr, const struct timespec *received, const void *data,
+                 size_t len);
+int recorder_sync(recorder_t *rec);
+int recorder_close(recorder_t *rec);
+
+int recording_open(recording_t *rec, const char *path);
+int recording_foreach(const recording_t *rec, recording_frame_f handler, void *arg, uint32_t *nblocks);
+void recording_close(recording_t *rec);
+
+#endif // _RECORDING_H_
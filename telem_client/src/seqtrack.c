@@ -0,0 +1,140 @@
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "seqtrack.h"
+
+/* Number of frames behind the highest sequence number whose reception is remembered */
+#define SEQTRACK_WINDOW 64
+
+/*
+ * Initialize frame tracking with no senders.
+ * @param track The tracking to initialize.
+ */
+void seqtrack_init(seqtrack_t *track) { memset(track, 0, sizeof(*track)); }
+
+/*
+ * Find the tracking of a sender, starting to track it if it is new. A restarted pad sends from a new port, so once
+ * there are too many senders, the one heard from least recently is forgotten to make room.
+ * @param track The tracking of every sender.
+ * @param addr The address of the sender.
+ * @param added Set to true if the sender is new.
+ * @return The tracking of the sender.
+ */
+static seqtrack_stream_t *seqtrack_stream(seqtrack_t *track, const struct sockaddr_in *addr, bool *added) {
+    seqtrack_stream_t *stream;
+
+    track->frames++;
+    *added = false;
+    for (unsigned int i = 0; i < track->nstreams; i++) {
+        stream = &track->streams[i];
+        if (stream->addr.sin_addr.s_addr == addr->sin_addr.s_addr && stream->addr.sin_port == addr->sin_port) {
+            stream->heard = track->frames;
+            return stream;
+        }
+    }
+
+    if (track->nstreams < SEQTRACK_MAX_STREAMS) {
+        stream = &track->streams[track->nstreams++];
+    } else {
+        stream = &track->streams[0];
+        for (unsigned int i = 1; i < track->nstreams; i++) {
+            if (track->streams[i].heard < stream->heard) stream = &track->streams[i];
+        }
+    }
+
+    memset(stream, 0, sizeof(*stream));
+    stream->addr = *addr;
+    stream->heard = track->frames;
+    *added = true;
+    return stream;
+}
+
+/*
+ * Track the sequence number of a received frame. Frames skipped over are counted as lost until they arrive.
+ * @param track The tracking of every sender.
+ * @param addr The address the frame came from.
+ * @param seq The sequence number of the frame.
+ * @param missing Output for the number of frames skipped over, when the result is SEQTRACK_GAP.
+ * @return What the sequence number says about the frame.
+ */
+seqtrack_result_e seqtrack_frame(seqtrack_t *track, const struct sockaddr_in *addr, uint32_t seq, uint32_t *missing) {
+    seqtrack_stream_t *stream;
+    uint32_t ahead;
+    uint32_t behind;
+    bool added;
+
+    stream = seqtrack_stream(track, addr, &added);
+
+    if (added) {
+        stream->first = seq;
+        stream->highest = seq;
+        stream->window = 1;
+        stream->received = 1;
+        return SEQTRACK_IN_ORDER;
+    }
+
+    /* Sequence numbers wrap around, so anything less than half the range ahead is ahead */
+
+    ahead = seq - stream->highest;
+    if (ahead != 0 && ahead < UINT32_MAX / 2) {
+        stream->window = ahead < SEQTRACK_WINDOW ? (stream->window << ahead) | 1 : 1;
+        stream->highest = seq;
+        stream->received++;
+        stream->lost += ahead - 1;
+        *missing = ahead - 1;
+        return ahead == 1 ? SEQTRACK_IN_ORDER : SEQTRACK_GAP;
+    }
+
+    behind = stream->highest - seq;
+    if (behind >= SEQTRACK_RESTART_GAP) {
+        stream->first = seq;
+        stream->highest = seq;
+        stream->window = 1;
+        stream->received++;
+        stream->restarts++;
+        return SEQTRACK_RESTART;
+    }
+
+    if (behind >= SEQTRACK_WINDOW) {
+        stream->received++;
+        stream->late++;
+        return SEQTRACK_LATE;
+    }
+
+    if (stream->window & ((uint64_t)1 << behind)) {
+        stream->duplicates++;
+        return SEQTRACK_DUPLICATE;
+    }
+
+    /* A frame which was counted as lost turned up after all. Frames from before tracking started, or restarted, were
+     * never counted as lost. */
+
+    stream->window |= (uint64_t)1 << behind;
+    stream->received++;
+    stream->reordered++;
+    if ((int32_t)(seq - stream->first) > 0) stream->lost--;
+    return SEQTRACK_REORDERED;
+}
+
+/*
+ * Print the counters of every sender.
+ * @param track The tracking of every sender.
+ * @param stream Where to print the counters.
+ */
+void seqtrack_print(const seqtrack_t *track, FILE *stream) {
+    const seqtrack_stream_t *s;
+    char ip[INET_ADDRSTRLEN];
+    double loss;
+
+    for (unsigned int i = 0; i < track->nstreams; i++) {
+        s = &track->streams[i];
+        loss = s->received + s->lost > 0 ? 100.0 * s->lost / (s->received + s->lost) : 0;
+        inet_ntop(AF_INET, &s->addr.sin_addr, ip, sizeof(ip));
+        fprintf(stream,
+                "Telemetry from %s:%u: %llu frames received, %llu lost (%.2f%%), %llu reordered, %llu duplicates, "
+                "%llu late, %llu restarts\n",
+                ip, ntohs(s->addr.sin_port), (unsigned long long)s->received, (unsigned long long)s->lost, loss,
+                (unsigned long long)s->reordered, (unsigned long long)s->duplicates, (unsigned long long)s->late,
+                (unsigned long long)s->restarts);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef _SEQTRACK_H_
+#define _SEQTRACK_H_
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Maximum number of telemetry senders whose frames are tracked at once */
+#define SEQTRACK_MAX_STREAMS 4
+
+/* A frame this far behind the highest sequence number seen is taken to mean the sender restarted */
+#define SEQTRACK_RESTART_GAP 1024
+
+/* Frame sequence numbers of one telemetry sender */
+typedef struct {
+    struct sockaddr_in addr; /* Address the frames come from */
+    uint32_t first;          /* Sequence number tracking started at, or last restarted at */
+    uint32_t highest;        /* Highest sequence number received */
+    uint64_t window;         /* Bit `i` is set if frame `highest - i` was received */
+    uint64_t received;       /* Number of frames received, not counting duplicates */
+    uint64_t lost;           /* Number of frames skipped over and not received since */
+    uint64_t reordered;      /* Number of frames received after a later frame */
+    uint64_t duplicates;     /* Number of frames received more than once */
+    uint64_t late;           /* Number of frames too far behind to tell whether they are reordered or duplicates */
+    uint64_t restarts;       /* Number of times the sender started counting over */
+    uint64_t heard;          /* Number of frames tracked from every sender when this one was last heard from */
+} seqtrack_stream_t;
+
+/* Outcome of tracking a frame */
+typedef enum {
+    SEQTRACK_IN_ORDER,  /* The frame is the next one expected */
+    SEQTRACK_GAP,       /* The frame skips over frames which were not received */
+    SEQTRACK_REORDERED, /* The frame was skipped over earlier */
+    SEQTRACK_DUPLICATE, /* The frame was already received */
+    SEQTRACK_LATE,      /* The frame is too far behind to tell */
+    SEQTRACK_RESTART,   /* The sender started counting over */
+} seqtrack_result_e;
+
+/* Frame sequence numbers of every telemetry sender */
+typedef struct {
+    seqtrack_stream_t streams[SEQTRACK_MAX_STREAMS]; /* Most recently heard senders */
+    unsigned int nstreams;                           /* Number of senders */
+    uint64_t frames;                                 /* Number of frames tracked from every sender */
+} seqtrack_t;
+
+void seqtrack_init(seqtrack_t *track);
+seqtrack_result_e seqtrack_frame(seqtrack_t *track, const struct sockaddr_in *addr, uint32_t seq, uint32_t *missing);
+void seqtrack_print(const seqtrack_t *track, FILE *stream);
+
+#endif // _SEQTRACK_H_
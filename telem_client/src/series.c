@@ -0,0 +1,264 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "series.h"
+
+_Static_assert((SERIES_LEN & (SERIES_LEN - 1)) == 0, "SERIES_LEN must be a power of 2");
+
+/* Position in the arrays of a series of the sample with a number */
+#define SERIES_INDEX(num) ((num) & (SERIES_LEN - 1))
+
+/*
+ * @param deque The deque.
+ * @return True if the deque holds no sample numbers.
+ */
+static bool deque_empty(const series_deque_t *deque) { return deque->head == deque->tail; }
+
+/*
+ * @param deque The deque, which must not be empty.
+ * @return The first sample number.
+ */
+static uint32_t deque_front(const series_deque_t *deque) { return deque->nums[SERIES_INDEX(deque->head)]; }
+
+/*
+ * @param deque The deque, which must not be empty.
+ * @return The last sample number.
+ */
+static uint32_t deque_back(const series_deque_t *deque) { return deque->nums[SERIES_INDEX(deque->tail - 1)]; }
+
+/*
+ * Add a sample number to the back of a deque.
+ * @param deque The deque, which must hold fewer than SERIES_LEN numbers.
+ * @param num The sample number.
+ */
+static void deque_push(series_deque_t *deque, uint32_t num) { deque->nums[SERIES_INDEX(deque->tail++)] = num; }
+
+/*
+ * Empty a series of its samples, keeping its storage.
+ * @param series The series.
+ * @param nwindows The number of windows of the series.
+ */
+static void series_reset(series_t *series, unsigned int nwindows) {
+    series->next = 0;
+    for (unsigned int i = 0; i < nwindows; i++) {
+        series_window_t *window = &series->windows[i];
+        window->first = 0;
+        window->sum = 0;
+        window->sum_sq = 0;
+        window->truncated = false;
+        window->max.head = window->max.tail = 0;
+        window->min.head = window->min.tail = 0;
+    }
+}
+
+/*
+ * Start keeping the samples of a sensor.
+ * @param store The store.
+ * @param subtype The telemetry sub-type of the measurements.
+ * @param id The ID of the sensor.
+ * @param series Set to the new series.
+ * @return 0 on success, error code on failure.
+ */
+static int series_create(series_store_t *store, uint8_t subtype, uint8_t id, series_t **series) {
+    uint32_t *storage;
+    series_t *created;
+
+    if (store->nseries == SERIES_MAX) return ENOSPC;
+
+    /* One allocation holds the samples followed by both deques of every window */
+
+    storage = malloc(sizeof(uint32_t) * SERIES_LEN * (2 + 2 * store->nwindows));
+    if (storage == NULL) return ENOMEM;
+
+    created = &store->series[store->nseries];
+    memset(created, 0, sizeof(*created));
+    created->subtype = subtype;
+    created->id = id;
+    created->time = storage;
+    created->value = (int32_t *)&storage[SERIES_LEN];
+    for (unsigned int i = 0; i < store->nwindows; i++) {
+        created->windows[i].span = store->spans[i];
+        created->windows[i].max.nums = &storage[SERIES_LEN * (2 + 2 * i)];
+        created->windows[i].min.nums = &storage[SERIES_LEN * (3 + 2 * i)];
+    }
+
+    store->nseries++;
+    store->lookup[subtype][id] = store->nseries;
+    *series = created;
+    return 0;
+}
+
+/*
+ * Remove the first sample from a window.
+ * @param series The series the window belongs to.
+ * @param window The window, which must not be empty.
+ */
+static void window_drop_first(const series_t *series, series_window_t *window) {
+    int64_t delta = (int64_t)series->value[SERIES_INDEX(window->first)] - series->base;
+
+    window->sum -= delta;
+    window->sum_sq -= (double)delta * delta;
+    if (deque_front(&window->max) == window->first) window->max.head++;
+    if (deque_front(&window->min) == window->first) window->min.head++;
+    window->first++;
+}
+
+/*
+ * Work out the sum of squares of a window afresh from its samples.
+ * @param series The series the window belongs to.
+ * @param window The window.
+ */
+static void window_refresh(const series_t *series, series_window_t *window) {
+    window->sum_sq = 0;
+    for (uint32_t num = window->first; num != series->next; num++) {
+        double delta = (double)series->value[SERIES_INDEX(num)] - series->base;
+        window->sum_sq += delta * delta;
+    }
+}
+
+/*
+ * Initialize an empty store.
+ * @param store The store to initialize.
+ * @param spans The length of every window statistics are kept over, in milliseconds.
+ * @param nwindows The number of windows, at most SERIES_WINDOWS_MAX.
+ * @return 0 on success, EINVAL if there are too many or too few windows or one is empty.
+ */
+int series_init(series_store_t *store, const uint32_t *spans, unsigned int nwindows) {
+    if (nwindows == 0 || nwindows > SERIES_WINDOWS_MAX) return EINVAL;
+    for (unsigned int i = 0; i < nwindows; i++) {
+        if (spans[i] == 0) return EINVAL;
+    }
+
+    memset(store, 0, sizeof(*store));
+    memcpy(store->spans, spans, nwindows * sizeof(spans[0]));
+    store->nwindows = nwindows;
+    return 0;
+}
+
+/*
+ * Add a sample of a sensor, updating the statistics of every window. The oldest sample of the sensor is overwritten
+ * once SERIES_LEN are kept. A sample older than the latest one of its sensor, from a frame which arrived out of order,
+ * is taken to have been measured at the same time as the latest; one from much further back means the sender
+ * restarted, so the samples from before are forgotten.
+ * @param store The store.
+ * @param subtype The telemetry sub-type of the measurement, which must be a measurement.
+ * @param id The ID of the sensor.
+ * @param time The time stamp of the sample in milliseconds.
+ * @param value The measurement.
+ * @return 0 on success, EINVAL if the sub-type is not a measurement, ENOSPC if too many sensors are kept already, or
+ * ENOMEM if the sensor's samples could not be allocated.
+ */
+int series_add(series_store_t *store, uint8_t subtype, uint8_t id, uint32_t time, int32_t value) {
+    series_t *series;
+    uint32_t num;
+    int64_t delta;
+    int err;
+
+    if (subtype >= SERIES_SUBTYPES) return EINVAL;
+
+    if (store->lookup[subtype][id] == 0) {
+        err = series_create(store, subtype, id, &series);
+        if (err) return err;
+    } else {
+        series = &store->series[store->lookup[subtype][id] - 1];
+    }
+
+    if (series->next != 0) {
+        uint32_t latest = series->time[SERIES_INDEX(series->next - 1)];
+        if (time < latest && latest - time > SERIES_RESTART_MS) {
+            series_reset(series, store->nwindows);
+        } else if (time < latest) {
+            time = latest;
+        }
+    }
+    if (series->next == 0) series->base = value;
+
+    /* The slot of the new sample may still hold the oldest sample of a window, which has to leave the window first */
+
+    num = series->next;
+    for (unsigned int i = 0; i < store->nwindows; i++) {
+        series_window_t *window = &series->windows[i];
+        if (num - window->first == SERIES_LEN) {
+            window_drop_first(series, window);
+            window->truncated = true;
+        }
+    }
+
+    series->time[SERIES_INDEX(num)] = time;
+    series->value[SERIES_INDEX(num)] = value;
+    series->next = num + 1;
+
+    /* Samples which are no larger (or no smaller) than the new one can never be the window maximum (or minimum) again,
+     * since the new sample outlasts them */
+
+    delta = (int64_t)value - series->base;
+    for (unsigned int i = 0; i < store->nwindows; i++) {
+        series_window_t *window = &series->windows[i];
+
+        window->sum += delta;
+        window->sum_sq += (double)delta * delta;
+
+        while (!deque_empty(&window->max) && series->value[SERIES_INDEX(deque_back(&window->max))] <= value) {
+            window->max.tail--;
+        }
+        deque_push(&window->max, num);
+
+        while (!deque_empty(&window->min) && series->value[SERIES_INDEX(deque_back(&window->min))] >= value) {
+            window->min.tail--;
+        }
+        deque_push(&window->min, num);
+
+        /* Once a sample leaves the window for being too old, the window again covers its whole span */
+
+        while (time - series->time[SERIES_INDEX(window->first)] >= window->span) {
+            window_drop_first(series, window);
+            window->truncated = false;
+        }
+
+        if (SERIES_INDEX(series->next) == 0) window_refresh(series, window);
+    }
+
+    return 0;
+}
+
+/*
+ * Find the samples of a sensor.
+ * @param store The store.
+ * @param subtype The telemetry sub-type of the measurements.
+ * @param id The ID of the sensor.
+ * @return The series of the sensor, or NULL if no samples were kept of it.
+ */
+const series_t *series_find(const series_store_t *store, uint8_t subtype, uint8_t id) {
+    if (subtype >= SERIES_SUBTYPES || store->lookup[subtype][id] == 0) return NULL;
+    return &store->series[store->lookup[subtype][id] - 1];
+}
+
+/*
+ * Report the statistics of a window, which ends with the latest sample of the series.
+ * @param series The series.
+ * @param window The number of the window, less than the number of windows of the store.
+ * @param stats Set to the statistics. Only `span` and `count` are set if the series has no samples.
+ */
+void series_stats(const series_t *series, unsigned int window, series_stats_t *stats) {
+    const series_window_t *win = &series->windows[window];
+    double mean;
+    double variance;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->span = win->span;
+    stats->count = series->next - win->first;
+    if (stats->count == 0) return;
+
+    stats->latest = series->time[SERIES_INDEX(series->next - 1)];
+    stats->covered = stats->latest - series->time[SERIES_INDEX(win->first)];
+    stats->truncated = win->truncated;
+    stats->max = series->value[SERIES_INDEX(deque_front(&win->max))];
+    stats->min = series->value[SERIES_INDEX(deque_front(&win->min))];
+
+    mean = (double)win->sum / stats->count;
+    variance = win->sum_sq / stats->count - mean * mean;
+    stats->mean = series->base + mean;
+    stats->stddev = variance > 0 ? sqrt(variance) : 0;
+}
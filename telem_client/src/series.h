@@ -0,0 +1,88 @@
+#ifndef _SERIES_H_
+#define _SERIES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of recent samples kept of every sensor, must be a power of 2 */
+#ifdef CONFIG_HYSIM_TELEM_CLIENT_SERIES_LEN
+#define SERIES_LEN CONFIG_HYSIM_TELEM_CLIENT_SERIES_LEN
+#else
+#define SERIES_LEN 65536
+#endif
+
+/* Maximum number of sensors whose samples are kept */
+#define SERIES_MAX 32
+
+/* Maximum number of windows statistics are kept over */
+#define SERIES_WINDOWS_MAX 4
+
+/* Number of measurement sub-types which are kept, which are those numbered below TELEM_ARM */
+#define SERIES_SUBTYPES 4
+
+/* A sample this far behind the latest of its sensor is taken to mean the sender restarted, in milliseconds */
+#define SERIES_RESTART_MS 1000
+
+/* Numbers of samples in a window, in the order they were taken, which can be pushed at the back and popped from either
+ * end. Holds at most SERIES_LEN numbers. */
+typedef struct {
+    uint32_t *nums; /* Storage for SERIES_LEN sample numbers */
+    uint32_t head;  /* Position of the first number, counting up forever */
+    uint32_t tail;  /* Position after the last number, counting up forever */
+} series_deque_t;
+
+/*
+ * Statistics of the samples taken within a span of time before the latest sample, kept up to date as every sample is
+ * added rather than worked out when asked for. The sums are of the samples less the first sample of the series. The sum
+ * of squares, which could overflow any integer, is worked out afresh every SERIES_LEN samples so that rounding errors
+ * do not build up.
+ */
+typedef struct {
+    uint32_t span;      /* Length of the window in milliseconds */
+    uint32_t first;     /* Number of the first sample in the window */
+    int64_t sum;        /* Sum of the samples in the window */
+    double sum_sq;      /* Sum of the squares of the samples in the window */
+    bool truncated;     /* Whether samples within the span were already overwritten by newer ones */
+    series_deque_t max; /* Samples which are or may become the largest in the window, with decreasing values */
+    series_deque_t min; /* Samples which are or may become the smallest in the window, with increasing values */
+} series_window_t;
+
+/* Recent samples of a single sensor, kept in a ring with the time stamps and values in separate arrays */
+typedef struct {
+    uint8_t subtype;                             /* Telemetry sub-type of the measurements */
+    uint8_t id;                                  /* ID of the sensor */
+    uint32_t next;                               /* Number of the next sample, counting up forever */
+    uint32_t *time;                              /* Time stamps of the samples in milliseconds */
+    int32_t *value;                              /* Values of the samples, in the units of the telemetry record */
+    int32_t base;                                /* Value of the first sample, which the window sums are relative to */
+    series_window_t windows[SERIES_WINDOWS_MAX]; /* Statistics over every window */
+} series_t;
+
+/* Statistics of a window, as reported */
+typedef struct {
+    uint32_t span;    /* Length of the window in milliseconds */
+    uint32_t count;   /* Number of samples in the window */
+    uint32_t covered; /* Time between the first and the last sample of the window in milliseconds */
+    bool truncated;   /* Whether older samples within the span were already overwritten */
+    uint32_t latest;  /* Time stamp of the latest sample in milliseconds */
+    int32_t min;      /* Smallest sample */
+    int32_t max;      /* Largest sample */
+    double mean;      /* Mean of the samples */
+    double stddev;    /* Population standard deviation of the samples */
+} series_stats_t;
+
+/* Recent samples of every sensor */
+typedef struct {
+    series_t series[SERIES_MAX];                    /* Sensors, in the order they were first heard from */
+    unsigned int nseries;                           /* Number of sensors */
+    uint8_t lookup[SERIES_SUBTYPES][UINT8_MAX + 1]; /* Index of the series of each sensor plus 1, or 0 if it has none */
+    uint32_t spans[SERIES_WINDOWS_MAX];             /* Length of every window in milliseconds */
+    unsigned int nwindows;                          /* Number of windows */
+} series_store_t;
+
+int series_init(series_store_t *store, const uint32_t *spans, unsigned int nwindows);
+int series_add(series_store_t *store, uint8_t subtype, uint8_t id, uint32_t time, int32_t value);
+const series_t *series_find(const series_store_t *store, uint8_t subtype, uint8_t id);
+void series_stats(const series_t *series, unsigned int window, series_stats_t *stats);
+
+#endif // _SERIES_H_
@@ -1,11 +1,22 @@
+#ifdef __linux__
+#define _GNU_SOURCE /* recvmmsg */
+#endif
+
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../../packets/packet.h"
 #include "stream.h"
 
 /*
@@ -41,6 +52,27 @@ int stream_init(stream_t *stream, const char *ip, uint16_t port) {
         return errno;
     }
 
+    /* Have the kernel time stamp every datagram as it arrives, for measuring latency. Without it, datagrams are time
+     * stamped once they are read. */
+#if defined(SO_TIMESTAMPNS)
+    int stamp = 1;
+    setsockopt(stream->sock, SOL_SOCKET, SO_TIMESTAMPNS, &stamp, sizeof(stamp));
+#elif defined(SO_TIMESTAMP)
+    int stamp = 1;
+    setsockopt(stream->sock, SOL_SOCKET, SO_TIMESTAMP, &stamp, sizeof(stamp));
+#endif
+
+    /* Leave room for datagrams to queue up while the client is busy logging the last batch. The kernel may cap this. */
+    int rcvbuf = STREAM_RCVBUF;
+    setsockopt(stream->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    /* Have the kernel report how many datagrams it dropped because the receive buffer was full */
+    atomic_init(&stream->kernel_drops, 0);
+#if defined(SO_RXQ_OVFL)
+    int ovfl = 1;
+    setsockopt(stream->sock, SOL_SOCKET, SO_RXQ_OVFL, &ovfl, sizeof(ovfl));
+#endif
+
     /* Bind the socket for use. */
     if (bind(stream->sock, (struct sockaddr *)&stream->addr, sizeof(stream->addr)) < 0) {
         return errno;
@@ -68,6 +100,150 @@ ssize_t stream_recv(stream_t *stream, void *buf, size_t n) {
     return recvfrom(stream->sock, buf, n, MSG_WAITALL, (struct sockaddr *)&stream->addr, &size);
 }
 
+/*
+ * Read the control messages received with a datagram.
+ * @param stream The stream the datagram was received on, whose count of datagrams dropped by the kernel is updated where
+ * the platform reports it.
+ * @param msg The message the datagram was received into.
+ * @param received Output for the time the datagram arrived, on CLOCK_REALTIME. This is the kernel's time stamp where
+ * the platform provides one, and the current time otherwise.
+ */
+static void stream_read_control(stream_t *stream, struct msghdr *msg, struct timespec *received) {
+    struct cmsghdr *cmsg;
+    bool stamped = false;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) continue;
+#if defined(SO_TIMESTAMPNS)
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(received, CMSG_DATA(cmsg), sizeof(*received));
+            stamped = true;
+        }
+#elif defined(SO_TIMESTAMP)
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            received->tv_sec = tv.tv_sec;
+            received->tv_nsec = tv.tv_usec * 1000;
+            stamped = true;
+        }
+#endif
+#if defined(SO_RXQ_OVFL)
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            atomic_store_explicit(&stream->kernel_drops, drops, memory_order_relaxed);
+        }
+#endif
+    }
+
+    if (!stamped) clock_gettime(CLOCK_REALTIME, received);
+}
+
+/*
+ * Receive a datagram from the telemetry upstream, along with the time it arrived.
+ * @param stream The stream to receive from.
+ * @param buf The buffer to receive into.
+ * @param n The size of `buf` in bytes.
+ * @param received Output for the time the datagram arrived, on CLOCK_REALTIME. This is the kernel's time stamp where
+ * the platform provides one, and the time the datagram was read otherwise. The stream's count of datagrams dropped by
+ * the kernel is updated too, where the platform reports it.
+ * @return The number of bytes received, -1 on failure with errno set.
+ */
+ssize_t stream_recv_stamped(stream_t *stream, void *buf, size_t n, struct timespec *received) {
+    struct iovec iov = {.iov_base = buf, .iov_len = n};
+    union {
+        struct cmsghdr align;
+        char buf[STREAM_CONTROL_LEN];
+    } control;
+    struct msghdr msg = {
+        .msg_name = &stream->addr,
+        .msg_namelen = sizeof(stream->addr),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = &control,
+        .msg_controllen = sizeof(control),
+    };
+    ssize_t bread;
+
+    bread = recvmsg(stream->sock, &msg, 0);
+    if (bread < 0) return bread;
+
+    stream_read_control(stream, &msg, received);
+    return bread;
+}
+
+/*
+ * Receive as many datagrams from the telemetry upstream as are waiting, up to STREAM_BATCH, blocking until there is at
+ * least one. Each datagram is received straight into its own buffer of the batch, along with the time it arrived (see
+ * `stream_recv_stamped`). The stream's address is left as the sender of the last datagram.
+ * @param stream The stream to receive from.
+ * @param batch The batch to receive into, whose previous datagrams are overwritten.
+ * @return 0 on success with at least one datagram received, error code on failure.
+ */
+int stream_recv_batch(stream_t *stream, stream_batch_t *batch) {
+    batch->count = 0;
+    for (unsigned int i = 0; i < STREAM_BATCH; i++) {
+        batch->iov[i] = (struct iovec){.iov_base = batch->bufs[i], .iov_len = sizeof(batch->bufs[i])};
+    }
+
+#ifdef __linux__
+    struct mmsghdr msgs[STREAM_BATCH];
+    int n;
+
+    for (unsigned int i = 0; i < STREAM_BATCH; i++) {
+        msgs[i] = (struct mmsghdr){
+            .msg_hdr =
+                {
+                    .msg_name = &batch->addrs[i],
+                    .msg_namelen = sizeof(batch->addrs[i]),
+                    .msg_iov = &batch->iov[i],
+                    .msg_iovlen = 1,
+                    .msg_control = &batch->control[i],
+                    .msg_controllen = sizeof(batch->control[i]),
+                },
+        };
+    }
+
+    /* Block for the first datagram only, then take whatever else is already queued */
+
+    n = recvmmsg(stream->sock, msgs, STREAM_BATCH, MSG_WAITFORONE, NULL);
+    if (n < 0) return errno;
+
+    for (int i = 0; i < n; i++) {
+        batch->lens[i] = msgs[i].msg_len;
+        stream_read_control(stream, &msgs[i].msg_hdr, &batch->received[i]);
+    }
+    batch->count = n;
+#else
+    for (unsigned int i = 0; i < STREAM_BATCH; i++) {
+        struct msghdr msg = {
+            .msg_name = &batch->addrs[i],
+            .msg_namelen = sizeof(batch->addrs[i]),
+            .msg_iov = &batch->iov[i],
+            .msg_iovlen = 1,
+            .msg_control = &batch->control[i],
+            .msg_controllen = sizeof(batch->control[i]),
+        };
+
+        /* Block for the first datagram only. An error after that is left for the next call to report. */
+
+        ssize_t bread = recvmsg(stream->sock, &msg, i == 0 ? 0 : MSG_DONTWAIT);
+        if (bread < 0) {
+            if (i == 0) return errno;
+            break;
+        }
+
+        batch->lens[i] = bread;
+        stream_read_control(stream, &msg, &batch->received[i]);
+        batch->count++;
+    }
+#endif
+
+    stream->addr = batch->addrs[batch->count - 1];
+    return 0;
+}
+
 /* Peek `n` bytes from the telemetry upstream into `buf`.
  * TODO: docs
  */
@@ -75,3 +251,17 @@ ssize_t stream_peek(stream_t *stream, void *buf, size_t n) {
     socklen_t size = sizeof(stream->addr);
     return recvfrom(stream->sock, buf, n, MSG_PEEK, (struct sockaddr *)&stream->addr, &size);
 }
+
+/*
+ * Ask the telemetry upstream to publish the full pad state in its next update, rather than only what has changed.
+ * @param stream The stream, which must have received data so that its address is that of the upstream.
+ * @return 0 on success, error code on failure.
+ */
+int stream_request_keyframe(stream_t *stream) {
+    header_p hdr;
+    packet_header_init(&hdr, TYPE_CNTRL, CNTRL_KEYFRAME_REQ);
+    if (sendto(stream->sock, &hdr, sizeof(hdr), 0, (struct sockaddr *)&stream->addr, sizeof(stream->addr)) < 0) {
+        return errno;
+    }
+    return 0;
+}
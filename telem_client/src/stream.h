@@ -2,17 +2,54 @@
 #define _STREAM_H_
 
 #include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "../../packets/packet.h"
+
+/* Maximum number of datagrams received in one batch */
+#ifdef CONFIG_HYSIM_TELEM_CLIENT_RECV_BATCH
+#define STREAM_BATCH CONFIG_HYSIM_TELEM_CLIENT_RECV_BATCH
+#else
+#define STREAM_BATCH 32
+#endif
+
+/* Size of the socket receive buffer requested from the kernel, in bytes */
+#define STREAM_RCVBUF (STREAM_BATCH * 8 * TELEM_FRAME_MAX)
+
+/* Space for the control messages received with a datagram: its time stamp and the kernel's drop count */
+#define STREAM_CONTROL_LEN (CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t)))
 
 typedef struct {
     int sock;
     struct sockaddr_in addr;
+    _Atomic uint32_t kernel_drops; /* Datagrams the kernel dropped as the receive buffer was full, where it reports it */
 } stream_t;
 
+/* Datagrams received together, each decoded in place from the buffer it was received into */
+typedef struct {
+    uint8_t bufs[STREAM_BATCH][TELEM_FRAME_MAX]; /* One datagram per buffer, large enough for any telemetry frame */
+    size_t lens[STREAM_BATCH];                   /* Length of each datagram in bytes */
+    struct sockaddr_in addrs[STREAM_BATCH];      /* Sender of each datagram */
+    struct timespec received[STREAM_BATCH];      /* Time each datagram arrived, on CLOCK_REALTIME */
+    struct iovec iov[STREAM_BATCH];              /* Buffer of each datagram, for the system call */
+    union {
+        struct cmsghdr align;
+        char buf[STREAM_CONTROL_LEN];
+    } control[STREAM_BATCH]; /* Control messages of each datagram */
+    unsigned int count;      /* Number of datagrams received */
+} stream_batch_t;
+
 int stream_init(stream_t *stream, const char *ip, uint16_t port);
 int stream_connect(stream_t *stream);
 int stream_disconnect(stream_t *stream);
 ssize_t stream_recv(stream_t *stream, void *buf, size_t n);
+ssize_t stream_recv_stamped(stream_t *stream, void *buf, size_t n, struct timespec *received);
+int stream_recv_batch(stream_t *stream, stream_batch_t *batch);
 ssize_t stream_peek(stream_t *stream, void *buf, size_t n);
+int stream_request_keyframe(stream_t *stream);
 
 #endif // _STREAM_H_
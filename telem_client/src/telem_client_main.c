@@ -1,26 +1,108 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "../../packets/packet.h"
+#include "fmt.h"
+#include "frame.h"
+#include "framequeue.h"
 #include "helptext.h"
+#include "latency.h"
+#include "query.h"
+#include "recording.h"
+#include "seqtrack.h"
+#include "series.h"
 #include "stream.h"
 
 #define TELEM_PORT 50002
 #define MULTICAST_ADDR "239.100.110.210"
 
+/* Longest time the output waits for a datagram before checking whether a summary is due, in milliseconds */
+#define OUTPUT_WAIT_MS 100
+
 stream_t telem_stream;
 
+/* Datagrams received from the telemetry stream, waiting to be logged */
+framequeue_t frame_queue;
+unsigned long queue_drops_reported = 0;
+
+/* Latencies of the traced telemetry received so far */
+latency_t latency;
+bool have_traces = false;
+
+/* Frame sequence numbers of every sender, for counting lost frames */
+seqtrack_t seqtrack;
+uint32_t kernel_drops_reported = 0;
+
+/* Recording of the frames received, if one was asked for */
+recorder_t recorder;
+bool recording = false;
+
+/* Whether every record is logged to the console */
+bool log_records = true;
+
+/* Recent samples of every sensor, and the commands asking about them */
+series_store_t history;
+query_t query;
+bool history_failed = false;
+
+/* Console output of the records, which is written whenever the queue of received datagrams runs empty */
+fmt_buf_t console;
+
+/* Set when the summary is requested with SIGUSR1 */
+volatile sig_atomic_t print_summary = 0;
+
+/* Set when the client is asked to exit with Ctrl + C (SIGINT) */
+volatile sig_atomic_t stop = 0;
+
+/* State carried from one record of a frame to the next */
+typedef struct {
+    uint64_t received; /* When the frame arrived, in microseconds since the epoch */
+    bool traced;       /* Whether the previous record was a trace of the next one */
+    trace_p trace;     /* The trace of the next record */
+} record_ctx_t;
+
+/*
+ * Finish the recording, if there is one, so that it has its index.
+ */
+static void finish_recording(void) {
+    int err;
+
+    if (!recording) return;
+    recording = false;
+
+    err = recorder_close(&recorder);
+    if (err) {
+        fprintf(stderr, "Could not finish recording: %s\n", strerror(err));
+    }
+}
+
+/*
+ * Handle a failure to write the recording by reporting it and stopping the recording, so that the console output
+ * carries on.
+ * @param err The error code, 0 if there was no failure.
+ */
+static void recording_failed(int err) {
+    if (!err) return;
+    fprintf(stderr, "Could not record telemetry, recording stopped: %s\n", strerror(err));
+    finish_recording();
+}
+
 /* End of stream detected */
 void stream_over(void) {
     int err;
+    fmt_flush(&console);
     printf("End of stream.\n");
+    finish_recording();
     err = stream_disconnect(&telem_stream);
     if (err) {
         fprintf(stderr, "Couldn't close connection: %s\n", strerror(err));
@@ -29,20 +111,315 @@ void stream_over(void) {
     exit(EXIT_SUCCESS);
 }
 
+/*
+ * Keep a measurement in the history of its sensor. The first failure to do so is reported.
+ * @param subtype The telemetry sub-type of the record.
+ * @param body The body of the record.
+ */
+static void keep_measurement(uint8_t subtype, const void *body) {
+    uint8_t id;
+    uint32_t time;
+    int32_t value;
+    int err;
+
+    switch ((telem_subtype_e)subtype) {
+    case TELEM_TEMP: {
+        const temp_p *temp = body;
+        id = temp->id;
+        time = temp->time;
+        value = temp->temperature;
+    } break;
+    case TELEM_PRESSURE: {
+        const pressure_p *pres = body;
+        id = pres->id;
+        time = pres->time;
+        value = pres->pressure;
+    } break;
+    case TELEM_MASS: {
+        const mass_p *mass = body;
+        id = mass->id;
+        time = mass->time;
+        value = mass->mass;
+    } break;
+    case TELEM_THRUST: {
+        const thrust_p *thrust = body;
+        id = thrust->id;
+        time = thrust->time;
+        value = (int32_t)thrust->thrust;
+    } break;
+    default:
+        return;
+    }
+
+    err = series_add(&history, subtype, id, time, value);
+    if (err && !history_failed) {
+        fprintf(stderr, "Could not keep the history of every sensor: %s\n", strerror(err));
+        history_failed = true;
+    }
+}
+
+/*
+ * Log a telemetry record to the console, keep it if it is a measurement, and record its latency if it was traced.
+ * @param hdr The header of the record.
+ * @param body The body of the record, whose type is determined by the header sub-type.
+ * @param arg The state carried between the records of the frame, of type `record_ctx_t`.
+ */
+static void print_record(const header_p *hdr, const void *body, void *arg) {
+    record_ctx_t *ctx = arg;
+
+    /* A trace describes the record which follows it */
+
+    if (hdr->subtype == TELEM_TRACE) {
+        memcpy(&ctx->trace, body, sizeof(ctx->trace));
+        ctx->traced = true;
+        return;
+    }
+
+    if (ctx->traced) {
+        latency_record(&latency, hdr->subtype, &ctx->trace, ctx->received);
+        have_traces = true;
+        ctx->traced = false;
+    }
+
+    keep_measurement(hdr->subtype, body);
+    if (!log_records) return;
+
+    switch ((telem_subtype_e)hdr->subtype) {
+    case TELEM_TEMP: {
+        const temp_p *temp = body;
+        fmt_measurement(&console, "Thermocouple", temp->id, temp->temperature, true, "C", temp->time);
+    } break;
+    case TELEM_PRESSURE: {
+        const pressure_p *pres = body;
+        fmt_measurement(&console, "Pressure transducer", pres->id, pres->pressure, true, "PSI", pres->time);
+    } break;
+    case TELEM_MASS: {
+        const mass_p *mass = body;
+        fmt_measurement(&console, "Load cell", mass->id, mass->mass, true, "kg", mass->time);
+    } break;
+    case TELEM_THRUST: {
+        const thrust_p *thrust = body;
+        fmt_measurement(&console, "Thrust sensor", thrust->id, (int32_t)thrust->thrust, false, "N", thrust->time);
+    } break;
+    case TELEM_ACT: {
+        const act_state_p *act = body;
+        fmt_str(&console, "Actuator #");
+        fmt_uint(&console, act->id);
+        fmt_str(&console, act->state ? ": on @ " : ": off @ ");
+        fmt_uint(&console, act->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_ARM: {
+        const arm_state_p *arm = body;
+        fmt_str(&console, "Arming state: ");
+        fmt_str(&console, arm_state_str(arm->state));
+        fmt_str(&console, " # ");
+        fmt_uint(&console, arm->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_WARN: {
+        const warn_p *warn = body;
+        fmt_str(&console, "WARNING: ");
+        fmt_str(&console, warning_str(warn->type));
+        fmt_str(&console, " # ");
+        fmt_uint(&console, warn->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_CONT: {
+        const continuity_state_p *continuity = body;
+        fmt_str(&console, continuity->state ? "Continuity sensor: closed # " : "Continuity sensor: open # ");
+        fmt_uint(&console, continuity->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_CONN: {
+        const conn_status_p *conn = body;
+        fmt_str(&console, "Connection status: ");
+        fmt_str(&console, conn_status_str(conn->status));
+        fmt_str(&console, " # ");
+        fmt_uint(&console, conn->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_SEQ_STEP: {
+        const seq_step_state_p *step = body;
+        fmt_str(&console, "Sequence step ");
+        fmt_uint(&console, step->index);
+        fmt_str(&console, ": ");
+        fmt_str(&console, seq_step_status_str(step->status));
+        fmt_str(&console, " actuator #");
+        fmt_uint(&console, step->id);
+        fmt_str(&console, step->state ? " on, due " : " off, due ");
+        fmt_uint(&console, step->scheduled);
+        fmt_str(&console, " us, at ");
+        fmt_uint(&console, step->actual);
+        fmt_str(&console, " us # ");
+        fmt_uint(&console, step->time);
+        fmt_str(&console, " ms\n");
+    } break;
+    case TELEM_TRACE:
+        break;
+    }
+}
+
+/*
+ * Print the frame counters of every sender, the depth of the output queue, and the latency of traced telemetry if any
+ * was received.
+ */
+static void print_stats(void) {
+    fmt_flush(&console);
+    seqtrack_print(&seqtrack, stdout);
+#if defined(SO_RXQ_OVFL)
+    printf("Telemetry datagrams dropped by this host: %u\n", atomic_load(&telem_stream.kernel_drops));
+#endif
+    framequeue_print(&frame_queue, stdout);
+    if (have_traces) {
+        latency_print(&latency, stdout);
+    }
+}
+
+/*
+ * Track the sequence number of a received frame, reporting frames which went missing.
+ * @param addr The address the frame came from.
+ * @param buf The datagram containing the frame.
+ * @param n The length of the datagram in bytes.
+ * @return False if the frame is a duplicate, which should not be logged again.
+ */
+static bool track_frame(const struct sockaddr_in *addr, const void *buf, size_t n) {
+    telem_frame_p frame;
+    uint32_t missing;
+
+    if (n < sizeof(frame)) return true;
+    memcpy(&frame, buf, sizeof(frame));
+
+    switch (seqtrack_frame(&seqtrack, addr, frame.seq, &missing)) {
+    case SEQTRACK_GAP:
+        fprintf(stderr, "Telemetry gap: %u frames missing before frame #%u\n", missing, frame.seq);
+        break;
+    case SEQTRACK_REORDERED:
+        fprintf(stderr, "Telemetry frame #%u arrived out of order\n", frame.seq);
+        break;
+    case SEQTRACK_DUPLICATE:
+        fprintf(stderr, "Duplicate telemetry frame #%u ignored\n", frame.seq);
+        return false;
+    case SEQTRACK_LATE:
+        fprintf(stderr, "Telemetry frame #%u arrived too late to track\n", frame.seq);
+        break;
+    case SEQTRACK_RESTART:
+        fprintf(stderr, "Telemetry restarted at frame #%u\n", frame.seq);
+        break;
+    case SEQTRACK_IN_ORDER:
+        break;
+    }
+
+    /* Frames dropped by the kernel or the output queue show up as gaps too, so say when they were lost on this host
+     * rather than the network */
+
+    uint32_t kernel_drops = atomic_load(&telem_stream.kernel_drops);
+    if (kernel_drops != kernel_drops_reported) {
+        fprintf(stderr, "Receive buffer overflowed, %u telemetry datagrams dropped by this host in total\n",
+                kernel_drops);
+        kernel_drops_reported = kernel_drops;
+    }
+
+    unsigned long queue_drops = ringbuf_dropped(&frame_queue.ring);
+    if (queue_drops != queue_drops_reported) {
+        fprintf(stderr, "Output fell behind, %lu telemetry datagrams dropped by this client in total\n", queue_drops);
+        queue_drops_reported = queue_drops;
+    }
+    return true;
+}
+
+/*
+ * Thread which only drains the telemetry socket into the frame queue, so that slow output can not hold up receiving.
+ * @param arg Unused.
+ * @return Never returns; the process exits on a stream error.
+ */
+static void *receive_run(void *arg) {
+    static stream_batch_t batch; /* Kept out of the stack since it is large */
+    bool have_keyframe = false;
+    int err;
+
+    (void)arg;
+
+    for (;;) {
+
+        /* Each datagram is a single frame, which must be read in one call since any remainder of the datagram would be
+         * discarded. Every datagram waiting is read at once. */
+
+        err = stream_recv_batch(&telem_stream, &batch);
+        if (err == EINTR) {
+            continue;
+        } else if (err) {
+            fprintf(stderr, "Stream error: %s\n", strerror(err));
+            stream_disconnect(&telem_stream);
+            exit(EXIT_FAILURE);
+        }
+
+        framequeue_push(&frame_queue, &batch);
+
+        /* The pad only publishes actuators that changed, so ask for the full state once we know where it is */
+
+        if (!have_keyframe) {
+            err = stream_request_keyframe(&telem_stream);
+            if (err) {
+                fprintf(stderr, "Could not request pad state keyframe: %s\n", strerror(err));
+            }
+            have_keyframe = true;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Parse the lengths of the windows statistics are kept over.
+ * @param str Lengths in seconds separated by commas, such as "1,10,60".
+ * @param spans Set to the lengths in milliseconds.
+ * @param nwindows Set to the number of windows.
+ * @return True if there are between 1 and SERIES_WINDOWS_MAX valid lengths.
+ */
+static bool parse_windows(const char *str, uint32_t *spans, unsigned int *nwindows) {
+    char *end;
+
+    for (*nwindows = 0; *nwindows < SERIES_WINDOWS_MAX; (*nwindows)++) {
+        double span = strtod(str, &end) * 1000.0;
+        if (end == str || span < 1 || span > UINT32_MAX / 2) return false;
+        spans[*nwindows] = span + 0.5;
+        if (*end == '\0') {
+            (*nwindows)++;
+            return true;
+        } else if (*end != ',') {
+            return false;
+        }
+        str = end + 1;
+    }
+    return false;
+}
+
 /* Handle Ctrl + C (SIGINT) */
 void handle_int(int sig) {
     (void)sig;
-    int err = stream_disconnect(&telem_stream);
-    exit(err);
+    stop = 1;
+}
+
+/* Handle a request for the summary (SIGUSR1) */
+void handle_usr1(int sig) {
+    (void)sig;
+    print_summary = 1;
 }
 
 int main(int argc, char **argv) {
     char *multicast_addr = "224.0.0.10";
+    unsigned long summary_sec = 0;
+    const char *record_path = NULL;
+    uint64_t rotate_bytes = 0;
+    bool direct = false;
+    uint32_t spans[SERIES_WINDOWS_MAX] = {1000, 10000, 60000};
+    unsigned int nwindows = 3;
 
     /* Parse command line options. */
 
     int c;
-    while ((c = getopt(argc, argv, ":ha:")) != -1) {
+    while ((c = getopt(argc, argv, ":ha:s:r:R:Dqw:")) != -1) {
         switch (c) {
         case 'h':
             puts(HELP_TEXT);
@@ -56,6 +433,31 @@ int main(int argc, char **argv) {
                 exit(EXIT_FAILURE);
             }
             break;
+        case 's':
+            summary_sec = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case 'R':
+            rotate_bytes = strtoull(optarg, NULL, 10) * 1024 * 1024;
+            if (rotate_bytes == 0) {
+                fprintf(stderr, "Invalid recording file size %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'D':
+            direct = true;
+            break;
+        case 'q':
+            log_records = false;
+            break;
+        case 'w':
+            if (!parse_windows(optarg, spans, &nwindows)) {
+                fprintf(stderr, "Invalid statistics windows %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
 
         case '?':
             fprintf(stderr, "Unknown option -%c\n", optopt);
@@ -71,82 +473,126 @@ int main(int argc, char **argv) {
         fprintf(stderr, "Could not initialize telemetry stream: %s\n", strerror(err));
         exit(EXIT_FAILURE);
     }
-    signal(SIGINT, handle_int);
 
-    /* Get messages forever */
+    if (record_path != NULL) {
+        err = recorder_open(&recorder, record_path, rotate_bytes, direct);
+        if (err) {
+            fprintf(stderr, "Could not start recording to %s: %s\n", record_path, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        if (direct && !recorder.direct) {
+            fprintf(stderr, "Direct I/O is not supported for %s, recording through the page cache.\n", record_path);
+        }
+        recording = true;
+    }
 
-    header_p hdr;
-    ssize_t b_read;
-    char buffer[50]; /* Large enough for any UDP packet */
-    for (;;) {
+    err = series_init(&history, spans, nwindows);
+    if (err) {
+        fprintf(stderr, "Could not initialize sensor history: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    query_init(&query, STDIN_FILENO);
 
-        /* Necessary to peek at header because the 'stream' is a UDP datagram stream. Any `stream_recv` call will read
-         * `n` bytes, but it will discard any remainder of the datagram. We peek at the header to make sure that on
-         * subsequent recv calls we read *exactly* the number of bytes we're supposed to.
-         */
+    err = framequeue_init(&frame_queue);
+    if (err) {
+        fprintf(stderr, "Could not initialize telemetry queue: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
 
-        b_read = stream_peek(&telem_stream, &hdr, sizeof(hdr));
+    /* Signals are handled by the output, so interrupt it rather than restarting a write blocked on a slow terminal */
 
-        if (b_read == 0) {
-            stream_over();
-        } else if (b_read == -1) {
-            fprintf(stderr, "Stream error: %s\n", strerror(errno));
-            stream_disconnect(&telem_stream);
-            exit(EXIT_FAILURE);
+    struct sigaction int_action = {.sa_handler = handle_int};
+    sigemptyset(&int_action.sa_mask);
+    sigaction(SIGINT, &int_action, NULL);
+
+    struct sigaction usr1 = {.sa_handler = handle_usr1};
+    sigemptyset(&usr1.sa_mask);
+    sigaction(SIGUSR1, &usr1, NULL);
+    latency_init(&latency);
+    seqtrack_init(&seqtrack);
+
+    /* Receive on a thread of its own, which blocks the signals so that they are only delivered to the output */
+
+    pthread_t receive_thread;
+    sigset_t signals;
+    sigset_t old_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+    err = pthread_create(&receive_thread, NULL, receive_run, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    if (err) {
+        fprintf(stderr, "Could not start receive thread: %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Log messages until asked to stop */
+
+    static framequeue_entry_t entry; /* Kept out of the stack since it is large */
+    record_ctx_t ctx;
+    telem_frame_p frame;
+    struct timespec now;
+    struct timespec next_summary;
+    clock_gettime(CLOCK_MONOTONIC, &next_summary);
+    next_summary.tv_sec += summary_sec;
+
+    /* Log output is written whenever the queue runs empty rather than once per line */
+
+    setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+    fmt_init(&console, stdout);
+
+    while (!stop) {
+
+        /* Summaries are printed between datagrams, when asked for and every `summary_sec` seconds */
+
+        if (summary_sec > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec > next_summary.tv_sec ||
+                (now.tv_sec == next_summary.tv_sec && now.tv_nsec >= next_summary.tv_nsec)) {
+                print_summary = 1;
+                next_summary = now;
+                next_summary.tv_sec += summary_sec;
+            }
         }
 
-        /* Quit if we receive something other than telemetry */
+        if (print_summary) {
+            print_summary = 0;
+            print_stats();
+        }
 
-        if (hdr.type != TYPE_TELEM) {
-            fprintf(stderr, "Received non-telemetry message: %u\n", hdr.type);
-            exit(EXIT_FAILURE);
+        /* The output is written, a partly filled recording block saved, and typed commands answered whenever the
+         * queue runs empty */
+
+        if (!framequeue_pull(&frame_queue, &entry, 0)) {
+            fmt_flush(&console);
+            if (recording) recording_failed(recorder_sync(&recorder));
+            query_poll(&query, &history, stdout);
+            if (!framequeue_pull(&frame_queue, &entry, OUTPUT_WAIT_MS)) continue;
         }
 
-        /* Log the telemetry packet received. */
-        // TODO: do something with b_read here
-        switch ((telem_subtype_e)hdr.subtype) {
-        case TELEM_TEMP: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(hdr) + sizeof(temp_p));
-            temp_p *temp = (temp_p *)&buffer[sizeof(hdr)];
-            printf("Thermocouple #%u: %d C @ %u ms\n", temp->id, temp->temperature / 1000, temp->time);
-        } break;
-        case TELEM_PRESSURE: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(pressure_p) + sizeof(hdr));
-            pressure_p *pres = (pressure_p *)&buffer[sizeof(hdr)];
-            printf("Pressure transducer #%u: %u PSI @ %u ms\n", pres->id, pres->pressure / 1000, pres->time);
-        } break;
-        case TELEM_MASS: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(mass_p) + sizeof(hdr));
-            mass_p *mass = (mass_p *)&buffer[sizeof(hdr)];
-            printf("Load cell #%u: %d kg @ %u ms\n", mass->id, mass->mass / 1000, mass->time);
-        } break;
-        case TELEM_THRUST: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(thrust_p) + sizeof(hdr));
-            thrust_p *thrust = (thrust_p *)&buffer[sizeof(hdr)];
-            printf("Thrust sensor #%u: %d N @ %u ms\n", thrust->id, thrust->thrust, thrust->time);
-        } break;
-        case TELEM_ACT: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(act_state_p) + sizeof(hdr));
-            act_state_p *act = (act_state_p *)&buffer[sizeof(hdr)];
-            printf("Actuator #%u: %s @ %u ms\n", act->id, act->state ? "on" : "off", act->time);
-        } break;
-        case TELEM_ARM: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(arm_state_p) + sizeof(hdr));
-            arm_state_p *arm = (arm_state_p *)&buffer[sizeof(hdr)];
-            printf("Arming state: %s # %u ms\n", arm_state_str(arm->state), arm->time);
-        } break;
-        case TELEM_WARN: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(hdr) + sizeof(warn_p));
-            warn_p *warn = (warn_p *)&buffer[sizeof(hdr)];
-            printf("WARNING: %s # %u ms\n", warning_str(warn->type), warn->time);
-        } break;
-        case TELEM_CONT: {
-            b_read = stream_recv(&telem_stream, &buffer, sizeof(hdr) + sizeof(continuity_state_p));
-            continuity_state_p *continuity = (continuity_state_p *)&buffer[sizeof(hdr)];
-            printf("Continuity sensor: %s # %u ms\n", continuity->state ? "closed" : "open", continuity->time);
-        } break;
+        /* Log every telemetry record in the frame, unless it was already logged. The datagram is decoded in place. */
+
+        if (entry.len == 0) stream_over();
+        if (!track_frame(&entry.addr, entry.data, entry.len)) continue;
+
+        if (recording) {
+            recording_failed(recorder_add(&recorder, &entry.addr, &entry.received, entry.data, entry.len));
+        }
+
+        ctx.received = entry.received.tv_sec * 1000000ull + entry.received.tv_nsec / 1000;
+        ctx.traced = false;
+        err = frame_decode(entry.data, entry.len, &frame, print_record, &ctx);
+        if (err && entry.len < sizeof(frame)) {
+            fprintf(stderr, "Malformed telemetry frame: %s\n", strerror(err)); /* Too short to have a sequence number */
+        } else if (err) {
+            fprintf(stderr, "Malformed telemetry frame #%u: %s\n", frame.seq, strerror(err));
         }
     }
 
-    return 0;
+    print_stats();
+    fflush(stdout);
+    finish_recording();
+    err = stream_disconnect(&telem_stream);
+    return err;
 }
@@ -0,0 +1,369 @@
+/* NOTE: desktop-only tool, which exports telemetry recordings to CSV for analysis. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../packets/packet.h"
+#include "../src/frame.h"
+#include "../src/recording.h"
+
+#define HELP_TEXT                                                                                                      \
+    "telem_export 0.0.0\n2024 CU InSpace\n\nDESCRIPTION:\n    Exports a telemetry recording made with telem_client "   \
+    "-r to a CSV file with\n    one column per sensor and actuator, in the units the pad server replays.\n\n"          \
+    "USAGE:\n    telem_export recording output.csv\n\n    Every file of a recording split with -R is exported, "       \
+    "starting from the\n    first.\n\nEXAMPLES:\n    telem_export coldflow.rec coldflow.csv\n"
+
+/* Maximum number of columns, besides time, in an exported CSV file */
+#define EXPORT_MAX_COLUMNS 64
+
+/* Size of the output buffer, so that the CSV file is written in large pieces */
+#define EXPORT_BUFSIZ (1024 * 1024)
+
+/* Naming and scaling of the CSV columns of each exported telemetry sub-type, in the order the columns appear */
+typedef struct {
+    uint8_t subtype;    /* Telemetry sub-type */
+    const char *prefix; /* Column name, or column name prefix if the ID is part of the name */
+    bool numbered;      /* True if the column name is the prefix followed by the ID */
+    bool milli;         /* True if the telemetry value is in thousandths of the column's unit */
+} export_mapping_t;
+
+/* The same names and units as the CSV files the pad server replays, so that an export can be replayed */
+static const export_mapping_t MAPPINGS[] = {
+    {.subtype = TELEM_PRESSURE, .prefix = "P", .numbered = true, .milli = true},      /* 0.001 PSI -> PSI */
+    {.subtype = TELEM_TEMP, .prefix = "T", .numbered = true, .milli = true},          /* 0.001 C -> C */
+    {.subtype = TELEM_MASS, .prefix = "Mass", .numbered = false, .milli = true},      /* g -> kg */
+    {.subtype = TELEM_THRUST, .prefix = "Thrust", .numbered = false, .milli = false}, /* N -> N */
+    {.subtype = TELEM_CONT, .prefix = "Cont", .numbered = false, .milli = false},     /* Open/closed */
+    {.subtype = TELEM_ACT, .prefix = "A", .numbered = true, .milli = false},          /* Off/on */
+};
+
+/* A column of the exported CSV file */
+typedef struct {
+    const export_mapping_t *map; /* How the column is named and scaled */
+    uint8_t id;                  /* Sensor or actuator ID */
+    int32_t value;               /* Last value seen, which is held until the next one */
+} export_column_t;
+
+/* State of an export */
+typedef struct {
+    export_column_t columns[EXPORT_MAX_COLUMNS]; /* Columns in the order they appear */
+    unsigned int ncolumns;                       /* Number of columns */
+    unsigned int skipped;                        /* Number of sensors left out because there were too many */
+    bool writing;                                /* False while finding the columns, true while writing the rows */
+    FILE *out;                                   /* The CSV file */
+    bool have_row;                               /* Whether a row has values which were not written yet */
+    uint32_t row_time;                           /* Time stamp of the row being gathered, in milliseconds */
+    uint64_t rows;                               /* Number of rows written */
+    uint64_t frames;                             /* Number of frames read */
+    uint64_t malformed;                          /* Number of frames which could not be decoded */
+} export_t;
+
+/*
+ * Get the time stamp, ID and value of an exported telemetry record.
+ * @param hdr The header of the record.
+ * @param body The body of the record.
+ * @param time Output for the time stamp of the record in milliseconds.
+ * @param id Output for the sensor or actuator ID.
+ * @param value Output for the value of the record, in the units of its telemetry message.
+ * @return The mapping of the record's sub-type, NULL if records of its sub-type are not exported.
+ */
+static const export_mapping_t *export_value(const header_p *hdr, const void *body, uint32_t *time, uint8_t *id,
+                                            int32_t *value) {
+    const export_mapping_t *map = NULL;
+
+    for (size_t i = 0; i < sizeof(MAPPINGS) / sizeof(MAPPINGS[0]); i++) {
+        if (MAPPINGS[i].subtype == hdr->subtype) map = &MAPPINGS[i];
+    }
+    if (map == NULL) return NULL;
+
+    /* Record bodies are packed, so they are copied out rather than accessed in place */
+
+    switch ((telem_subtype_e)hdr->subtype) {
+    case TELEM_PRESSURE: {
+        pressure_p pres;
+        memcpy(&pres, body, sizeof(pres));
+        *time = pres.time;
+        *id = pres.id;
+        *value = pres.pressure;
+    } break;
+    case TELEM_TEMP: {
+        temp_p temp;
+        memcpy(&temp, body, sizeof(temp));
+        *time = temp.time;
+        *id = temp.id;
+        *value = temp.temperature;
+    } break;
+    case TELEM_MASS: {
+        mass_p mass;
+        memcpy(&mass, body, sizeof(mass));
+        *time = mass.time;
+        *id = mass.id;
+        *value = mass.mass;
+    } break;
+    case TELEM_THRUST: {
+        thrust_p thrust;
+        memcpy(&thrust, body, sizeof(thrust));
+        *time = thrust.time;
+        *id = thrust.id;
+        *value = (int32_t)thrust.thrust;
+    } break;
+    case TELEM_CONT: {
+        continuity_state_p cont;
+        memcpy(&cont, body, sizeof(cont));
+        *time = cont.time;
+        *id = 0;
+        *value = cont.state;
+    } break;
+    case TELEM_ACT: {
+        act_state_p act;
+        memcpy(&act, body, sizeof(act));
+        *time = act.time;
+        *id = act.id;
+        *value = act.state;
+    } break;
+    default:
+        return NULL;
+    }
+    return map;
+}
+
+/*
+ * Find the column of a sensor or actuator.
+ * @param export The export.
+ * @param map The mapping of the record's sub-type.
+ * @param id The sensor or actuator ID.
+ * @return The column, NULL if there is none.
+ */
+static export_column_t *export_find(export_t *export, const export_mapping_t *map, uint8_t id) {
+    for (unsigned int i = 0; i < export->ncolumns; i++) {
+        if (export->columns[i].map == map && export->columns[i].id == id) return &export->columns[i];
+    }
+    return NULL;
+}
+
+/*
+ * Write a value in the units of its column.
+ * @param out The CSV file.
+ * @param column The column the value belongs to.
+ */
+static void export_write_value(FILE *out, const export_column_t *column) {
+    int32_t value = column->value;
+    long long magnitude = llabs((long long)value);
+
+    if (!column->map->milli) {
+        fprintf(out, ",%d", value);
+        return;
+    }
+
+    /* Integer arithmetic keeps every thousandth exact, and the sign is written separately for values above -1 */
+
+    fprintf(out, ",%s%lld.%03lld", value < 0 ? "-" : "", magnitude / 1000, magnitude % 1000);
+}
+
+/*
+ * Write the row gathered so far, holding each column's last value.
+ * @param export The export.
+ */
+static void export_write_row(export_t *export) {
+    if (!export->have_row) return;
+
+    fprintf(export->out, "%u", export->row_time);
+    for (unsigned int i = 0; i < export->ncolumns; i++) {
+        export_write_value(export->out, &export->columns[i]);
+    }
+    fputc('\n', export->out);
+    export->rows++;
+    export->have_row = false;
+}
+
+/*
+ * Handle a record of a recorded frame. While finding the columns, a column is added for every new sensor or actuator
+ * with its first value. While writing, records with the same time stamp are gathered into one row.
+ * @param hdr The header of the record.
+ * @param body The body of the record.
+ * @param arg The export, of type `export_t`.
+ */
+static void export_record(const header_p *hdr, const void *body, void *arg) {
+    export_t *export = arg;
+    const export_mapping_t *map;
+    export_column_t *column;
+    uint32_t time;
+    int32_t value;
+    uint8_t id;
+
+    map = export_value(hdr, body, &time, &id, &value);
+    if (map == NULL) return;
+
+    column = export_find(export, map, id);
+
+    if (!export->writing) {
+        if (column != NULL) return;
+        if (export->ncolumns == EXPORT_MAX_COLUMNS) {
+            export->skipped++;
+            return;
+        }
+        column = &export->columns[export->ncolumns++];
+        column->map = map;
+        column->id = id;
+        column->value = value; /* Columns start out with their first value, so that no cell is ever empty */
+        return;
+    }
+
+    if (column == NULL) return;
+
+    if (export->have_row && time != export->row_time) export_write_row(export);
+    export->row_time = time;
+    export->have_row = true;
+    column->value = value;
+}
+
+/*
+ * Decode a recorded frame.
+ * @param frame The header of the recorded frame.
+ * @param data The datagram.
+ * @param arg The export, of type `export_t`.
+ */
+static void export_frame(const recording_frame_t *frame, const void *data, void *arg) {
+    export_t *export = arg;
+    telem_frame_p hdr;
+
+    if (frame_decode(data, frame->len, &hdr, export_record, export) != 0 && export->writing) {
+        export->malformed++;
+    }
+    if (export->writing) export->frames++;
+}
+
+/*
+ * Compare two columns for sorting, in the order of the mappings and then by ID.
+ * @param a The first column.
+ * @param b The second column.
+ * @return Less than, equal to or greater than 0 if `a` goes before, with or after `b`.
+ */
+static int export_compare(const void *a, const void *b) {
+    const export_column_t *ca = a;
+    const export_column_t *cb = b;
+
+    if (ca->map != cb->map) return ca->map < cb->map ? -1 : 1;
+    return (int)ca->id - (int)cb->id;
+}
+
+/*
+ * Read every file of a recording, in order.
+ * @param path The path of the first file of the recording.
+ * @param export The export.
+ * @param verbose Whether to report on each file.
+ * @return 0 on success, error code on failure.
+ */
+static int export_pass(const char *path, export_t *export, bool verbose) {
+    char part_path[PATH_MAX];
+    recording_t rec;
+    uint32_t nblocks;
+    int err;
+
+    for (unsigned int part = 0;; part++) {
+        if (part == 0) {
+            snprintf(part_path, sizeof(part_path), "%s", path);
+        } else {
+            snprintf(part_path, sizeof(part_path), "%s.%u", path, part);
+        }
+
+        err = recording_open(&rec, part_path);
+        if (err == ENOENT && part > 0) return 0;
+        if (err) {
+            fprintf(stderr, "Could not open recording \"%s\": %s\n", part_path, strerror(err));
+            return err;
+        }
+
+        err = recording_foreach(&rec, export_frame, export, &nblocks);
+        if (verbose) {
+            if (rec.index == NULL) {
+                fprintf(stderr, "%s was not closed cleanly, %u blocks recovered.\n", part_path, nblocks);
+            } else if (err) {
+                fprintf(stderr, "%s is corrupt after %u of %u blocks.\n", part_path, nblocks, rec.nblocks);
+            }
+        }
+        recording_close(&rec);
+    }
+}
+
+int main(int argc, char **argv) {
+    static export_t export;
+    char *buf;
+    int err;
+    int c;
+
+    while ((c = getopt(argc, argv, ":h")) != -1) {
+        switch (c) {
+        case 'h':
+            puts(HELP_TEXT);
+            exit(EXIT_SUCCESS);
+            break;
+        case '?':
+            fprintf(stderr, "Unknown option -%c\n", optopt);
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "Expected a recording and an output CSV file.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* The first pass finds every sensor and actuator, so that the columns are known before the first row */
+
+    err = export_pass(argv[optind], &export, false);
+    if (err) exit(EXIT_FAILURE);
+
+    if (export.ncolumns == 0) {
+        fprintf(stderr, "No sensor or actuator telemetry in \"%s\".\n", argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+    if (export.skipped > 0) {
+        fprintf(stderr, "More than %u sensors and actuators, %u left out.\n", EXPORT_MAX_COLUMNS, export.skipped);
+    }
+    qsort(export.columns, export.ncolumns, sizeof(export.columns[0]), export_compare);
+
+    export.out = fopen(argv[optind + 1], "w");
+    if (export.out == NULL) {
+        fprintf(stderr, "Could not create \"%s\": %s\n", argv[optind + 1], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    buf = malloc(EXPORT_BUFSIZ);
+    if (buf != NULL) setvbuf(export.out, buf, _IOFBF, EXPORT_BUFSIZ);
+
+    fprintf(export.out, "Time");
+    for (unsigned int i = 0; i < export.ncolumns; i++) {
+        if (export.columns[i].map->numbered) {
+            fprintf(export.out, ",%s%u", export.columns[i].map->prefix, export.columns[i].id);
+        } else {
+            fprintf(export.out, ",%s", export.columns[i].map->prefix);
+        }
+    }
+    fputc('\n', export.out);
+
+    /* The second pass writes the rows */
+
+    export.writing = true;
+    err = export_pass(argv[optind], &export, true);
+    export_write_row(&export);
+
+    if (fclose(export.out) != 0 && !err) {
+        err = errno;
+        fprintf(stderr, "Could not write \"%s\": %s\n", argv[optind + 1], strerror(err));
+    }
+    free(buf);
+    if (err) exit(EXIT_FAILURE);
+
+    if (export.malformed > 0) {
+        fprintf(stderr, "%llu malformed frames were only partly exported.\n", (unsigned long long)export.malformed);
+    }
+    printf("Wrote %llu rows of %u columns from %llu frames to %s\n", (unsigned long long)export.rows, export.ncolumns,
+           (unsigned long long)export.frames, argv[optind + 1]);
+    return EXIT_SUCCESS;
+}